@@ -1,4 +1,4 @@
-/* gb.h - v0.33  - Ginger Bill's C Helper Library - public domain
+/* gb.h - v0.58  - Ginger Bill's C Helper Library - public domain
                  - no warranty implied; use at your own risk
 
 	This is a single header file with a bunch of useful stuff
@@ -54,10 +54,34 @@ TODOS
 	- Generic Heap Allocator (tcmalloc/dlmalloc/?)
 	- Fixed Heap Allocator
 	- Better UTF support and conversion
-	- Free List, best fit rather than first fit
 	- More date & time functions
 
 VERSION HISTORY
+	0.58  - gb_sort is now pattern-defeating quicksort (block partitioning, heap sort fallback)
+	0.57  - SIMD gb_memswap without a bounce buffer, fix gb_shuffle/gb_reverse indices
+	0.56  - gb_memcopy_parallel/gb_memset_parallel and forced non-temporal dispatch entries
+	0.55  - SSE2/AVX2 gb_memchr/gb_memrchr/gb_strlen/gb_memcompare, word at a time generic gb_memrchr
+	0.54  - SSE2/AVX2 gb_memcopy/gb_memset with a non-temporal path above the LLC size
+	0.53  - gbCpuInfo (cpuid features and cache sizes) and the gbCpuDispatch table
+	0.52  - gbSmallArray(Type, N) inline small buffer array
+	0.51  - gbSoa structure of arrays container
+	0.50  - gbArray insert/insert_range/remove_range/remove_unordered/remove_if/splice
+	0.49  - Aligned gbArray init, per array growth policy, realloc/mremap growth (gb_vm_allocator)
+	0.48  - gbMappedArena (arena in a memory mapped file) and gbRelativePointer
+	0.47  - gbStack double ended stack allocator
+	0.46  - gbHandlePool (dense items with generational handles)
+	0.45  - Per thread scratch arenas (gb_scratch_arena_begin/end, gbScratchArena in C++)
+	0.44  - gb_vm_protect, gb_vm_alloc_huge, gb_vm_advise_huge and gb_virtual_memory_huge_page_size
+	0.43  - gbTraceAllocator binary allocation traces, gb_trace_replay and gb_vm_resident_size
+	0.42  - gbTrackingAllocator (live/peak bytes, counts, size histogram, call sites)
+	0.41  - gbThreadCache per thread caching allocator
+	0.40  - gbBuddy allocator over virtual memory; fix gb_vm_trim unmapping the wrong tail
+	0.39  - gbFreeList is now a TLSF (two-level segregated fit) allocator
+	0.38  - gbSlab size class allocator
+	0.37  - gbConcurrentPool (lock-free pool with per-thread magazines)
+	0.36  - gbPool grows by slabs; FreeAll and gb_pool_trim
+	0.35  - gbArena resizes the top allocation in place
+	0.34  - Virtual memory arenas; gb_vm_reserve/commit/decommit
 	0.33  - Minor fixes
 	0.32  - Minor fixes
 	0.31  - Add gb_file_remove
@@ -295,6 +319,7 @@ extern "C" {
 		#define WIN32_MEAN_AND_LEAN 1
 		#define VC_EXTRALEAN        1
 		#include <windows.h>
+		#include <psapi.h> // NOTE(bill): GetProcessMemoryInfo
 		#undef NOMINMAX
 		#undef WIN32_LEAN_AND_MEAN
 		#undef WIN32_MEAN_AND_LEAN
@@ -313,6 +338,7 @@ extern "C" {
 	#endif
 	#include <stdlib.h> // NOTE(bill): malloc on linux
 	#include <sys/mman.h>
+	#include <sys/resource.h>
 	#if !defined(GB_SYSTEM_OSX)
 		#include <sys/sendfile.h>
 	#endif
@@ -324,6 +350,8 @@ extern "C" {
 
 	#if defined(GB_CPU_X86)
 		#include <xmmintrin.h>
+		#include <emmintrin.h>
+		#include <immintrin.h> // NOTE(bill): AVX2 paths are compiled with GB_TARGET and picked at runtime
 	#endif
 #endif
 
@@ -789,6 +817,191 @@ GB_DEF void gb_assert_handler(char const *prefix, char const *condition, char co
 
 
 
+////////////////////////////////////////////////////////////////
+//
+// CPU Info
+//
+// NOTE(bill): Queried once at runtime (cpuid on x86) so a single binary can use the best paths the
+// machine has. The dispatch table is selected on first use, gb_cpu_dispatch_select can restrict it
+// to a subset of the features (e.g. to test or benchmark the fallbacks).
+//
+
+typedef enum gbCpuFeature {
+	gbCpuFeature_SSE2     = GB_BIT(0),
+	gbCpuFeature_SSE3     = GB_BIT(1),
+	gbCpuFeature_SSSE3    = GB_BIT(2),
+	gbCpuFeature_SSE4_1   = GB_BIT(3),
+	gbCpuFeature_SSE4_2   = GB_BIT(4),
+	gbCpuFeature_POPCNT   = GB_BIT(5),
+	gbCpuFeature_AVX      = GB_BIT(6),  // NOTE(bill): Only set if the OS saves the YMM registers
+	gbCpuFeature_AVX2     = GB_BIT(7),
+	gbCpuFeature_FMA      = GB_BIT(8),
+	gbCpuFeature_BMI1     = GB_BIT(9),
+	gbCpuFeature_BMI2     = GB_BIT(10),
+	gbCpuFeature_F16C     = GB_BIT(11),
+	gbCpuFeature_PCLMUL   = GB_BIT(12),
+	gbCpuFeature_ERMS     = GB_BIT(13), // NOTE(bill): Enhanced rep movsb/stosb
+	gbCpuFeature_AVX512F  = GB_BIT(14), // NOTE(bill): Only set if the OS saves the ZMM registers
+	gbCpuFeature_AVX512BW = GB_BIT(15),
+	gbCpuFeature_AVX512VL = GB_BIT(16),
+} gbCpuFeature;
+
+typedef struct gbCpuInfo {
+	u32   features; // NOTE(bill): gbCpuFeature flags
+	char  vendor[13];
+	char  brand[49];
+	isize cache_line_size;
+	isize l1d_cache_size; // NOTE(bill): Cache sizes are in bytes, 0 if unknown
+	isize l2_cache_size;
+	isize l3_cache_size;
+} gbCpuInfo;
+
+GB_DEF gbCpuInfo const *gb_cpu_info(void);
+GB_DEF b32              gb_cpu_has (u32 features); // NOTE(bill): All of them
+
+typedef struct gbCpuDispatch {
+	u32   features; // NOTE(bill): What the table was selected for
+	isize non_temporal_threshold; // NOTE(bill): Copies/sets at least this big bypass the cache (the last level cache size)
+	void *      (*memcopy)   (void *dest, void const *source, isize size);
+	void *      (*memset)    (void *data, u8 byte_value, isize size);
+	void *      (*memcopy_non_temporal)(void *dest, void const *source, isize size); // NOTE(bill): Always stream, whatever the size
+	void *      (*memset_non_temporal) (void *data, u8 byte_value, isize size);
+	void        (*memswap)   (void *i, void *j, isize size);
+	i32         (*memcompare)(void const *s1, void const *s2, isize size);
+	void const *(*memchr)    (void const *data, u8 byte_value, isize size);
+	void const *(*memrchr)   (void const *data, u8 byte_value, isize size);
+	isize       (*strlen)    (char const *str);
+} gbCpuDispatch;
+
+GB_DEF gbCpuDispatch const *gb_cpu_dispatch(void);
+GB_DEF void                 gb_cpu_dispatch_select(u32 features); // NOTE(bill): Masked by gb_cpu_info()->features
+
+#if 0 // Benchmark: gb_memcopy/gb_memset throughput for each dispatch level
+void bench_memcopy(void) {
+	u32 levels[] = {0, gbCpuFeature_SSE2, gbCpuFeature_SSE2 | gbCpuFeature_AVX2};
+	char const *names[] = {"generic", "sse2", "avx2"};
+	isize max_size = cast(isize)gb_gigabytes(1);
+	gbVirtualMemory src_vm = gb_vm_alloc(NULL, max_size+64);
+	gbVirtualMemory dst_vm = gb_vm_alloc(NULL, max_size+64);
+	u8 *src = cast(u8 *)src_vm.data, *dst = cast(u8 *)dst_vm.data;
+	isize size, l;
+
+	gb_memset(src, 1, max_size+64);
+	gb_memset(dst, 2, max_size+64);
+	for (l = 0; l < gb_count_of(levels); l++) {
+		gb_cpu_dispatch_select(levels[l]);
+		for (size = 8; size <= max_size; size *= 2) {
+			// NOTE(bill): Roughly 4 GiB of traffic per size, offset by 1 byte so the source is unaligned
+			isize i, iters = gb_max(cast(isize)(gb_gigabytes(4) / size), 1);
+			f64 t0, t1, t2;
+			t0 = gb_time_now();
+			for (i = 0; i < iters; i++) gb_memcopy(dst, src+1, size);
+			t1 = gb_time_now();
+			for (i = 0; i < iters; i++) gb_memset(dst, cast(u8)i, size);
+			t2 = gb_time_now();
+			gb_printf("%8s %12td B  copy %8.2f GB/s  set %8.2f GB/s\n", names[l], size,
+			          cast(f64)(size*iters) / (t1-t0) * 1e-9, cast(f64)(size*iters) / (t2-t1) * 1e-9);
+		}
+	}
+	gb_cpu_dispatch_select(cast(u32)-1);
+	gb_vm_free(src_vm);
+	gb_vm_free(dst_vm);
+}
+#endif
+
+#if 0 // Benchmark: gb_memswap on typical record sizes for each dispatch level, against the old 256 byte bounce buffer
+void bench_memswap_buffer(void *i, void *j, isize size) {
+	char buffer[256];
+	while (size > gb_size_of(buffer)) {
+		bench_memswap_buffer(i, j, gb_size_of(buffer));
+		i = gb_pointer_add(i, gb_size_of(buffer));
+		j = gb_pointer_add(j, gb_size_of(buffer));
+		size -= gb_size_of(buffer);
+	}
+	gb_memcopy(buffer, i, size);
+	gb_memcopy(i, j, size);
+	gb_memcopy(j, buffer, size);
+}
+
+void bench_memswap(void) {
+	u32 levels[] = {0, gbCpuFeature_SSE2, gbCpuFeature_SSE2 | gbCpuFeature_AVX2};
+	char const *names[] = {"generic", "sse2", "avx2"};
+	isize sizes[] = {12, 16, 24, 32, 48, 64, 96, 128, 256, 1000};
+	isize iters = 20000, l, s, k, it;
+	u8 *data = cast(u8 *)gb_malloc(gb_kilobytes(16));
+	u32 pairs[512]; // NOTE(bill): gb_random_gen_u32 costs more than a swap so generate them up front
+	gbRandom r;
+	gb_random_init(&r);
+	gb_memset(data, 1, gb_kilobytes(16));
+	for (k = 0; k < gb_count_of(pairs); k++) pairs[k] = gb_random_gen_u32(&r);
+
+	// NOTE(bill): Random pairs within an array that fits in the L1 cache, like a sort would swap
+	for (l = -1; l < gb_count_of(levels); l++) {
+		if (l >= 0) gb_cpu_dispatch_select(levels[l]);
+		for (s = 0; s < gb_count_of(sizes); s++) {
+			isize size = sizes[s], n = gb_kilobytes(16) / size;
+			f64 t0 = gb_time_now(), t1;
+			for (it = 0; it < iters; it++) {
+				for (k = 0; k < gb_count_of(pairs); k += 2) {
+					u8 *a = data + size*(pairs[k] % n), *b = data + size*(pairs[k+1] % n);
+					if (l < 0) bench_memswap_buffer(a, b, size);
+					else       gb_memswap(a, b, size);
+				}
+			}
+			t1 = gb_time_now();
+			gb_printf("%8s %5td B  %6.2f ns/swap\n", l < 0 ? "buffer" : names[l], size, (t1-t0) * 1e9 / cast(f64)(iters*gb_count_of(pairs)/2));
+		}
+	}
+	gb_cpu_dispatch_select(cast(u32)-1);
+	gb_mfree(data);
+}
+#endif
+
+#if 0 // Fuzz: the SIMD search/compare paths of each dispatch level against the generic ones, at the end of a page before a guard page
+void fuzz_memchr(void) {
+	u32 levels[] = {0, gbCpuFeature_SSE2, gbCpuFeature_SSE2 | gbCpuFeature_AVX2};
+	isize page = gb_virtual_memory_page_size(NULL), it, i, l;
+	gbVirtualMemory vm = gb_vm_alloc(NULL, page*3);
+	u8 *guard = cast(u8 *)vm.data + page*2, *other = cast(u8 *)vm.data;
+	gbCpuDispatch generic;
+	gbRandom r;
+	gb_random_init(&r);
+	gb_vm_protect(gb_virtual_memory(guard, page), gbVirtualMemoryProtection_None);
+	gb_cpu_dispatch_select(0);
+	generic = *gb_cpu_dispatch();
+
+	// NOTE(bill): Each level on its own, otherwise the SSE2 paths are only reached through the AVX2 tails
+	for (l = 1; l < gb_count_of(levels); l++) {
+		gb_cpu_dispatch_select(levels[l]);
+		for (it = 0; it < 10000000; it++) {
+			isize n = cast(isize)(gb_random_gen_u32(&r) % 300);
+			u8 c = cast(u8)(gb_random_gen_u32(&r) % 4), *s = guard - n, *t = other + (it & 63);
+			for (i = 0; i < n; i++) s[i] = t[i] = cast(u8)(gb_random_gen_u32(&r) % 5);
+			if (n > 0 && (it & 1)) t[it % n] ^= 0x80;
+			if (n > 0) s[n-1] = 0; // NOTE(bill): For strlen
+			GB_ASSERT(gb_memchr(s, c, n)  == generic.memchr(s, c, n));
+			GB_ASSERT(gb_memrchr(s, c, n) == generic.memrchr(s, c, n));
+			GB_ASSERT(gb_memcompare(s, t, n) == generic.memcompare(s, t, n));
+			GB_ASSERT(n == 0 || gb_strlen(cast(char *)s) == generic.strlen(cast(char *)s));
+		}
+	}
+	gb_cpu_dispatch_select(cast(u32)-1);
+	gb_vm_free(vm);
+}
+#endif
+
+// NOTE(bill): For code that is compiled without the matching -m flags
+#if defined(GB_COMPILER_MSVC)
+	#define GB_TARGET(features)
+	#define GB_NO_ASAN
+#else
+	#define GB_TARGET(features) __attribute__((target(features)))
+	// NOTE(bill): For code that reads past the end of a buffer on purpose (but never into another page)
+	#define GB_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+
+
+
 ////////////////////////////////////////////////////////////////
 //
 // Memory
@@ -821,6 +1034,26 @@ GB_DEF void        gb_memswap   (void *i, void *j, isize size);
 GB_DEF void const *gb_memchr    (void const *data, u8 byte_value, isize size);
 GB_DEF void const *gb_memrchr   (void const *data, u8 byte_value, isize size);
 
+// NOTE(bill): Huge copies/sets split across threads (gbThread). Every chunk but the first starts on a
+// cache line of the destination so no two threads write the same line. Anything smaller than
+// GB_MEM_PARALLEL_THRESHOLD is done on the calling thread.
+#ifndef GB_MEM_PARALLEL_THRESHOLD
+#define GB_MEM_PARALLEL_THRESHOLD (16*1024*1024)
+#endif
+#ifndef GB_MEM_PARALLEL_MAX_THREADS
+#define GB_MEM_PARALLEL_MAX_THREADS 64
+#endif
+
+typedef enum gbMemParallelFlag {
+	gbMemParallel_NonTemporal = GB_BIT(0), // NOTE(bill): Always stream, the data will not be read again soon
+	gbMemParallel_Cached      = GB_BIT(1), // NOTE(bill): Never force streaming, each chunk is a plain gb_memcopy/gb_memset
+	// NOTE(bill): Neither streams when the total size is at least gb_cpu_dispatch()->non_temporal_threshold
+} gbMemParallelFlag;
+
+// NOTE(bill): thread_count <= 0 uses every hardware thread
+GB_DEF void *gb_memcopy_parallel(void *dest, void const *source, isize size, isize thread_count, u32 flags);
+GB_DEF void *gb_memset_parallel (void *data, u8 byte_value, isize size, isize thread_count, u32 flags);
+
 
 #ifndef gb_memcopy_array
 #define gb_memcopy_array(dst, src, count) gb_memcopy((dst), (src), gb_size_of(*(dst))*(count))
@@ -1071,6 +1304,30 @@ GB_DEF b32             gb_vm_free       (gbVirtualMemory vm);
 GB_DEF gbVirtualMemory gb_vm_trim       (gbVirtualMemory vm, isize lead_size, isize size);
 GB_DEF b32             gb_vm_purge      (gbVirtualMemory vm);
 GB_DEF isize gb_virtual_memory_page_size(isize *alignment_out);
+GB_DEF isize gb_virtual_memory_huge_page_size(void); // NOTE(bill): 0 if huge pages are not supported
+GB_DEF isize gb_vm_resident_size(isize *peak_out); // NOTE(bill): Resident memory of the process, 0 if unknown
+
+// NOTE(bill): Reserved memory is only address space, it must be committed before it is touched.
+// Free a reservation with gb_vm_free
+GB_DEF gbVirtualMemory gb_vm_reserve    (void *addr, isize size);
+GB_DEF b32             gb_vm_commit     (gbVirtualMemory vm);
+GB_DEF b32             gb_vm_decommit   (gbVirtualMemory vm); // NOTE(bill): Gives the pages back to the OS but keeps the reservation
+
+typedef enum gbVirtualMemoryProtection {
+	gbVirtualMemoryProtection_None    = 0,
+	gbVirtualMemoryProtection_Read    = GB_BIT(0),
+	gbVirtualMemoryProtection_Write   = GB_BIT(1),
+	gbVirtualMemoryProtection_Execute = GB_BIT(2),
+} gbVirtualMemoryProtection;
+
+GB_DEF b32             gb_vm_protect    (gbVirtualMemory vm, u32 protection); // NOTE(bill): gbVirtualMemoryProtection flags
+
+// NOTE(bill): Huge pages cut TLB misses for large arenas/tables.
+// gb_vm_alloc_huge tries explicit huge pages first (MAP_HUGETLB/MEM_LARGE_PAGES, these must be set up by the admin)
+// and falls back to a huge page aligned gb_vm_alloc with transparent huge pages requested. The size is rounded up
+// to the huge page size. gb_vm_advise_huge asks for transparent huge pages on an existing range (e.g. a gbArena's).
+GB_DEF gbVirtualMemory gb_vm_alloc_huge (void *addr, isize size);
+GB_DEF b32             gb_vm_advise_huge(gbVirtualMemory vm);
 
 
 
@@ -1144,6 +1401,12 @@ GB_DEF void *gb_default_resize_align(gbAllocator a, void *ptr, isize old_size, i
 GB_DEF gbAllocator gb_heap_allocator(void);
 GB_DEF GB_ALLOCATOR_PROC(gb_heap_allocator_proc);
 
+// NOTE(bill): Every allocation is its own mapping (rounded up to whole pages) so only use it for large
+// things, e.g. huge gbArrays. Resize remaps the pages (mremap on Linux) instead of copying so growing
+// does not need the old and the new memory at the same time. The alignment must be <= the page size.
+GB_DEF gbAllocator gb_vm_allocator(void);
+GB_DEF GB_ALLOCATOR_PROC(gb_vm_allocator_proc);
+
 // NOTE(bill): Yep, I use my own allocator system!
 #ifndef gb_malloc
 #define gb_malloc(sz) gb_alloc(gb_heap_allocator(), sz)
@@ -1161,12 +1424,27 @@ typedef struct gbArena {
 	isize       total_size;
 	isize       total_allocated;
 	isize       temp_count;
+	void *      prev_allocation; // NOTE(bill): The top of the stack which can be resized in place
+
+	// NOTE(bill): Only used by virtual memory arenas (commit_size > 0)
+	isize       total_committed;
+	isize       commit_size;
+	isize       decommit_threshold; // NOTE(bill): Committed but unused memory allowed after a free_all/temp end, -1 to never decommit
 } gbArena;
 
-GB_DEF void gb_arena_init_from_memory   (gbArena *arena, void *start, isize size);
-GB_DEF void gb_arena_init_from_allocator(gbArena *arena, gbAllocator backing, isize size);
-GB_DEF void gb_arena_init_sub           (gbArena *arena, gbArena *parent_arena, isize size);
-GB_DEF void gb_arena_free               (gbArena *arena);
+#ifndef GB_ARENA_COMMIT_SIZE
+#define GB_ARENA_COMMIT_SIZE gb_kilobytes(64)
+#endif
+
+#ifndef GB_ARENA_DECOMMIT_THRESHOLD
+#define GB_ARENA_DECOMMIT_THRESHOLD gb_megabytes(1)
+#endif
+
+GB_DEF void gb_arena_init_from_memory        (gbArena *arena, void *start, isize size);
+GB_DEF void gb_arena_init_from_allocator     (gbArena *arena, gbAllocator backing, isize size);
+GB_DEF void gb_arena_init_from_virtual_memory(gbArena *arena, isize reserve_size); // NOTE(bill): Reserves the address space and commits pages on demand
+GB_DEF void gb_arena_init_sub                (gbArena *arena, gbArena *parent_arena, isize size);
+GB_DEF void gb_arena_free                    (gbArena *arena);
 
 GB_DEF isize gb_arena_alignment_of  (gbArena *arena, isize alignment);
 GB_DEF isize gb_arena_size_remaining(gbArena *arena, isize alignment);
@@ -1189,6 +1467,61 @@ GB_DEF void              gb_temp_arena_memory_end  (gbTempArenaMemory tmp_mem);
 
 
 
+//
+// Thread Scratch Arenas
+//
+// NOTE(bill): Every thread has GB_SCRATCH_ARENA_COUNT virtual memory arenas which are made on first use.
+// Pass the arena(s) the caller already uses (e.g. the one a result is allocated in) as conflicts and
+// a different arena is returned, so a callee's temporaries never clobber the caller's.
+//
+//	gbTempArenaMemory scratch = gb_scratch_arena_begin(result_arena);
+//	char *buf = cast(char *)gb_alloc(gb_arena_allocator(scratch.arena), 256);
+//	...
+//	gb_scratch_arena_end(scratch);
+//
+
+#ifndef GB_SCRATCH_ARENA_RESERVE_SIZE
+	#if defined(GB_ARCH_64_BIT)
+	#define GB_SCRATCH_ARENA_RESERVE_SIZE gb_gigabytes(1)
+	#else
+	#define GB_SCRATCH_ARENA_RESERVE_SIZE gb_megabytes(64)
+	#endif
+#endif
+
+#define GB_SCRATCH_ARENA_COUNT 2
+
+GB_DEF gbTempArenaMemory gb_scratch_arena_begin          (gbArena *conflict); // NOTE(bill): conflict may be NULL
+GB_DEF gbTempArenaMemory gb_scratch_arena_begin_conflicts(gbArena **conflicts, isize conflict_count);
+GB_DEF void              gb_scratch_arena_end            (gbTempArenaMemory scratch);
+GB_DEF void              gb_scratch_arena_free_thread    (void); // NOTE(bill): Releases this thread's scratch arenas
+
+#if defined(__cplusplus)
+// NOTE(bill): Scoped scratch arena, the same as a gb_scratch_arena_begin with a defer (gb_scratch_arena_end(...))
+//
+//	{
+//		gbScratchArena scratch(result_arena);
+//		char *buf = cast(char *)gb_alloc(scratch, 256);
+//		...
+//	}
+extern "C++" {
+	struct gbScratchArena {
+		gbTempArenaMemory temp;
+
+		gbScratchArena(gbArena *conflict = NULL) { temp = gb_scratch_arena_begin(conflict); }
+		~gbScratchArena()                        { gb_scratch_arena_end(temp); }
+
+		gbArena *arena()          { return temp.arena; }
+		operator gbAllocator()    { return gb_arena_allocator(temp.arena); }
+
+	private:
+		gbScratchArena(gbScratchArena const &);
+		gbScratchArena &operator=(gbScratchArena const &);
+	};
+}
+#endif
+
+
+
 
 
 
@@ -1198,25 +1531,129 @@ GB_DEF void              gb_temp_arena_memory_end  (gbTempArenaMemory tmp_mem);
 //
 
 
+// NOTE(bill): A pool is made of slabs of blocks from the backing allocator.
+// When it runs out of blocks, it adds another slab of `blocks_per_slab` blocks.
+typedef struct gbPoolSlab {
+	struct gbPoolSlab *next;
+	struct gbPool *    pool;
+	isize              block_count;
+} gbPoolSlab;
+
 typedef struct gbPool {
 	gbAllocator backing;
-	void *      physical_start;
+	void *      physical_start; // NOTE(bill): gbPoolSlab *, the most recently added slab
 	void *      free_list;
 	isize       block_size;
 	isize       block_align;
 	isize       total_size;
+
+	isize       blocks_per_slab;
+	isize       slab_count;
+	isize       slab_size; // NOTE(bill): Only set by gb_pool_init_slabs
 } gbPool;
 
-GB_DEF void gb_pool_init      (gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size);
-GB_DEF void gb_pool_init_align(gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size, isize block_align);
-GB_DEF void gb_pool_free      (gbPool *pool);
+GB_DEF void  gb_pool_init      (gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size);
+GB_DEF void  gb_pool_init_align(gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size, isize block_align);
+// NOTE(bill): Every slab is slab_size bytes (power of two) and aligned to slab_size, so the slab of a block
+// can be found with gb_pool_slab_of. No memory is allocated until the first allocation.
+GB_DEF void  gb_pool_init_slabs(gbPool *pool, gbAllocator backing, isize slab_size, isize block_size, isize block_align);
+GB_DEF void  gb_pool_free      (gbPool *pool);
+GB_DEF b32   gb_pool_grow      (gbPool *pool); // NOTE(bill): Adds a slab, this is done automatically when the pool is exhausted
+GB_DEF isize gb_pool_trim      (gbPool *pool); // NOTE(bill): Releases the empty slabs and returns how many were released
 
-// Allocation Types: alloc, free
+#define gb_pool_slab_of(ptr, slab_size) (cast(gbPoolSlab *)(cast(uintptr)(ptr) & ~cast(uintptr)((slab_size)-1)))
+
+// Allocation Types: alloc, free, free_all
 GB_DEF gbAllocator gb_pool_allocator(gbPool *pool);
 GB_DEF GB_ALLOCATOR_PROC(gb_pool_allocator_proc);
 
 
 
+//
+// Concurrent Pool Allocator
+//
+// NOTE(bill): A gbPool that can be shared between threads without a mutex.
+// The shared free list is a lock-free stack whose head is a tagged pointer (the tag is
+// bumped on every change to stop ABA). Each thread keeps a small magazine of blocks so most
+// alloc/free calls never touch the shared cache line. The mutex is only taken to add a slab.
+//
+// IMPORTANT NOTE(bill): Call gb_concurrent_pool_flush_thread before a thread exits, otherwise the
+// blocks in its magazine are lost until the pool is freed.
+
+#ifndef GB_POOL_MAGAZINE_SIZE
+#define GB_POOL_MAGAZINE_SIZE 32
+#endif
+
+#ifndef GB_POOL_MAX_THREAD_MAGAZINES
+#define GB_POOL_MAX_THREAD_MAGAZINES 8 // NOTE(bill): Per thread, any more pools go straight to the shared list
+#endif
+
+typedef struct gbConcurrentPool {
+	gbAtomic64 free_list; // NOTE(bill): Tagged pointer
+	u8         padding[GB_CACHE_LINE_SIZE - gb_size_of(gbAtomic64)];
+
+	gbMutex    mutex;
+	gbPool     pool;
+	u32        id;
+} gbConcurrentPool;
+
+GB_DEF void gb_concurrent_pool_init        (gbConcurrentPool *pool, gbAllocator backing, isize num_blocks, isize block_size);
+GB_DEF void gb_concurrent_pool_init_align  (gbConcurrentPool *pool, gbAllocator backing, isize num_blocks, isize block_size, isize block_align);
+GB_DEF void gb_concurrent_pool_free        (gbConcurrentPool *pool);
+GB_DEF void gb_concurrent_pool_flush_thread(gbConcurrentPool *pool); // NOTE(bill): Returns this thread's magazine to the shared list
+
+// Allocation Types: alloc, free
+GB_DEF gbAllocator gb_concurrent_pool_allocator(gbConcurrentPool *pool);
+GB_DEF GB_ALLOCATOR_PROC(gb_concurrent_pool_allocator_proc);
+
+
+
+//
+// Slab Allocator - Size Classes of Pools
+//
+// NOTE(bill): Small allocations are routed to a power of two size class (16 bytes to GB_SLAB_MAX_CLASS_SIZE),
+// each backed by a growable gbPool. Every slab is GB_SLAB_PAGE_SIZE aligned and its address is kept in a small
+// hash set, so freeing only needs the pointer. Larger allocations go to the backing allocator with a header
+// just before the pointer (only as aligned as asked for).
+// A block of a size class is aligned to its class size.
+//
+
+#ifndef GB_SLAB_PAGE_SIZE
+#define GB_SLAB_PAGE_SIZE gb_kilobytes(64)
+#endif
+
+#define GB_SLAB_MIN_CLASS_SIZE 16
+#define GB_SLAB_CLASS_COUNT    8
+#define GB_SLAB_MAX_CLASS_SIZE (GB_SLAB_MIN_CLASS_SIZE << (GB_SLAB_CLASS_COUNT-1))
+
+typedef struct gbSlabLargeHeader {
+	struct gbSlabLargeHeader *next;
+	struct gbSlabLargeHeader *prev;
+	void *                    allocation; // NOTE(bill): What came from the backing allocator
+	isize                     size;
+} gbSlabLargeHeader;
+
+typedef struct gbSlab {
+	gbAllocator        backing;
+	gbPool             pools[GB_SLAB_CLASS_COUNT];
+	gbSlabLargeHeader *large_allocations;
+
+	uintptr *          slab_set; // NOTE(bill): Open addressing, 0 is empty
+	isize              slab_set_count;
+	isize              slab_set_capacity;
+} gbSlab;
+
+GB_DEF void  gb_slab_init      (gbSlab *s, gbAllocator backing);
+GB_DEF void  gb_slab_free      (gbSlab *s);
+GB_DEF isize gb_slab_trim      (gbSlab *s); // NOTE(bill): Releases empty slabs of all size classes
+GB_DEF isize gb_slab_size_class(isize size, isize alignment); // NOTE(bill): -1 if it is a large allocation
+
+// Allocation Types: alloc, free, free_all, resize
+GB_DEF gbAllocator gb_slab_allocator(gbSlab *s);
+GB_DEF GB_ALLOCATOR_PROC(gb_slab_allocator_proc);
+
+
+
 // NOTE(bill): Used for allocators to keep track of sizes
 typedef struct gbAllocationHeader {
 	isize size;
@@ -1238,26 +1675,43 @@ GB_DEF void                gb_allocation_header_fill(gbAllocationHeader *header,
 // Free List Allocator
 //
 
-// IMPORTANT TODO(bill): Thoroughly test the free list allocator!
-// NOTE(bill): This is a very shitty free list as it just picks the first free block not the best size
-// as I am just being lazy. Also, I will probably remove it later; it's only here because why not?!
+// NOTE(bill): Two-level segregated fit (TLSF) free list. Free blocks are kept in lists by size class
+// (a power of two split into GB_FREE_LIST_SL_COUNT steps) with bitmaps of the non-empty lists, so alloc
+// and free are O(1). Freed blocks are immediately merged with their free neighbours.
 //
-// NOTE(bill): I may also complete remove this if I completely implement a fixed heap allocator
+// The word before an allocation (skipping any padding) is the block size, so gb_allocation_header works.
+
+#if defined(GB_ARCH_32_BIT)
+#define GB_FREE_LIST_FL_MAX 30
+#else
+#define GB_FREE_LIST_FL_MAX 40
+#endif
+
+#define GB_FREE_LIST_SL_LOG2   4
+#define GB_FREE_LIST_SL_COUNT  (1 << GB_FREE_LIST_SL_LOG2)
+#define GB_FREE_LIST_FL_SHIFT  (GB_FREE_LIST_SL_LOG2 + 4)
+#define GB_FREE_LIST_FL_COUNT  (GB_FREE_LIST_FL_MAX - GB_FREE_LIST_FL_SHIFT + 1)
 
 typedef struct gbFreeListBlock gbFreeListBlock;
 struct gbFreeListBlock {
-	gbFreeListBlock *next;
-	isize            size;
+	gbFreeListBlock *prev_physical; // NOTE(bill): The low bit is set if _this_ block is free
+	isize            size;          // NOTE(bill): Includes the header
+
+	// NOTE(bill): Only valid if the block is free
+	gbFreeListBlock *next_free;
+	gbFreeListBlock *prev_free;
 };
 
 typedef struct gbFreeList {
 	void *           physical_start;
 	isize            total_size;
 
-	gbFreeListBlock *curr_block;
-
 	isize            total_allocated;
 	isize            allocation_count;
+
+	u64              fl_bitmap;
+	u32              sl_bitmap[GB_FREE_LIST_FL_COUNT];
+	gbFreeListBlock *free_blocks[GB_FREE_LIST_FL_COUNT][GB_FREE_LIST_SL_COUNT];
 } gbFreeList;
 
 GB_DEF void gb_free_list_init               (gbFreeList *fl, void *start, isize size);
@@ -1269,6 +1723,189 @@ GB_DEF GB_ALLOCATOR_PROC(gb_free_list_allocator_proc);
 
 
 
+//
+// Buddy Allocator
+//
+// NOTE(bill): Manages a power of two region from gb_vm_alloc. A block at level `l` is `total_size >> l` bytes
+// and is aligned to its size. Blocks have no header: one bit per parent node records if it is split and one bit
+// records `free(left) ^ free(right)` for its children, so finding and merging a buddy is O(log n).
+// Merged free blocks of at least `purge_size` bytes are gb_vm_purge'd (except their first page) so RSS drops.
+//
+
+#ifndef GB_BUDDY_MIN_BLOCK_SIZE
+#define GB_BUDDY_MIN_BLOCK_SIZE gb_kilobytes(4)
+#endif
+
+#ifndef GB_BUDDY_PURGE_SIZE
+#define GB_BUDDY_PURGE_SIZE gb_kilobytes(256)
+#endif
+
+#define GB_BUDDY_MAX_LEVELS 48
+
+typedef struct gbBuddyBlock {
+	struct gbBuddyBlock *next;
+	struct gbBuddyBlock *prev;
+} gbBuddyBlock;
+
+typedef struct gbBuddy {
+	gbVirtualMemory vm;
+	gbVirtualMemory bitmaps;
+	u8 *            split_bits;
+	u8 *            pair_bits;
+
+	isize           total_size;
+	isize           min_block_size;
+	isize           purge_size; // NOTE(bill): 0 never purges
+	isize           page_size;
+	i32             level_count;
+
+	isize           total_allocated;
+	isize           allocation_count;
+
+	gbBuddyBlock *  free_lists[GB_BUDDY_MAX_LEVELS];
+} gbBuddy;
+
+// NOTE(bill): Both sizes are rounded up to a power of two
+GB_DEF b32  gb_buddy_init(gbBuddy *b, isize size, isize min_block_size);
+GB_DEF void gb_buddy_free(gbBuddy *b);
+
+// Allocation Types: alloc, free, free_all, resize
+GB_DEF gbAllocator gb_buddy_allocator(gbBuddy *b);
+GB_DEF GB_ALLOCATOR_PROC(gb_buddy_allocator_proc);
+
+
+//
+// Thread Cache Allocator - Per Thread Front End for any Allocator
+//
+// NOTE(bill): Small allocations (up to GB_THREAD_CACHE_MAX_SIZE with the default alignment) are kept in per thread
+// bins of power of two size classes, so most alloc/free calls touch no shared state at all. The bins only go to
+// the backing allocator in batches, with the mutex held, so the backing allocator does not need to be thread safe.
+// Memory freed by a thread that does not own it is batched and handed back to the owner's lock-free remote list.
+// Larger allocations go straight to the backing allocator.
+//
+// IMPORTANT NOTE(bill): Call gb_thread_cache_flush_thread before a thread exits, otherwise its bins stay reserved
+// until another thread picks them up or the cache is freed.
+
+#ifndef GB_THREAD_CACHE_MAX_SIZE
+#define GB_THREAD_CACHE_MAX_SIZE gb_kilobytes(2)
+#endif
+
+#ifndef GB_THREAD_CACHE_BIN_SIZE
+#define GB_THREAD_CACHE_BIN_SIZE 64 // NOTE(bill): Half a bin is fetched or released at once
+#endif
+
+#ifndef GB_THREAD_CACHE_REMOTE_BATCH
+#define GB_THREAD_CACHE_REMOTE_BATCH 32
+#endif
+
+#ifndef GB_THREAD_CACHE_MAX_PER_THREAD
+#define GB_THREAD_CACHE_MAX_PER_THREAD 4 // NOTE(bill): Any more caches per thread go straight to the backing allocator
+#endif
+
+#define GB_THREAD_CACHE_MIN_SIZE    16
+#define GB_THREAD_CACHE_CLASS_COUNT 8 // NOTE(bill): 16 to 2048
+
+typedef struct gbThreadCacheBin {
+	void *blocks;
+	isize count;
+} gbThreadCacheBin;
+
+// NOTE(bill): The state of one thread, it outlives the thread as other threads may still free to it
+typedef struct gbThreadCacheLocal {
+	gbAtomicPtr                remote_frees; // NOTE(bill): Blocks freed by other threads
+	u8                         padding[GB_CACHE_LINE_SIZE - gb_size_of(gbAtomicPtr)];
+
+	struct gbThreadCache *     cache;
+	struct gbThreadCacheLocal *next;
+	gbAtomic32                 in_use;
+
+	gbThreadCacheBin           bins[GB_THREAD_CACHE_CLASS_COUNT];
+
+	// NOTE(bill): Pending frees to another thread
+	struct gbThreadCacheLocal *remote_owner;
+	void *                     remote_first;
+	void *                     remote_last;
+	isize                      remote_count;
+} gbThreadCacheLocal;
+
+typedef struct gbThreadCache {
+	gbAllocator         backing;
+	gbMutex             mutex; // NOTE(bill): Guards the backing allocator and the list of locals
+	gbThreadCacheLocal *locals;
+	u32                 id;
+} gbThreadCache;
+
+GB_DEF void gb_thread_cache_init        (gbThreadCache *tc, gbAllocator backing);
+GB_DEF void gb_thread_cache_free        (gbThreadCache *tc); // NOTE(bill): No thread may use the cache anymore
+GB_DEF void gb_thread_cache_trim        (gbThreadCache *tc); // NOTE(bill): Returns this thread's cached blocks to the backing allocator
+GB_DEF void gb_thread_cache_flush_thread(gbThreadCache *tc); // NOTE(bill): Trims and gives up this thread's state, call on thread exit
+
+// Allocation Types: alloc, free, resize
+GB_DEF gbAllocator gb_thread_cache_allocator(gbThreadCache *tc);
+GB_DEF GB_ALLOCATOR_PROC(gb_thread_cache_allocator_proc);
+
+
+//
+// Tracking Allocator - Statistics for any Allocator
+//
+// NOTE(bill): Wraps another allocator and counts live/peak bytes, calls and a histogram of allocation sizes.
+// The counters are atomic so it can be shared between threads (if the backing allocator can be too).
+// With record_call_sites set, live allocations are kept in a list with the call site given by the
+// gb_*_tracked macros (or gb_tracking_set_call_site) so gb_tracking_allocator_report can list leaks.
+//
+
+#ifndef GB_TRACKING_HISTOGRAM_COUNT
+#define GB_TRACKING_HISTOGRAM_COUNT 32 // NOTE(bill): Bucket i holds sizes in [2^(i-1), 2^i), the last one holds the rest
+#endif
+
+typedef struct gbTrackingHeader {
+	struct gbTrackingHeader *prev;
+	struct gbTrackingHeader *next;
+	char const *             file;
+	isize                    line;
+	isize                    size;
+	isize                    offset; // NOTE(bill): From the start of the backing allocation
+} gbTrackingHeader;
+
+typedef struct gbTrackingAllocator {
+	gbAllocator       backing;
+	b32               record_call_sites;
+
+	gbAtomic64        live_bytes;
+	gbAtomic64        peak_bytes;
+	gbAtomic64        live_count;
+	gbAtomic64        alloc_count;
+	gbAtomic64        free_count;
+	gbAtomic64        resize_count;
+	gbAtomic64        histogram[GB_TRACKING_HISTOGRAM_COUNT];
+
+	gbMutex           mutex; // NOTE(bill): Guards the list of live allocations
+	gbTrackingHeader *live;
+} gbTrackingAllocator;
+
+GB_DEF void gb_tracking_allocator_init  (gbTrackingAllocator *t, gbAllocator backing, b32 record_call_sites);
+GB_DEF void gb_tracking_allocator_free  (gbTrackingAllocator *t); // NOTE(bill): Does not free the live allocations
+GB_DEF void gb_tracking_allocator_reset (gbTrackingAllocator *t); // NOTE(bill): Resets the counters, peak starts from the live bytes
+GB_DEF void gb_tracking_allocator_report(gbTrackingAllocator *t, char const *name);
+
+// NOTE(bill): The call site of the next allocation on this thread
+GB_DEF void gb_tracking_set_call_site(char const *file, isize line);
+
+// NOTE(bill): Sets the call site for this one call only, it never outlives it even if `a` is not a tracking allocator
+GB_DEF void *gb_alloc_align_at (gbAllocator a, isize size, isize alignment, char const *file, isize line);
+GB_DEF void *gb_resize_align_at(gbAllocator a, void *ptr, isize old_size, isize new_size, isize alignment, char const *file, isize line);
+
+#define gb_alloc_tracked(a, size)                           gb_alloc_align_at(a, size, GB_DEFAULT_MEMORY_ALIGNMENT, __FILE__, __LINE__)
+#define gb_alloc_align_tracked(a, size, alignment)          gb_alloc_align_at(a, size, alignment, __FILE__, __LINE__)
+#define gb_resize_tracked(a, ptr, old_size, new_size)       gb_resize_align_at(a, ptr, old_size, new_size, GB_DEFAULT_MEMORY_ALIGNMENT, __FILE__, __LINE__)
+#define gb_alloc_item_tracked(allocator_, Type)             (Type *)gb_alloc_tracked(allocator_, gb_size_of(Type))
+#define gb_alloc_array_tracked(allocator_, Type, count)     (Type *)gb_alloc_tracked(allocator_, gb_size_of(Type) * (count))
+
+// Allocation Types: alloc, free, free_all, resize
+GB_DEF gbAllocator gb_tracking_allocator(gbTrackingAllocator *t);
+GB_DEF GB_ALLOCATOR_PROC(gb_tracking_allocator_proc);
+
+
 //
 // Scratch Memory Allocator - Ring Buffer Based Arena
 //
@@ -1288,7 +1925,42 @@ GB_DEF b32  gb_scratch_memory_is_in_use(gbScratchMemory *s, void *ptr);
 GB_DEF gbAllocator gb_scratch_allocator(gbScratchMemory *s);
 GB_DEF GB_ALLOCATOR_PROC(gb_scratch_allocator_proc);
 
-// TODO(bill): Stack allocator
+
+
+//
+// Stack Allocator - Double Ended
+//
+// NOTE(bill): Allocates from both ends of one buffer, e.g. persistent data from the bottom and transient data
+// from the top. Each allocation has a small header so frees pop in LIFO order (per end) and the most recent
+// allocation can be resized in place. Freeing anything but the most recent allocation of that end is an error.
+//
+
+typedef struct gbStackHeader {
+	isize prev_offset; // NOTE(bill): Offset of the end before this allocation
+	void *prev;        // NOTE(bill): The allocation before this one
+} gbStackHeader;
+
+typedef struct gbStack {
+	gbAllocator backing;
+	void *      physical_start;
+	isize       total_size;
+	isize       bottom_offset; // NOTE(bill): Bytes used from the start
+	isize       top_offset;    // NOTE(bill): Bytes used from the end
+	void *      bottom_last;
+	void *      top_last;
+} gbStack;
+
+GB_DEF void  gb_stack_init_from_memory   (gbStack *s, void *start, isize size);
+GB_DEF void  gb_stack_init_from_allocator(gbStack *s, gbAllocator backing, isize size);
+GB_DEF void  gb_stack_free               (gbStack *s);
+GB_DEF isize gb_stack_size_remaining     (gbStack *s);
+
+// Allocation Types: alloc, free, free_all, resize
+GB_DEF gbAllocator gb_stack_allocator_bottom(gbStack *s);
+GB_DEF gbAllocator gb_stack_allocator_top   (gbStack *s);
+GB_DEF GB_ALLOCATOR_PROC(gb_stack_bottom_allocator_proc);
+GB_DEF GB_ALLOCATOR_PROC(gb_stack_top_allocator_proc);
+
 // TODO(bill): Fixed heap allocator
 // TODO(bill): General heap allocator. Maybe a TCMalloc like clone?
 
@@ -1318,8 +1990,8 @@ GB_DEF GB_COMPARE_PROC_PTR(gb_f32_cmp  (isize offset));
 GB_DEF GB_COMPARE_PROC_PTR(gb_f64_cmp  (isize offset));
 GB_DEF GB_COMPARE_PROC_PTR(gb_char_cmp (isize offset));
 
-// TODO(bill): Better sorting algorithms
-// NOTE(bill): Uses quick sort for large arrays but insertion sort for small
+// NOTE(bill): Pattern-defeating quicksort, not stable. O(n log n) worst case (heap sort fallback) and close to
+// O(n) for sorted, reverse sorted, nearly sorted and all equal input
 #define gb_sort_array(array, count, compare_proc) gb_sort(array, count, gb_size_of(*(array)), compare_proc)
 GB_DEF void gb_sort(void *base, isize count, isize size, gbCompareProc compare_proc);
 
@@ -1604,7 +2276,9 @@ typedef struct gbBufferHeader {
 
 // Available Procedures for gbArray(Type)
 // gb_array_init
+// gb_array_init_align
 // gb_array_free
+// gb_array_set_grow_proc
 // gb_array_set_capacity
 // gb_array_grow
 // gb_array_append
@@ -1613,6 +2287,12 @@ typedef struct gbBufferHeader {
 // gb_array_clear
 // gb_array_resize
 // gb_array_reserve
+// gb_array_insert
+// gb_array_insert_range
+// gb_array_remove_range
+// gb_array_remove_unordered
+// gb_array_remove_if
+// gb_array_splice
 //
 
 #if 0 // Example
@@ -1653,10 +2333,17 @@ void foo(void) {
 }
 #endif
 
+// NOTE(bill): Returns the new capacity (>= min_capacity) when the array has to grow
+#define GB_ARRAY_GROW_PROC(name) isize name(isize capacity, isize min_capacity, isize element_size)
+typedef GB_ARRAY_GROW_PROC(gbArrayGrowProc);
+
 typedef struct gbArrayHeader {
-	gbAllocator allocator;
-	isize       count;
-	isize       capacity;
+	gbAllocator      allocator;
+	isize            count;
+	isize            capacity;
+	gbArrayGrowProc *grow;      // NOTE(bill): NULL uses GB_ARRAY_GROW_FORMULA
+	i32              alignment; // NOTE(bill): Of the elements
+	i32              offset;    // NOTE(bill): From the start of the allocation to the elements
 } gbArrayHeader;
 
 // NOTE(bill): This thing is magic!
@@ -1668,27 +2355,33 @@ typedef struct gbArrayHeader {
 
 GB_STATIC_ASSERT(GB_ARRAY_GROW_FORMULA(0) > 0);
 
+// NOTE(bill): Stock growth policies
+GB_DEF GB_ARRAY_GROW_PROC(gb_array_grow_formula);      // NOTE(bill): GB_ARRAY_GROW_FORMULA
+GB_DEF GB_ARRAY_GROW_PROC(gb_array_grow_conservative); // NOTE(bill): 1.5x, less slack for huge arrays
+
 #define GB_ARRAY_HEADER(x)    (cast(gbArrayHeader *)(x) - 1)
 #define gb_array_allocator(x) (GB_ARRAY_HEADER(x)->allocator)
 #define gb_array_count(x)     (GB_ARRAY_HEADER(x)->count)
 #define gb_array_capacity(x)  (GB_ARRAY_HEADER(x)->capacity)
+#define gb_array_alignment(x) (GB_ARRAY_HEADER(x)->alignment)
 
-// TODO(bill): Have proper alignment!
-#define gb_array_init_reserve(x, allocator_, cap) do { \
+#define gb_array_set_grow_proc(x, proc) do { GB_ARRAY_HEADER(x)->grow = (proc); } while (0)
+
+// NOTE(bill): The elements are aligned to `alignment` (e.g. 32/64 for SIMD), it is kept when it grows
+#define gb_array_init_reserve_align(x, allocator_, cap, alignment_) do { \
 	void **gb__array_ = cast(void **)&(x); \
-	gbArrayHeader *gb__ah = cast(gbArrayHeader *)gb_alloc(allocator_, gb_size_of(gbArrayHeader)+gb_size_of(*(x))*(cap)); \
-	gb__ah->allocator = allocator_; \
-	gb__ah->count = 0; \
-	gb__ah->capacity = cap; \
-	*gb__array_ = cast(void *)(gb__ah+1); \
+	*gb__array_ = gb__array_init((allocator_), gb_size_of(*(x)), (cap), (alignment_)); \
 } while (0)
 
+#define gb_array_init_reserve(x, allocator_, cap) gb_array_init_reserve_align(x, allocator_, cap, GB_DEFAULT_MEMORY_ALIGNMENT)
+
 // NOTE(bill): Give it an initial default capacity
-#define gb_array_init(x, allocator) gb_array_init_reserve(x, allocator, GB_ARRAY_GROW_FORMULA(0))
+#define gb_array_init(x, allocator)                   gb_array_init_reserve(x, allocator, GB_ARRAY_GROW_FORMULA(0))
+#define gb_array_init_align(x, allocator, alignment_) gb_array_init_reserve_align(x, allocator, GB_ARRAY_GROW_FORMULA(0), alignment_)
 
 #define gb_array_free(x) do { \
 	gbArrayHeader *gb__ah = GB_ARRAY_HEADER(x); \
-	gb_free(gb__ah->allocator, gb__ah); \
+	gb_free(gb__ah->allocator, gb_pointer_sub(gb__ah+1, gb__ah->offset)); \
 } while (0)
 
 #define gb_array_set_capacity(x, capacity) do { \
@@ -1698,15 +2391,14 @@ GB_STATIC_ASSERT(GB_ARRAY_GROW_FORMULA(0) > 0);
 	} \
 } while (0)
 
-// NOTE(bill): Do not use the thing below directly, use the macro
+// NOTE(bill): Do not use the things below directly, use the macros
+GB_DEF void *gb__array_init        (gbAllocator a, isize element_size, isize capacity, isize alignment);
 GB_DEF void *gb__array_set_capacity(void *array, isize capacity, isize element_size);
+GB_DEF isize gb__array_grow_capacity(void *array, isize min_capacity, isize element_size);
 
 
-// TODO(bill): Decide on a decent growing formula for gbArray
 #define gb_array_grow(x, min_capacity) do { \
-	isize new_capacity = GB_ARRAY_GROW_FORMULA(gb_array_capacity(x)); \
-	if (new_capacity < (min_capacity)) \
-		new_capacity = (min_capacity); \
+	isize new_capacity = gb__array_grow_capacity((x), (min_capacity), gb_size_of(*(x))); \
 	gb_array_set_capacity(x, new_capacity); \
 } while (0)
 
@@ -1744,80 +2436,357 @@ GB_DEF void *gb__array_set_capacity(void *array, isize capacity, isize element_s
 } while (0)
 
 
+// NOTE(bill): These grow at most once and do a single memmove of the tail.
+// `items` must not point into `x` as it may move when it grows
 
+// NOTE(bill): Replaces [index, index+remove_count) with `items`
+#define gb_array_splice(x, index, remove_count, items, item_count) do { \
+	void **gb__array_ = cast(void **)&(x); \
+	*gb__array_ = gb__array_splice((x), gb_size_of(*(x)), (index), (remove_count), (items), (item_count)); \
+} while (0)
 
+#define gb_array_insert_range(x, index, items, item_count) gb_array_splice(x, index, 0, items, item_count)
+#define gb_array_remove_range(x, index, remove_count)      gb_array_splice(x, index, remove_count, NULL, 0)
 
-////////////////////////////////////////////////////////////////
-//
-// Hashing and Checksum Functions
-//
-//
+#define gb_array_insert(x, index, item) do { \
+	isize gb__index = (index); \
+	GB_ASSERT(0 <= gb__index && gb__index <= gb_array_count(x)); \
+	if (gb_array_capacity(x) < gb_array_count(x)+1) \
+		gb_array_grow(x, 0); \
+	gb_memmove(&(x)[gb__index+1], &(x)[gb__index], gb_size_of((x)[0])*(gb_array_count(x)-gb__index)); \
+	(x)[gb__index] = (item); \
+	gb_array_count(x)++; \
+} while (0)
 
-GB_EXTERN u32 gb_adler32(void const *data, isize len);
+// NOTE(bill): O(1), the last element is moved into its place
+#define gb_array_remove_unordered(x, index) do { \
+	gbArrayHeader *gb__ah = GB_ARRAY_HEADER(x); \
+	isize gb__index = (index); \
+	GB_ASSERT(0 <= gb__index && gb__index < gb__ah->count); \
+	(x)[gb__index] = (x)[--gb__ah->count]; \
+} while (0)
 
-GB_EXTERN u32 gb_crc32(void const *data, isize len);
-GB_EXTERN u64 gb_crc64(void const *data, isize len);
+// NOTE(bill): Removes every item the predicate returns true for, keeping the order of the rest (one pass)
+#define GB_ARRAY_PREDICATE_PROC(name) b32 name(void const *item, void *user_data)
+typedef GB_ARRAY_PREDICATE_PROC(gbArrayPredicateProc);
 
-GB_EXTERN u32 gb_fnv32 (void const *data, isize len);
-GB_EXTERN u64 gb_fnv64 (void const *data, isize len);
-GB_EXTERN u32 gb_fnv32a(void const *data, isize len);
-GB_EXTERN u64 gb_fnv64a(void const *data, isize len);
+#define gb_array_remove_if(x, predicate, user_data) do { \
+	GB_ARRAY_HEADER(x)->count = gb__array_remove_if((x), gb_size_of(*(x)), (predicate), (user_data)); \
+} while (0)
+
+// NOTE(bill): Do not use the things below directly, use the macros
+GB_DEF void *gb__array_splice   (void *array, isize element_size, isize index, isize remove_count, void const *items, isize item_count);
+GB_DEF isize gb__array_remove_if(void *array, isize element_size, gbArrayPredicateProc *predicate, void *user_data);
 
-// NOTE(bill): Default seed of 0x9747b28c
-// NOTE(bill): I prefer using murmur64 for most hashes
-GB_EXTERN u32 gb_murmur32(void const *data, isize len);
-GB_EXTERN u64 gb_murmur64(void const *data, isize len);
 
-GB_EXTERN u32 gb_murmur32_seed(void const *data, isize len, u32 seed);
-GB_EXTERN u64 gb_murmur64_seed(void const *data, isize len, u64 seed);
 
 
 ////////////////////////////////////////////////////////////////
 //
-// Instantiated Hash Table
-//
-// This is an attempt to implement a templated hash table
-// NOTE(bill): The key is aways a u64 for simplicity and you will _probably_ _never_ need anything bigger.
-//
-// Hash table type and function declaration, call: GB_TABLE_DECLARE(PREFIX, NAME, N, VALUE)
-// Hash table function definitions, call: GB_TABLE_DEFINE(NAME, N, VALUE)
-//
-//     PREFIX  - a prefix for function prototypes e.g. extern, static, etc.
-//     NAME    - Name of the Hash Table
-//     FUNC    - the name will prefix function names
-//     VALUE   - the type of the value to be stored
+// Small Array
 //
-// NOTE(bill): I really wish C had decent metaprogramming capabilities (and no I don't mean C++'s templates either)
+// NOTE(bill): Like gbArray but the first N items live inline (on the stack or in a struct) and the
+// allocator is only used once it grows past N. There is no pointer to its own buffer so it can be
+// copied by value while inline, access the items with gb_small_array_data.
 //
 
-typedef struct gbHashTableFindResult {
-	isize hash_index;
-	isize entry_prev;
-	isize entry_index;
-} gbHashTableFindResult;
+#if 0 // Example
+typedef gbSmallArray(int, 8) IntList;
 
-#define GB_TABLE(PREFIX, NAME, FUNC, VALUE) \
-	GB_TABLE_DECLARE(PREFIX, NAME, FUNC, VALUE); \
-	GB_TABLE_DEFINE(NAME, FUNC, VALUE);
+void foo(void) {
+	isize i;
+	IntList list;
+	gb_small_array_init(list, gb_heap_allocator());
 
-#define GB_TABLE_DECLARE(PREFIX, NAME, FUNC, VALUE) \
-typedef struct GB_JOIN2(NAME,Entry) { \
-	u64 key; \
-	isize next; \
-	VALUE value; \
-} GB_JOIN2(NAME,Entry); \
-\
-typedef struct NAME { \
-	gbArray(isize) hashes; \
-	gbArray(GB_JOIN2(NAME,Entry)) entries; \
-} NAME; \
-\
-PREFIX void                  GB_JOIN2(FUNC,init)       (NAME *h, gbAllocator a); \
-PREFIX void                  GB_JOIN2(FUNC,destroy)    (NAME *h); \
-PREFIX VALUE *               GB_JOIN2(FUNC,get)        (NAME *h, u64 key); \
-PREFIX void                  GB_JOIN2(FUNC,set)        (NAME *h, u64 key, VALUE value); \
-PREFIX void                  GB_JOIN2(FUNC,grow)       (NAME *h); \
-PREFIX void                  GB_JOIN2(FUNC,rehash)     (NAME *h, isize new_count); \
+	for (i = 0; i < 4; i++)
+		gb_small_array_append(list, cast(int)i); // NOTE(bill): No allocation
+	for (i = 0; i < list.count; i++)
+		gb_printf("%d\n", gb_small_array_data(list)[i]);
+
+	gb_small_array_free(list);
+}
+#endif
+
+#define gbSmallArray(Type, N) struct { \
+	gbAllocator allocator; \
+	isize       count; \
+	isize       capacity; \
+	Type *      heap; /* NOTE(bill): NULL while inline */ \
+	Type        inline_data[N]; \
+}
+
+#define gb_small_array_init(x, allocator_) do { \
+	(x).allocator = (allocator_); \
+	(x).count     = 0; \
+	(x).capacity  = gb_count_of((x).inline_data); \
+	(x).heap      = NULL; \
+} while (0)
+
+#define gb_small_array_free(x) do { \
+	if ((x).heap) gb_free((x).allocator, (x).heap); \
+	(x).heap     = NULL; \
+	(x).count    = 0; \
+	(x).capacity = gb_count_of((x).inline_data); \
+} while (0)
+
+#define gb_small_array_data(x)      ((x).heap ? (x).heap : (x).inline_data)
+#define gb_small_array_is_inline(x) ((x).heap == NULL)
+
+#define gb_small_array_reserve(x, new_capacity) do { \
+	if ((x).capacity < (new_capacity)) { \
+		void **gb__heap_ = cast(void **)&(x).heap; \
+		*gb__heap_ = gb__small_array_set_capacity((x).allocator, (x).heap, (x).inline_data, (x).count, (new_capacity), gb_size_of((x).inline_data[0])); \
+		(x).capacity = (new_capacity); \
+	} \
+} while (0)
+
+#define gb_small_array_grow(x, min_capacity) do { \
+	isize gb__new_capacity = GB_ARRAY_GROW_FORMULA((x).capacity); \
+	if (gb__new_capacity < (min_capacity)) \
+		gb__new_capacity = (min_capacity); \
+	gb_small_array_reserve(x, gb__new_capacity); \
+} while (0)
+
+#define gb_small_array_append(x, item) do { \
+	if ((x).capacity < (x).count+1) \
+		gb_small_array_grow(x, 0); \
+	gb_small_array_data(x)[(x).count++] = (item); \
+} while (0)
+
+#define gb_small_array_appendv(x, items, item_count) do { \
+	GB_ASSERT(gb_size_of((items)[0]) == gb_size_of((x).inline_data[0])); \
+	if ((x).capacity < (x).count+(item_count)) \
+		gb_small_array_grow(x, (x).count+(item_count)); \
+	gb_memcopy(gb_small_array_data(x) + (x).count, (items), gb_size_of((x).inline_data[0])*(item_count)); \
+	(x).count += (item_count); \
+} while (0)
+
+#define gb_small_array_pop(x)   do { GB_ASSERT((x).count > 0); (x).count--; } while (0)
+#define gb_small_array_clear(x) do { (x).count = 0; } while (0)
+
+#define gb_small_array_resize(x, new_count) do { \
+	if ((x).capacity < (new_count)) \
+		gb_small_array_grow(x, (new_count)); \
+	(x).count = (new_count); \
+} while (0)
+
+#define gb_small_array_remove_unordered(x, index) do { \
+	isize gb__index = (index); \
+	GB_ASSERT(0 <= gb__index && gb__index < (x).count); \
+	gb_small_array_data(x)[gb__index] = gb_small_array_data(x)[--(x).count]; \
+} while (0)
+
+// NOTE(bill): Do not use the thing below directly, use the macros
+GB_DEF void *gb__small_array_set_capacity(gbAllocator a, void *heap, void const *inline_data, isize count, isize capacity, isize element_size);
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Structure of Arrays
+//
+// NOTE(bill): Parallel columns with one count and capacity in a single allocation. Each column is
+// aligned (GB_SOA_DEFAULT_ALIGNMENT by default) so a loop over a couple of fields only touches those
+// fields' cache lines and can use aligned SIMD loads. Column pointers change when it grows.
+//
+
+#if 0 // Example
+void foo(void) {
+	isize i, sizes[] = {gb_size_of(f32), gb_size_of(f32), gb_size_of(u32)};
+	gbSoa particles;
+	f32 *x, *vx;
+
+	gb_soa_init(&particles, gb_heap_allocator(), sizes, gb_count_of(sizes));
+	for (i = 0; i < 100; i++) {
+		isize index = gb_soa_push(&particles);
+		gb_soa_column(&particles, f32, 0)[index] = 0.0f;
+		gb_soa_column(&particles, f32, 1)[index] = 1.0f;
+		gb_soa_column(&particles, u32, 2)[index] = cast(u32)i;
+	}
+
+	x  = gb_soa_column(&particles, f32, 0);
+	vx = gb_soa_column(&particles, f32, 1);
+	for (i = 0; i < particles.count; i++)
+		x[i] += vx[i];
+
+	gb_soa_free(&particles);
+}
+#endif
+
+#ifndef GB_SOA_MAX_COLUMNS
+#define GB_SOA_MAX_COLUMNS 16
+#endif
+
+#ifndef GB_SOA_DEFAULT_ALIGNMENT
+#define GB_SOA_DEFAULT_ALIGNMENT 64
+#endif
+
+typedef struct gbSoa {
+	gbAllocator allocator;
+	void *      data;
+	isize       count;
+	isize       capacity;
+	isize       alignment;
+	isize       column_count;
+	isize       column_sizes[GB_SOA_MAX_COLUMNS];
+	void *      columns[GB_SOA_MAX_COLUMNS];
+} gbSoa;
+
+GB_DEF void  gb_soa_init      (gbSoa *soa, gbAllocator a, isize const *column_sizes, isize column_count);
+GB_DEF void  gb_soa_init_align(gbSoa *soa, gbAllocator a, isize const *column_sizes, isize column_count, isize alignment);
+GB_DEF void  gb_soa_free      (gbSoa *soa);
+
+GB_DEF void  gb_soa_set_capacity    (gbSoa *soa, isize capacity);
+GB_DEF void  gb_soa_reserve         (gbSoa *soa, isize capacity);
+GB_DEF void  gb_soa_resize          (gbSoa *soa, isize count); // NOTE(bill): New items are not cleared
+GB_DEF isize gb_soa_push            (gbSoa *soa);              // NOTE(bill): Returns the index of the new item
+GB_DEF void  gb_soa_remove_unordered(gbSoa *soa, isize index);
+GB_DEF void  gb_soa_clear           (gbSoa *soa);
+
+#define gb_soa_column(soa, Type, column) (cast(Type *)gb__soa_column((soa), (column), gb_size_of(Type)))
+
+// NOTE(bill): Do not use the thing below directly, use the macro
+GB_DEF void *gb__soa_column(gbSoa *soa, isize column, isize element_size);
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Handle Pool
+//
+// NOTE(bill): Fixed size items are stored densely and referred to by handles (slot index + generation)
+// which stay valid however the storage moves. Destroying an item bumps the generation of its slot
+// so stale handles are caught. Create, destroy and lookup are O(1).
+// The items can be iterated densely with gb_handle_pool_item_at, [0, count) are all alive.
+//
+// IMPORTANT NOTE(bill): Pointers to items are only valid until the next create or destroy, keep the handle
+//
+
+#if defined(GB_HANDLE_32_BIT)
+typedef u32 gbHandle;
+#define GB_HANDLE_INDEX_BITS 20
+#else
+typedef u64 gbHandle;
+#define GB_HANDLE_INDEX_BITS 32
+#endif
+
+#define GB_HANDLE_INVALID         cast(gbHandle)0 // NOTE(bill): Generations start at 1 so no handle is ever 0
+#define GB_HANDLE_INDEX_MASK      ((cast(gbHandle)1 << GB_HANDLE_INDEX_BITS) - 1)
+#define GB_HANDLE_GENERATION_MASK (~cast(gbHandle)0 >> GB_HANDLE_INDEX_BITS)
+
+#define gb_handle_index(h)      cast(u32)((h) & GB_HANDLE_INDEX_MASK)
+#define gb_handle_generation(h) cast(u32)((h) >> GB_HANDLE_INDEX_BITS)
+
+typedef struct gbHandleSlot {
+	u32 generation;
+	u32 index; // NOTE(bill): Index of the item if alive, next free slot otherwise
+} gbHandleSlot;
+
+typedef struct gbHandlePool {
+	gbAllocator   backing;
+	isize         item_size;
+	isize         item_align;
+
+	void *        items;      // NOTE(bill): Dense, [0, count) are alive
+	u32 *         item_slots; // NOTE(bill): Slot of each item
+	gbHandleSlot *slots;
+	isize         count;
+	isize         capacity;
+	isize         slot_count;
+	u32           free_slot;
+} gbHandlePool;
+
+GB_DEF void     gb_handle_pool_init     (gbHandlePool *pool, gbAllocator backing, isize item_size, isize item_align);
+GB_DEF void     gb_handle_pool_free     (gbHandlePool *pool);
+GB_DEF void     gb_handle_pool_clear    (gbHandlePool *pool); // NOTE(bill): Destroys every item
+GB_DEF b32      gb_handle_pool_reserve  (gbHandlePool *pool, isize capacity);
+
+GB_DEF gbHandle gb_handle_pool_create   (gbHandlePool *pool, void **item_out); // NOTE(bill): The item is zeroed, GB_HANDLE_INVALID if out of memory
+GB_DEF b32      gb_handle_pool_destroy  (gbHandlePool *pool, gbHandle handle); // NOTE(bill): false if the handle is stale
+GB_DEF void *   gb_handle_pool_get      (gbHandlePool *pool, gbHandle handle); // NOTE(bill): NULL if the handle is stale
+GB_DEF b32      gb_handle_pool_is_valid (gbHandlePool *pool, gbHandle handle);
+
+GB_DEF void *   gb_handle_pool_item_at  (gbHandlePool *pool, isize index);
+GB_DEF gbHandle gb_handle_pool_handle_at(gbHandlePool *pool, isize index);
+
+#define gb_handle_pool_init_type(pool, backing, Type) gb_handle_pool_init(pool, backing, gb_size_of(Type), gb_align_of(Type))
+#define gb_handle_pool_items(pool, Type)              (cast(Type *)(pool)->items)
+
+
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Hashing and Checksum Functions
+//
+//
+
+GB_EXTERN u32 gb_adler32(void const *data, isize len);
+
+GB_EXTERN u32 gb_crc32(void const *data, isize len);
+GB_EXTERN u64 gb_crc64(void const *data, isize len);
+
+GB_EXTERN u32 gb_fnv32 (void const *data, isize len);
+GB_EXTERN u64 gb_fnv64 (void const *data, isize len);
+GB_EXTERN u32 gb_fnv32a(void const *data, isize len);
+GB_EXTERN u64 gb_fnv64a(void const *data, isize len);
+
+// NOTE(bill): Default seed of 0x9747b28c
+// NOTE(bill): I prefer using murmur64 for most hashes
+GB_EXTERN u32 gb_murmur32(void const *data, isize len);
+GB_EXTERN u64 gb_murmur64(void const *data, isize len);
+
+GB_EXTERN u32 gb_murmur32_seed(void const *data, isize len, u32 seed);
+GB_EXTERN u64 gb_murmur64_seed(void const *data, isize len, u64 seed);
+
+
+////////////////////////////////////////////////////////////////
+//
+// Instantiated Hash Table
+//
+// This is an attempt to implement a templated hash table
+// NOTE(bill): The key is aways a u64 for simplicity and you will _probably_ _never_ need anything bigger.
+//
+// Hash table type and function declaration, call: GB_TABLE_DECLARE(PREFIX, NAME, N, VALUE)
+// Hash table function definitions, call: GB_TABLE_DEFINE(NAME, N, VALUE)
+//
+//     PREFIX  - a prefix for function prototypes e.g. extern, static, etc.
+//     NAME    - Name of the Hash Table
+//     FUNC    - the name will prefix function names
+//     VALUE   - the type of the value to be stored
+//
+// NOTE(bill): I really wish C had decent metaprogramming capabilities (and no I don't mean C++'s templates either)
+//
+
+typedef struct gbHashTableFindResult {
+	isize hash_index;
+	isize entry_prev;
+	isize entry_index;
+} gbHashTableFindResult;
+
+#define GB_TABLE(PREFIX, NAME, FUNC, VALUE) \
+	GB_TABLE_DECLARE(PREFIX, NAME, FUNC, VALUE); \
+	GB_TABLE_DEFINE(NAME, FUNC, VALUE);
+
+#define GB_TABLE_DECLARE(PREFIX, NAME, FUNC, VALUE) \
+typedef struct GB_JOIN2(NAME,Entry) { \
+	u64 key; \
+	isize next; \
+	VALUE value; \
+} GB_JOIN2(NAME,Entry); \
+\
+typedef struct NAME { \
+	gbArray(isize) hashes; \
+	gbArray(GB_JOIN2(NAME,Entry)) entries; \
+} NAME; \
+\
+PREFIX void                  GB_JOIN2(FUNC,init)       (NAME *h, gbAllocator a); \
+PREFIX void                  GB_JOIN2(FUNC,destroy)    (NAME *h); \
+PREFIX VALUE *               GB_JOIN2(FUNC,get)        (NAME *h, u64 key); \
+PREFIX void                  GB_JOIN2(FUNC,set)        (NAME *h, u64 key, VALUE value); \
+PREFIX void                  GB_JOIN2(FUNC,grow)       (NAME *h); \
+PREFIX void                  GB_JOIN2(FUNC,rehash)     (NAME *h, isize new_count); \
 
 
 
@@ -2077,6 +3046,142 @@ GB_DEF char const *gb_path_extension    (char const *path);
 GB_DEF char *      gb_path_get_full_name(gbAllocator a, char const *path);
 
 
+////////////////////////////////////////////////////////////////
+//
+// Allocation Traces
+//
+// NOTE(bill): gbTraceAllocator wraps another allocator and writes every event to a gbFile.
+// Allocations are given ids (stored in a small header in front of them) so a trace can be
+// replayed against any allocator with gb_trace_replay to compare throughput, peak RSS and
+// fragmentation. The allocator must be able to serve every request in the trace (e.g. a gbPool
+// only serves its block size), failed allocations are counted and skipped.
+//
+// File layout: gbTraceFileHeader then gbTraceEvent[], written as the native structs so a trace
+// only replays on a machine with the same byte order (the magic will not match otherwise)
+//
+
+#define GB_TRACE_MAGIC   0x54424740 // NOTE(bill): "@GBT"
+#define GB_TRACE_VERSION 1
+
+#ifndef GB_TRACE_BUFFER_COUNT
+#define GB_TRACE_BUFFER_COUNT 1024
+#endif
+
+#ifndef GB_TRACE_RSS_SAMPLE_RATE
+#define GB_TRACE_RSS_SAMPLE_RATE 4096 // NOTE(bill): Events between samples of the resident size during a replay
+#endif
+
+typedef struct gbTraceFileHeader {
+	u32 magic;
+	u32 version;
+} gbTraceFileHeader;
+
+typedef struct gbTraceEvent {
+	u64 timestamp;      // NOTE(bill): gb_rdtsc
+	u32 id;
+	u8  type;           // NOTE(bill): gbAllocationType
+	u8  alignment_log2;
+	u16 padding;
+	i64 size;
+	i64 old_size;
+} gbTraceEvent;
+GB_STATIC_ASSERT(gb_size_of(gbTraceEvent) == 32);
+
+typedef struct gbTraceAllocator {
+	gbAllocator  backing;
+	gbFile *     file;
+	gbMutex      mutex;
+	u32          next_id;
+	b32          error; // NOTE(bill): Set if a write failed, no more events are written
+	i64          event_count;
+	isize        buffer_count;
+	gbTraceEvent buffer[GB_TRACE_BUFFER_COUNT];
+} gbTraceAllocator;
+
+// NOTE(bill): The file must be open for writing, the header is written straight away
+GB_DEF b32  gb_trace_allocator_init (gbTraceAllocator *t, gbAllocator backing, gbFile *file);
+GB_DEF void gb_trace_allocator_flush(gbTraceAllocator *t);
+GB_DEF void gb_trace_allocator_free (gbTraceAllocator *t); // NOTE(bill): Flushes, does not close the file
+
+// Allocation Types: alloc, free, free_all, resize
+GB_DEF gbAllocator gb_trace_allocator(gbTraceAllocator *t);
+GB_DEF GB_ALLOCATOR_PROC(gb_trace_allocator_proc);
+
+
+typedef struct gbTraceReplay {
+	i64   event_count;
+	i64   failed_count;    // NOTE(bill): Allocations that returned NULL
+	u64   trace_cycles;    // NOTE(bill): Span of the recorded timestamps
+	f64   seconds;
+	f64   events_per_second;
+	isize peak_live_bytes; // NOTE(bill): Of the requested sizes
+	isize peak_rss_delta;  // NOTE(bill): Largest sampled growth of the resident size
+	isize peak_rss;        // NOTE(bill): High water mark of the process
+	f64   fragmentation;   // NOTE(bill): 1 - peak_live_bytes/peak_rss_delta
+} gbTraceReplay;
+
+// NOTE(bill): Memory still live at the end of the trace is freed afterwards
+GB_DEF b32  gb_trace_replay       (gbFile *trace, gbAllocator a, gbTraceReplay *result);
+GB_DEF void gb_trace_replay_report(gbTraceReplay *r, char const *name);
+
+
+////////////////////////////////////////////////////////////////
+//
+// Mapped Arena
+//
+// NOTE(bill): A gbArena whose memory is a memory mapped file. When it is opened again the contents are
+// just mapped back in (no deserialization). Either keep the same base address (pass it to the first
+// gb_mapped_arena_open, later opens reuse the saved one) so plain pointers stay valid, or only store
+// offsets/relative pointers in it (gb_mapped_arena_offset/pointer, gbRelativePointer).
+// gb_mapped_arena_sync writes the used size and a gb_crc64 of the contents to the header.
+//
+
+#define GB_MAPPED_ARENA_MAGIC       0x414e524141424740ull // NOTE(bill): "@GBAARNA"
+#define GB_MAPPED_ARENA_VERSION     1
+#define GB_MAPPED_ARENA_DATA_OFFSET gb_kilobytes(4) // NOTE(bill): The header has its own page so the data is page aligned
+
+typedef struct gbMappedArenaHeader {
+	u64 magic;
+	u32 version;
+	u32 data_offset;
+	u64 base_address; // NOTE(bill): 0 if it can be mapped anywhere
+	u64 total_size;   // NOTE(bill): Of the file
+	u64 used;
+	u64 checksum;     // NOTE(bill): gb_crc64 of the used bytes
+	i64 root;         // NOTE(bill): Offset of the root object, -1 if none
+	u64 padding;
+} gbMappedArenaHeader;
+
+typedef struct gbMappedArena {
+	gbArena              arena;
+	gbMappedArenaHeader *header;
+	gbVirtualMemory      view;
+	gbFile               file;
+	void *               mapping; // NOTE(bill): Windows only
+} gbMappedArena;
+
+// NOTE(bill): Creates the file with `size` bytes if it does not exist (size is ignored otherwise).
+// base_address may be NULL to use the saved one (or anywhere for a new file)
+GB_DEF gbFileError gb_mapped_arena_open (gbMappedArena *m, char const *filename, isize size, void *base_address, b32 verify_checksum);
+GB_DEF b32         gb_mapped_arena_sync (gbMappedArena *m);
+GB_DEF void        gb_mapped_arena_close(gbMappedArena *m); // NOTE(bill): Syncs first
+
+GB_DEF void  gb_mapped_arena_set_root(gbMappedArena *m, void *root);
+GB_DEF void *gb_mapped_arena_root    (gbMappedArena *m);
+
+GB_DEF i64   gb_mapped_arena_offset (gbMappedArena *m, void const *ptr); // NOTE(bill): -1 for NULL
+GB_DEF void *gb_mapped_arena_pointer(gbMappedArena *m, i64 offset);
+
+GB_DEF gbAllocator gb_mapped_arena_allocator(gbMappedArena *m);
+
+
+// NOTE(bill): Offset from its own address, 0 is NULL. Valid wherever the memory is mapped
+typedef i64 gbRelativePointer;
+
+GB_DEF void  gb_relative_pointer_set(gbRelativePointer *rp, void const *ptr);
+GB_DEF void *gb_relative_pointer_get(gbRelativePointer const *rp);
+
+
 ////////////////////////////////////////////////////////////////
 //
 // Printing
@@ -3629,6 +4734,39 @@ void gb_assert_handler(char const *prefix, char const *condition, char const *fi
 	gb_printf_err("\n");
 }
 
+// NOTE(bill): Index of the lowest/highest set bit, x must not be 0
+gb_inline isize gb__bit_scan_forward(u64 x) {
+#if defined(GB_COMPILER_MSVC) && defined(GB_ARCH_64_BIT)
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return cast(isize)index;
+#elif defined(GB_COMPILER_MSVC)
+	unsigned long index;
+	if (_BitScanForward(&index, cast(u32)x))
+		return cast(isize)index;
+	_BitScanForward(&index, cast(u32)(x >> 32));
+	return cast(isize)index + 32;
+#else
+	return cast(isize)__builtin_ctzll(x);
+#endif
+}
+
+gb_inline isize gb__bit_scan_reverse(u64 x) {
+#if defined(GB_COMPILER_MSVC) && defined(GB_ARCH_64_BIT)
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return cast(isize)index;
+#elif defined(GB_COMPILER_MSVC)
+	unsigned long index;
+	if (_BitScanReverse(&index, cast(u32)(x >> 32)))
+		return cast(isize)index + 32;
+	_BitScanReverse(&index, cast(u32)x);
+	return cast(isize)index;
+#else
+	return 63 - cast(isize)__builtin_clzll(x);
+#endif
+}
+
 b32 gb_is_power_of_two(isize x) {
 	if (x <= 0)
 		return false;
@@ -3659,7 +4797,7 @@ gb_inline void gb_zero_size(void *ptr, isize size) { gb_memset(ptr, 0, size); }
 #pragma intrinsic(__movsb)
 #endif
 
-gb_inline void *gb_memcopy(void *dest, void const *source, isize n) {
+gb_internal void *gb__memcopy_generic(void *dest, void const *source, isize n) {
 #if defined(_MSC_VER)
 	if (dest == NULL) {
 		return NULL;
@@ -3866,7 +5004,7 @@ gb_inline void *gb_memmove(void *dest, void const *source, isize n) {
 	return dest;
 }
 
-gb_inline void *gb_memset(void *dest, u8 c, isize n) {
+gb_internal void *gb__memset_generic(void *dest, u8 c, isize n) {
 	u8 *s = cast(u8 *)dest;
 	isize k;
 	u32 c32 = ((u32)-1)/255 * c;
@@ -3935,15 +5073,26 @@ gb_inline void *gb_memset(void *dest, u8 c, isize n) {
 	return dest;
 }
 
-gb_inline i32 gb_memcompare(void const *s1, void const *s2, isize size) {
-	// TODO(bill): Heavily optimize
+#if defined(GB_CPU_X86)
+gb_internal void *gb__memset_erms(void *dest, u8 c, isize n) {
+	// NOTE(bill): rep stosb has a startup cost which only pays off for larger sizes
+	if (n < 256)
+		return gb__memset_generic(dest, c, n);
+#if defined(GB_COMPILER_MSVC)
+	__stosb(cast(u8 *)dest, c, n);
+#else
+	void *d = dest;
+	__asm__ __volatile__("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+#endif
+	return dest;
+}
+#endif
+
+
+gb_internal i32 gb__memcompare_generic(void const *s1, void const *s2, isize size) {
 	u8 const *s1p8 = cast(u8 const *)s1;
 	u8 const *s2p8 = cast(u8 const *)s2;
 
-	if (s1 == NULL || s2 == NULL) {
-		return 0;
-	}
-
 	while (size--) {
 		if (*s1p8 != *s2p8) {
 			return (*s1p8 - *s2p8);
@@ -3953,45 +5102,12 @@ gb_inline i32 gb_memcompare(void const *s1, void const *s2, isize size) {
 	return 0;
 }
 
-void gb_memswap(void *i, void *j, isize size) {
-	if (i == j) return;
-
-	if (size == 4) {
-		gb_swap(u32, *cast(u32 *)i, *cast(u32 *)j);
-	} else if (size == 8) {
-		gb_swap(u64, *cast(u64 *)i, *cast(u64 *)j);
-	} else if (size < 8) {
-		u8 *a = cast(u8 *)i;
-		u8 *b = cast(u8 *)j;
-		if (a != b) {
-			while (size--) {
-				gb_swap(u8, *a, *b);
-				a++, b++;
-			}
-		}
-	} else {
-		char buffer[256];
-
-		// TODO(bill): Is the recursion ever a problem?
-		while (size > gb_size_of(buffer)) {
-			gb_memswap(i, j, gb_size_of(buffer));
-			i = gb_pointer_add(i, gb_size_of(buffer));
-			j = gb_pointer_add(j, gb_size_of(buffer));
-			size -= gb_size_of(buffer);
-		}
-
-		gb_memcopy(buffer, i,      size);
-		gb_memcopy(i,      j,      size);
-		gb_memcopy(j,      buffer, size);
-	}
-}
-
 #define GB__ONES        (cast(usize)-1/U8_MAX)
 #define GB__HIGHS       (GB__ONES * (U8_MAX/2+1))
-#define GB__HAS_ZERO(x) ((x)-GB__ONES & ~(x) & GB__HIGHS)
+#define GB__HAS_ZERO(x) (((x)-GB__ONES) & ~(x) & GB__HIGHS)
 
 
-void const *gb_memchr(void const *data, u8 c, isize n) {
+gb_internal void const *gb__memchr_generic(void const *data, u8 c, isize n) {
 	u8 const *s = cast(u8 const *)data;
 	while ((cast(uintptr)s & (sizeof(usize)-1)) &&
 	       n && *s != c) {
@@ -4017,8 +5133,18 @@ void const *gb_memchr(void const *data, u8 c, isize n) {
 }
 
 
-void const *gb_memrchr(void const *data, u8 c, isize n) {
+gb_internal void const *gb__memrchr_generic(void const *data, u8 c, isize n) {
 	u8 const *s = cast(u8 const *)data;
+	while (n && (cast(uintptr)(s+n) & (sizeof(usize)-1))) {
+		n--;
+		if (s[n] == c)
+			return cast(void const *)(s + n);
+	}
+	if (n >= gb_size_of(usize)) {
+		usize k = GB__ONES * c;
+		while (n >= gb_size_of(usize) && !GB__HAS_ZERO(*cast(usize const *)(s+n-gb_size_of(usize)) ^ k))
+			n -= gb_size_of(usize);
+	}
 	while (n--) {
 		if (s[n] == c)
 			return cast(void const *)(s + n);
@@ -4026,1672 +5152,5306 @@ void const *gb_memrchr(void const *data, u8 c, isize n) {
 	return NULL;
 }
 
+GB_NO_ASAN gb_internal isize gb__strlen_generic(char const *str) {
+	// NOTE(bill): Reads whole aligned words so it may read past the terminator (but never into another page)
+	char const *begin = str;
+	isize const *w;
+	while (cast(uintptr)str % sizeof(usize)) {
+		if (!*str)
+			return str - begin;
+		str++;
+	}
+	w = cast(isize const *)str;
+	while (!GB__HAS_ZERO(*w)) {
+		w++;
+	}
+	str = cast(char const *)w;
+	while (*str) {
+		str++;
+	}
+	return str - begin;
+}
 
 
-gb_inline void *gb_alloc_align (gbAllocator a, isize size, isize alignment)                                { return a.proc(a.data, gbAllocation_Alloc, size, alignment, NULL, 0, GB_DEFAULT_ALLOCATOR_FLAGS); }
-gb_inline void *gb_alloc       (gbAllocator a, isize size)                                                 { return gb_alloc_align(a, size, GB_DEFAULT_MEMORY_ALIGNMENT); }
-gb_inline void  gb_free        (gbAllocator a, void *ptr)                                                  { if (ptr != NULL) a.proc(a.data, gbAllocation_Free, 0, 0, ptr, 0, GB_DEFAULT_ALLOCATOR_FLAGS); }
-gb_inline void  gb_free_all    (gbAllocator a)                                                             { a.proc(a.data, gbAllocation_FreeAll, 0, 0, NULL, 0, GB_DEFAULT_ALLOCATOR_FLAGS); }
-gb_inline void *gb_resize      (gbAllocator a, void *ptr, isize old_size, isize new_size)                  { return gb_resize_align(a, ptr, old_size, new_size, GB_DEFAULT_MEMORY_ALIGNMENT); }
-gb_inline void *gb_resize_align(gbAllocator a, void *ptr, isize old_size, isize new_size, isize alignment) { return a.proc(a.data, gbAllocation_Resize, new_size, alignment, ptr, old_size, GB_DEFAULT_ALLOCATOR_FLAGS); }
+// NOTE(bill): For unaligned scalar loads/stores, x86 does not care but the compiler might
+#if defined(GB_COMPILER_MSVC)
+typedef u16 gb__u16_unaligned;
+typedef u32 gb__u32_unaligned;
+typedef u64 gb__u64_unaligned;
+#else
+typedef u16 gb__u16_unaligned __attribute__((aligned(1), may_alias));
+typedef u32 gb__u32_unaligned __attribute__((aligned(1), may_alias));
+typedef u64 gb__u64_unaligned __attribute__((aligned(1), may_alias));
+#endif
 
-gb_inline void *gb_alloc_copy      (gbAllocator a, void const *src, isize size) {
-	return gb_memcopy(gb_alloc(a, size), src, size);
-}
-gb_inline void *gb_alloc_copy_align(gbAllocator a, void const *src, isize size, isize alignment) {
-	return gb_memcopy(gb_alloc_align(a, size, alignment), src, size);
+// NOTE(bill): Swaps never go through a buffer. The last block is loaded before anything is stored so it can
+// overlap the blocks before it, this is fine as long as i and j do not overlap each other.
+gb_internal gb_inline void gb__memswap_small(u8 *a, u8 *b, isize n) {
+	// NOTE(bill): n < 16
+	if (n >= 8) {
+		u64 a0 = *cast(gb__u64_unaligned *)a, a1 = *cast(gb__u64_unaligned *)(a+n-8);
+		u64 b0 = *cast(gb__u64_unaligned *)b, b1 = *cast(gb__u64_unaligned *)(b+n-8);
+		*cast(gb__u64_unaligned *)a = b0; *cast(gb__u64_unaligned *)(a+n-8) = b1;
+		*cast(gb__u64_unaligned *)b = a0; *cast(gb__u64_unaligned *)(b+n-8) = a1;
+	} else if (n >= 4) {
+		u32 a0 = *cast(gb__u32_unaligned *)a, a1 = *cast(gb__u32_unaligned *)(a+n-4);
+		u32 b0 = *cast(gb__u32_unaligned *)b, b1 = *cast(gb__u32_unaligned *)(b+n-4);
+		*cast(gb__u32_unaligned *)a = b0; *cast(gb__u32_unaligned *)(a+n-4) = b1;
+		*cast(gb__u32_unaligned *)b = a0; *cast(gb__u32_unaligned *)(b+n-4) = a1;
+	} else if (n > 0) {
+		u8 a0 = a[0], a1 = a[n/2], a2 = a[n-1];
+		u8 b0 = b[0], b1 = b[n/2], b2 = b[n-1];
+		a[0] = b0; a[n/2] = b1; a[n-1] = b2;
+		b[0] = a0; b[n/2] = a1; b[n-1] = a2;
+	}
 }
 
-gb_inline char *gb_alloc_str(gbAllocator a, char const *str) {
-	return gb_alloc_str_len(a, str, gb_strlen(str));
+gb_internal void gb__memswap_generic(void *i, void *j, isize n) {
+	u8 *a = cast(u8 *)i, *b = cast(u8 *)j;
+	if (n < 16) {
+		gb__memswap_small(a, b, n);
+	} else {
+		u64 at = *cast(gb__u64_unaligned *)(a+n-8), bt = *cast(gb__u64_unaligned *)(b+n-8);
+		isize k;
+		for (k = 0; k < n-8; k += 8) {
+			u64 x = *cast(gb__u64_unaligned *)(a+k), y = *cast(gb__u64_unaligned *)(b+k);
+			*cast(gb__u64_unaligned *)(a+k) = y;
+			*cast(gb__u64_unaligned *)(b+k) = x;
+		}
+		*cast(gb__u64_unaligned *)(a+n-8) = bt;
+		*cast(gb__u64_unaligned *)(b+n-8) = at;
+	}
 }
 
-gb_inline char *gb_alloc_str_len(gbAllocator a, char const *str, isize len) {
-	char *result;
-	result = cast(char *)gb_alloc_copy(a, str, len+1);
-	result[len] = '\0';
-	return result;
+gb_global gbCpuInfo gb__cpu_info;
+gb_global b32       gb__cpu_info_done;
+
+// NOTE(bill): The table starts with resolvers which select the real table on the first call through it
+gb_internal void *      gb__memcopy_resolve   (void *dest, void const *source, isize n);
+gb_internal void *      gb__memset_resolve    (void *dest, u8 c, isize n);
+gb_internal void *      gb__memcopy_non_temporal_resolve(void *dest, void const *source, isize n);
+gb_internal void *      gb__memset_non_temporal_resolve (void *dest, u8 c, isize n);
+gb_internal void        gb__memswap_resolve   (void *i, void *j, isize n);
+gb_internal i32         gb__memcompare_resolve(void const *s1, void const *s2, isize n);
+gb_internal void const *gb__memchr_resolve    (void const *data, u8 c, isize n);
+gb_internal void const *gb__memrchr_resolve   (void const *data, u8 c, isize n);
+gb_internal isize       gb__strlen_resolve    (char const *str);
+
+gb_global gbCpuDispatch gb__cpu_dispatch = {
+	0,
+	0,
+	gb__memcopy_resolve,
+	gb__memset_resolve,
+	gb__memcopy_non_temporal_resolve,
+	gb__memset_non_temporal_resolve,
+	gb__memswap_resolve,
+	gb__memcompare_resolve,
+	gb__memchr_resolve,
+	gb__memrchr_resolve,
+	gb__strlen_resolve,
+};
+
+#if defined(GB_CPU_X86)
+// NOTE(bill): SIMD kernels. Small sizes use overlapping loads/stores from both ends (no loops or byte tails),
+// bigger ones align the destination and the last block is written with an overlapping unaligned store.
+// At gb__cpu_dispatch.non_temporal_threshold streaming stores are used so huge copies do not evict the caches,
+// the _nt variants stream at any size that reaches the aligned loop.
+
+gb_internal gb_inline void gb__memcopy_small(u8 *d, u8 const *s, isize n) {
+	// NOTE(bill): n <= 16
+	if (n >= 8) {
+		u64 a = *cast(gb__u64_unaligned const *)s, b = *cast(gb__u64_unaligned const *)(s+n-8);
+		*cast(gb__u64_unaligned *)d = a; *cast(gb__u64_unaligned *)(d+n-8) = b;
+	} else if (n >= 4) {
+		u32 a = *cast(gb__u32_unaligned const *)s, b = *cast(gb__u32_unaligned const *)(s+n-4);
+		*cast(gb__u32_unaligned *)d = a; *cast(gb__u32_unaligned *)(d+n-4) = b;
+	} else if (n > 0) {
+		u8 a = s[0], b = s[n/2], c = s[n-1];
+		d[0] = a; d[n/2] = b; d[n-1] = c;
+	}
 }
 
+gb_internal gb_inline void gb__memset_small(u8 *d, u8 c, isize n) {
+	// NOTE(bill): n <= 16
+	u64 c64 = cast(u64)c * 0x0101010101010101ull;
+	if (n >= 8) {
+		*cast(gb__u64_unaligned *)d = c64; *cast(gb__u64_unaligned *)(d+n-8) = c64;
+	} else if (n >= 4) {
+		*cast(gb__u32_unaligned *)d = cast(u32)c64; *cast(gb__u32_unaligned *)(d+n-4) = cast(u32)c64;
+	} else if (n > 0) {
+		d[0] = c; d[n/2] = c; d[n-1] = c;
+	}
+}
 
-gb_inline void *gb_default_resize_align(gbAllocator a, void *old_memory, isize old_size, isize new_size, isize alignment) {
-	if (!old_memory) return gb_alloc_align(a, new_size, alignment);
+#ifndef GB_MEMCOPY_ERMS_THRESHOLD
+#define GB_MEMCOPY_ERMS_THRESHOLD 2048 // NOTE(bill): With ERMS, rep movsb beats the vector loop from about here up to the non-temporal threshold
+#endif
 
-	if (new_size == 0) {
-		gb_free(a, old_memory);
-		return NULL;
+gb_internal gb_inline b32 gb__memcopy_use_erms(isize n, isize nt) {
+	return (gb__cpu_dispatch.features & gbCpuFeature_ERMS) && n >= GB_MEMCOPY_ERMS_THRESHOLD && (n < nt || nt <= 0);
+}
+
+gb_internal gb_inline void gb__memcopy_erms(void *dest, void const *source, isize n) {
+#if defined(GB_COMPILER_MSVC)
+	__movsb(cast(u8 *)dest, cast(u8 const *)source, n);
+#else
+	__asm__ __volatile__("rep movsb" : "+D"(dest), "+S"(source), "+c"(n) : : "memory");
+#endif
+}
+
+gb_internal gb_inline GB_TARGET("sse2") void *gb__memcopy_sse2_ex(void *dest, void const *source, isize n, isize nt) {
+	u8 *d = cast(u8 *)dest;
+	u8 const *s = cast(u8 const *)source;
+
+	if (n <= 16) {
+		gb__memcopy_small(d, s, n);
+	} else if (n <= 32) {
+		__m128i a = _mm_loadu_si128(cast(__m128i const *)s);
+		__m128i b = _mm_loadu_si128(cast(__m128i const *)(s+n-16));
+		_mm_storeu_si128(cast(__m128i *)d, a);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), b);
+	} else if (n <= 64) {
+		__m128i a = _mm_loadu_si128(cast(__m128i const *)s);
+		__m128i b = _mm_loadu_si128(cast(__m128i const *)(s+16));
+		__m128i c = _mm_loadu_si128(cast(__m128i const *)(s+n-32));
+		__m128i e = _mm_loadu_si128(cast(__m128i const *)(s+n-16));
+		_mm_storeu_si128(cast(__m128i *)d, a);
+		_mm_storeu_si128(cast(__m128i *)(d+16), b);
+		_mm_storeu_si128(cast(__m128i *)(d+n-32), c);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), e);
+	} else if (gb__memcopy_use_erms(n, nt)) {
+		gb__memcopy_erms(d, s, n);
+	} else {
+		__m128i head = _mm_loadu_si128(cast(__m128i const *)s);
+		__m128i t0 = _mm_loadu_si128(cast(__m128i const *)(s+n-64));
+		__m128i t1 = _mm_loadu_si128(cast(__m128i const *)(s+n-48));
+		__m128i t2 = _mm_loadu_si128(cast(__m128i const *)(s+n-32));
+		__m128i t3 = _mm_loadu_si128(cast(__m128i const *)(s+n-16));
+		isize skew = 16 - (cast(uintptr)d & 15);
+		u8 *dd = d + skew, *end = d + n - 64;
+		u8 const *ss = s + skew;
+
+		if (nt > 0 && n >= nt) {
+			for (; dd < end; dd += 64, ss += 64) {
+				__m128i a = _mm_loadu_si128(cast(__m128i const *)(ss+ 0));
+				__m128i b = _mm_loadu_si128(cast(__m128i const *)(ss+16));
+				__m128i c = _mm_loadu_si128(cast(__m128i const *)(ss+32));
+				__m128i e = _mm_loadu_si128(cast(__m128i const *)(ss+48));
+				_mm_stream_si128(cast(__m128i *)(dd+ 0), a);
+				_mm_stream_si128(cast(__m128i *)(dd+16), b);
+				_mm_stream_si128(cast(__m128i *)(dd+32), c);
+				_mm_stream_si128(cast(__m128i *)(dd+48), e);
+			}
+			_mm_sfence();
+		} else {
+			for (; dd < end; dd += 64, ss += 64) {
+				__m128i a = _mm_loadu_si128(cast(__m128i const *)(ss+ 0));
+				__m128i b = _mm_loadu_si128(cast(__m128i const *)(ss+16));
+				__m128i c = _mm_loadu_si128(cast(__m128i const *)(ss+32));
+				__m128i e = _mm_loadu_si128(cast(__m128i const *)(ss+48));
+				_mm_store_si128(cast(__m128i *)(dd+ 0), a);
+				_mm_store_si128(cast(__m128i *)(dd+16), b);
+				_mm_store_si128(cast(__m128i *)(dd+32), c);
+				_mm_store_si128(cast(__m128i *)(dd+48), e);
+			}
+		}
+		_mm_storeu_si128(cast(__m128i *)(d+n-64), t0);
+		_mm_storeu_si128(cast(__m128i *)(d+n-48), t1);
+		_mm_storeu_si128(cast(__m128i *)(d+n-32), t2);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), t3);
+		_mm_storeu_si128(cast(__m128i *)d, head);
 	}
+	return dest;
+}
 
-	if (new_size < old_size)
-		new_size = old_size;
+gb_internal GB_TARGET("sse2") void *gb__memcopy_sse2   (void *dest, void const *source, isize n) { return gb__memcopy_sse2_ex(dest, source, n, gb__cpu_dispatch.non_temporal_threshold); }
+gb_internal GB_TARGET("sse2") void *gb__memcopy_sse2_nt(void *dest, void const *source, isize n) { return gb__memcopy_sse2_ex(dest, source, n, 1); }
 
-	if (old_size == new_size) {
-		return old_memory;
+gb_internal gb_inline GB_TARGET("avx2") void *gb__memcopy_avx2_ex(void *dest, void const *source, isize n, isize nt) {
+	u8 *d = cast(u8 *)dest;
+	u8 const *s = cast(u8 const *)source;
+
+	if (n <= 16) {
+		gb__memcopy_small(d, s, n);
+	} else if (n <= 32) {
+		__m128i a = _mm_loadu_si128(cast(__m128i const *)s);
+		__m128i b = _mm_loadu_si128(cast(__m128i const *)(s+n-16));
+		_mm_storeu_si128(cast(__m128i *)d, a);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), b);
+	} else if (n <= 64) {
+		__m256i a = _mm256_loadu_si256(cast(__m256i const *)s);
+		__m256i b = _mm256_loadu_si256(cast(__m256i const *)(s+n-32));
+		_mm256_storeu_si256(cast(__m256i *)d, a);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-32), b);
+	} else if (n <= 128) {
+		__m256i a = _mm256_loadu_si256(cast(__m256i const *)s);
+		__m256i b = _mm256_loadu_si256(cast(__m256i const *)(s+32));
+		__m256i c = _mm256_loadu_si256(cast(__m256i const *)(s+n-64));
+		__m256i e = _mm256_loadu_si256(cast(__m256i const *)(s+n-32));
+		_mm256_storeu_si256(cast(__m256i *)d, a);
+		_mm256_storeu_si256(cast(__m256i *)(d+32), b);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-64), c);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-32), e);
+	} else if (gb__memcopy_use_erms(n, nt)) {
+		gb__memcopy_erms(d, s, n);
 	} else {
-		void *new_memory = gb_alloc_align(a, new_size, alignment);
-		if (!new_memory) return NULL;
-		gb_memmove(new_memory, old_memory, gb_min(new_size, old_size));
-		gb_free(a, old_memory);
-		return new_memory;
+		__m256i head = _mm256_loadu_si256(cast(__m256i const *)s);
+		__m256i t0 = _mm256_loadu_si256(cast(__m256i const *)(s+n-128));
+		__m256i t1 = _mm256_loadu_si256(cast(__m256i const *)(s+n-96));
+		__m256i t2 = _mm256_loadu_si256(cast(__m256i const *)(s+n-64));
+		__m256i t3 = _mm256_loadu_si256(cast(__m256i const *)(s+n-32));
+		isize skew = 32 - (cast(uintptr)d & 31);
+		u8 *dd = d + skew, *end = d + n - 128;
+		u8 const *ss = s + skew;
+
+		if (nt > 0 && n >= nt) {
+			for (; dd < end; dd += 128, ss += 128) {
+				__m256i a = _mm256_loadu_si256(cast(__m256i const *)(ss+ 0));
+				__m256i b = _mm256_loadu_si256(cast(__m256i const *)(ss+32));
+				__m256i c = _mm256_loadu_si256(cast(__m256i const *)(ss+64));
+				__m256i e = _mm256_loadu_si256(cast(__m256i const *)(ss+96));
+				_mm256_stream_si256(cast(__m256i *)(dd+ 0), a);
+				_mm256_stream_si256(cast(__m256i *)(dd+32), b);
+				_mm256_stream_si256(cast(__m256i *)(dd+64), c);
+				_mm256_stream_si256(cast(__m256i *)(dd+96), e);
+			}
+			_mm_sfence();
+		} else {
+			for (; dd < end; dd += 128, ss += 128) {
+				__m256i a = _mm256_loadu_si256(cast(__m256i const *)(ss+ 0));
+				__m256i b = _mm256_loadu_si256(cast(__m256i const *)(ss+32));
+				__m256i c = _mm256_loadu_si256(cast(__m256i const *)(ss+64));
+				__m256i e = _mm256_loadu_si256(cast(__m256i const *)(ss+96));
+				_mm256_store_si256(cast(__m256i *)(dd+ 0), a);
+				_mm256_store_si256(cast(__m256i *)(dd+32), b);
+				_mm256_store_si256(cast(__m256i *)(dd+64), c);
+				_mm256_store_si256(cast(__m256i *)(dd+96), e);
+			}
+		}
+		_mm256_storeu_si256(cast(__m256i *)(d+n-128), t0);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-96), t1);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-64), t2);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-32), t3);
+		_mm256_storeu_si256(cast(__m256i *)d, head);
 	}
+	return dest;
 }
 
+gb_internal GB_TARGET("avx2") void *gb__memcopy_avx2   (void *dest, void const *source, isize n) { return gb__memcopy_avx2_ex(dest, source, n, gb__cpu_dispatch.non_temporal_threshold); }
+gb_internal GB_TARGET("avx2") void *gb__memcopy_avx2_nt(void *dest, void const *source, isize n) { return gb__memcopy_avx2_ex(dest, source, n, 1); }
 
+gb_internal gb_inline GB_TARGET("sse2") void *gb__memset_sse2_ex(void *dest, u8 c, isize n, isize nt) {
+	u8 *d = cast(u8 *)dest;
+	__m128i v;
 
+	if (n <= 16) {
+		gb__memset_small(d, c, n);
+		return dest;
+	}
+	v = _mm_set1_epi8(cast(char)c);
+	if (n <= 32) {
+		_mm_storeu_si128(cast(__m128i *)d, v);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), v);
+	} else if (n <= 64) {
+		_mm_storeu_si128(cast(__m128i *)d, v);
+		_mm_storeu_si128(cast(__m128i *)(d+16), v);
+		_mm_storeu_si128(cast(__m128i *)(d+n-32), v);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), v);
+	} else {
+		u8 *dd = d + 16 - (cast(uintptr)d & 15), *end = d + n - 64;
+		_mm_storeu_si128(cast(__m128i *)d, v);
+		if (nt > 0 && n >= nt) {
+			for (; dd < end; dd += 64) {
+				_mm_stream_si128(cast(__m128i *)(dd+ 0), v);
+				_mm_stream_si128(cast(__m128i *)(dd+16), v);
+				_mm_stream_si128(cast(__m128i *)(dd+32), v);
+				_mm_stream_si128(cast(__m128i *)(dd+48), v);
+			}
+			_mm_sfence();
+		} else {
+			for (; dd < end; dd += 64) {
+				_mm_store_si128(cast(__m128i *)(dd+ 0), v);
+				_mm_store_si128(cast(__m128i *)(dd+16), v);
+				_mm_store_si128(cast(__m128i *)(dd+32), v);
+				_mm_store_si128(cast(__m128i *)(dd+48), v);
+			}
+		}
+		_mm_storeu_si128(cast(__m128i *)(d+n-64), v);
+		_mm_storeu_si128(cast(__m128i *)(d+n-48), v);
+		_mm_storeu_si128(cast(__m128i *)(d+n-32), v);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), v);
+	}
+	return dest;
+}
 
-////////////////////////////////////////////////////////////////
-//
-// Concurrency
-//
-//
-// IMPORTANT TODO(bill): Use compiler intrinsics for the atomics
+gb_internal GB_TARGET("sse2") void *gb__memset_sse2   (void *dest, u8 c, isize n) { return gb__memset_sse2_ex(dest, c, n, gb__cpu_dispatch.non_temporal_threshold); }
+gb_internal GB_TARGET("sse2") void *gb__memset_sse2_nt(void *dest, u8 c, isize n) { return gb__memset_sse2_ex(dest, c, n, 1); }
 
-#if defined(GB_COMPILER_MSVC) && !defined(GB_COMPILER_CLANG)
-gb_inline i32  gb_atomic32_load (gbAtomic32 const volatile *a)      { return a->value;  }
-gb_inline void gb_atomic32_store(gbAtomic32 volatile *a, i32 value) { a->value = value; }
+gb_internal gb_inline GB_TARGET("avx2") void *gb__memset_avx2_ex(void *dest, u8 c, isize n, isize nt) {
+	u8 *d = cast(u8 *)dest;
+	__m256i v;
 
-gb_inline i32 gb_atomic32_compare_exchange(gbAtomic32 volatile *a, i32 expected, i32 desired) {
-	return _InterlockedCompareExchange(cast(long volatile *)a, desired, expected);
+	if (n <= 16) {
+		gb__memset_small(d, c, n);
+		return dest;
+	}
+	if (n <= 32) {
+		__m128i v16 = _mm_set1_epi8(cast(char)c);
+		_mm_storeu_si128(cast(__m128i *)d, v16);
+		_mm_storeu_si128(cast(__m128i *)(d+n-16), v16);
+		return dest;
+	}
+	v = _mm256_set1_epi8(cast(char)c);
+	if (n <= 64) {
+		_mm256_storeu_si256(cast(__m256i *)d, v);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-32), v);
+	} else if (n <= 128) {
+		_mm256_storeu_si256(cast(__m256i *)d, v);
+		_mm256_storeu_si256(cast(__m256i *)(d+32), v);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-64), v);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-32), v);
+	} else {
+		u8 *dd = d + 32 - (cast(uintptr)d & 31), *end = d + n - 128;
+		_mm256_storeu_si256(cast(__m256i *)d, v);
+		if (nt > 0 && n >= nt) {
+			for (; dd < end; dd += 128) {
+				_mm256_stream_si256(cast(__m256i *)(dd+ 0), v);
+				_mm256_stream_si256(cast(__m256i *)(dd+32), v);
+				_mm256_stream_si256(cast(__m256i *)(dd+64), v);
+				_mm256_stream_si256(cast(__m256i *)(dd+96), v);
+			}
+			_mm_sfence();
+		} else {
+			for (; dd < end; dd += 128) {
+				_mm256_store_si256(cast(__m256i *)(dd+ 0), v);
+				_mm256_store_si256(cast(__m256i *)(dd+32), v);
+				_mm256_store_si256(cast(__m256i *)(dd+64), v);
+				_mm256_store_si256(cast(__m256i *)(dd+96), v);
+			}
+		}
+		_mm256_storeu_si256(cast(__m256i *)(d+n-128), v);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-96), v);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-64), v);
+		_mm256_storeu_si256(cast(__m256i *)(d+n-32), v);
+	}
+	return dest;
 }
-gb_inline i32 gb_atomic32_exchanged(gbAtomic32 volatile *a, i32 desired) {
-	return _InterlockedExchange(cast(long volatile *)a, desired);
+
+gb_internal GB_TARGET("avx2") void *gb__memset_avx2   (void *dest, u8 c, isize n) { return gb__memset_avx2_ex(dest, c, n, gb__cpu_dispatch.non_temporal_threshold); }
+gb_internal GB_TARGET("avx2") void *gb__memset_avx2_nt(void *dest, u8 c, isize n) { return gb__memset_avx2_ex(dest, c, n, 1); }
+
+gb_internal GB_TARGET("sse2") void gb__memswap_sse2(void *i, void *j, isize n) {
+	u8 *a = cast(u8 *)i, *b = cast(u8 *)j;
+	__m128i at, bt;
+	isize k = 0;
+
+	if (n < 16) {
+		gb__memswap_small(a, b, n);
+		return;
+	}
+	at = _mm_loadu_si128(cast(__m128i const *)(a+n-16));
+	bt = _mm_loadu_si128(cast(__m128i const *)(b+n-16));
+	for (; k < n-32; k += 32) {
+		__m128i a0 = _mm_loadu_si128(cast(__m128i const *)(a+k));
+		__m128i a1 = _mm_loadu_si128(cast(__m128i const *)(a+k+16));
+		__m128i b0 = _mm_loadu_si128(cast(__m128i const *)(b+k));
+		__m128i b1 = _mm_loadu_si128(cast(__m128i const *)(b+k+16));
+		_mm_storeu_si128(cast(__m128i *)(a+k),    b0);
+		_mm_storeu_si128(cast(__m128i *)(a+k+16), b1);
+		_mm_storeu_si128(cast(__m128i *)(b+k),    a0);
+		_mm_storeu_si128(cast(__m128i *)(b+k+16), a1);
+	}
+	if (k < n-16) {
+		__m128i a0 = _mm_loadu_si128(cast(__m128i const *)(a+k));
+		__m128i b0 = _mm_loadu_si128(cast(__m128i const *)(b+k));
+		_mm_storeu_si128(cast(__m128i *)(a+k), b0);
+		_mm_storeu_si128(cast(__m128i *)(b+k), a0);
+	}
+	_mm_storeu_si128(cast(__m128i *)(a+n-16), bt);
+	_mm_storeu_si128(cast(__m128i *)(b+n-16), at);
 }
-gb_inline i32 gb_atomic32_fetch_add(gbAtomic32 volatile *a, i32 operand) {
-	return _InterlockedExchangeAdd(cast(long volatile *)a, operand);
+
+gb_internal GB_TARGET("avx2") void gb__memswap_avx2(void *i, void *j, isize n) {
+	u8 *a = cast(u8 *)i, *b = cast(u8 *)j;
+	__m256i at, bt;
+	isize k = 0;
+
+	if (n < 32) {
+		gb__memswap_sse2(a, b, n);
+		return;
+	}
+	at = _mm256_loadu_si256(cast(__m256i const *)(a+n-32));
+	bt = _mm256_loadu_si256(cast(__m256i const *)(b+n-32));
+	for (; k < n-64; k += 64) {
+		__m256i a0 = _mm256_loadu_si256(cast(__m256i const *)(a+k));
+		__m256i a1 = _mm256_loadu_si256(cast(__m256i const *)(a+k+32));
+		__m256i b0 = _mm256_loadu_si256(cast(__m256i const *)(b+k));
+		__m256i b1 = _mm256_loadu_si256(cast(__m256i const *)(b+k+32));
+		_mm256_storeu_si256(cast(__m256i *)(a+k),    b0);
+		_mm256_storeu_si256(cast(__m256i *)(a+k+32), b1);
+		_mm256_storeu_si256(cast(__m256i *)(b+k),    a0);
+		_mm256_storeu_si256(cast(__m256i *)(b+k+32), a1);
+	}
+	if (k < n-32) {
+		__m256i a0 = _mm256_loadu_si256(cast(__m256i const *)(a+k));
+		__m256i b0 = _mm256_loadu_si256(cast(__m256i const *)(b+k));
+		_mm256_storeu_si256(cast(__m256i *)(a+k), b0);
+		_mm256_storeu_si256(cast(__m256i *)(b+k), a0);
+	}
+	_mm256_storeu_si256(cast(__m256i *)(a+n-32), bt);
+	_mm256_storeu_si256(cast(__m256i *)(b+n-32), at);
 }
-gb_inline i32 gb_atomic32_fetch_and(gbAtomic32 volatile *a, i32 operand) {
-	return _InterlockedAnd(cast(long volatile *)a, operand);
+
+// NOTE(bill): Searching/comparing kernels. Loads never cross into a page that the buffer does not touch,
+// either because they are aligned or because the page offset is checked first, so the lengths can be
+// handled with masks instead of byte loops.
+#define GB__PAGE_SAFE(ptr, size) ((cast(uintptr)(ptr) & 4095) <= 4096 - (size))
+
+gb_internal GB_NO_ASAN GB_TARGET("sse2") void const *gb__memchr_sse2(void const *data, u8 c, isize n) {
+	u8 const *s = cast(u8 const *)data, *end = s + n, *p;
+	__m128i v = _mm_set1_epi8(cast(char)c);
+	u32 mask;
+
+	if (n < 16) {
+		if (n <= 0) return NULL;
+		if (!GB__PAGE_SAFE(s, 16)) return gb__memchr_generic(data, c, n);
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)s), v)) & ((1u << n) - 1);
+		return mask ? s + gb__bit_scan_forward(mask) : NULL;
+	}
+
+	mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)s), v));
+	if (mask) return s + gb__bit_scan_forward(mask);
+
+	p = cast(u8 const *)(cast(uintptr)(s+16) & ~cast(uintptr)15);
+	for (; p + 64 <= end; p += 64) {
+		__m128i a = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p+ 0)), v);
+		__m128i b = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p+16)), v);
+		__m128i e = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p+32)), v);
+		__m128i f = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p+48)), v);
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(e, f)))) {
+			u64 m = cast(u64)cast(u32)_mm_movemask_epi8(a)
+			      | cast(u64)cast(u32)_mm_movemask_epi8(b) << 16
+			      | cast(u64)cast(u32)_mm_movemask_epi8(e) << 32
+			      | cast(u64)cast(u32)_mm_movemask_epi8(f) << 48;
+			return p + gb__bit_scan_forward(m);
+		}
+	}
+	for (; p + 16 <= end; p += 16) {
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)p), v));
+		if (mask) return p + gb__bit_scan_forward(mask);
+	}
+	if (p < end) {
+		// NOTE(bill): Overlaps what has been checked already so the first match is the right one
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)(end-16)), v));
+		if (mask) return end - 16 + gb__bit_scan_forward(mask);
+	}
+	return NULL;
 }
-gb_inline i32 gb_atomic32_fetch_or(gbAtomic32 volatile *a, i32 operand) {
-	return _InterlockedOr(cast(long volatile *)a, operand);
+
+gb_internal GB_NO_ASAN GB_TARGET("avx2") void const *gb__memchr_avx2(void const *data, u8 c, isize n) {
+	u8 const *s = cast(u8 const *)data, *end = s + n, *p;
+	__m256i v;
+	u32 mask;
+
+	if (n < 32)
+		return gb__memchr_sse2(data, c, n);
+
+	v = _mm256_set1_epi8(cast(char)c);
+	mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)s), v));
+	if (mask) return s + gb__bit_scan_forward(mask);
+
+	p = cast(u8 const *)(cast(uintptr)(s+32) & ~cast(uintptr)31);
+	for (; p + 128 <= end; p += 128) {
+		__m256i a = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p+ 0)), v);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p+32)), v);
+		__m256i e = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p+64)), v);
+		__m256i f = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p+96)), v);
+		if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(e, f)))) {
+			u64 m = cast(u64)cast(u32)_mm256_movemask_epi8(a) | cast(u64)cast(u32)_mm256_movemask_epi8(b) << 32;
+			if (m) return p + gb__bit_scan_forward(m);
+			m = cast(u64)cast(u32)_mm256_movemask_epi8(e) | cast(u64)cast(u32)_mm256_movemask_epi8(f) << 32;
+			return p + 64 + gb__bit_scan_forward(m);
+		}
+	}
+	for (; p + 32 <= end; p += 32) {
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)p), v));
+		if (mask) return p + gb__bit_scan_forward(mask);
+	}
+	if (p < end) {
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)(end-32)), v));
+		if (mask) return end - 32 + gb__bit_scan_forward(mask);
+	}
+	return NULL;
 }
 
-gb_inline i64 gb_atomic64_load(gbAtomic64 const volatile *a) {
-#if defined(GB_ARCH_64_BIT)
-	return a->value;
-#elif GB_CPU_X86
-	// NOTE(bill): The most compatible way to get an atomic 64-bit load on x86 is with cmpxchg8b
-	i64 result;
-	__asm {
-		mov esi, a;
-		mov ebx, eax;
-		mov ecx, edx;
-		lock cmpxchg8b [esi];
-		mov dword ptr result, eax;
-		mov dword ptr result[4], edx;
+gb_internal GB_NO_ASAN GB_TARGET("sse2") void const *gb__memrchr_sse2(void const *data, u8 c, isize n) {
+	u8 const *s = cast(u8 const *)data, *end = s + n, *p;
+	__m128i v = _mm_set1_epi8(cast(char)c);
+	u32 mask;
+
+	if (n < 16) {
+		if (n <= 0) return NULL;
+		if (!GB__PAGE_SAFE(s, 16)) return gb__memrchr_generic(data, c, n);
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)s), v)) & ((1u << n) - 1);
+		return mask ? s + gb__bit_scan_reverse(mask) : NULL;
 	}
-	return result;
-#else
-#error TODO(bill): atomics for this CPU
-#endif
+
+	mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)(end-16)), v));
+	if (mask) return end - 16 + gb__bit_scan_reverse(mask);
+
+	p = cast(u8 const *)(cast(uintptr)end & ~cast(uintptr)15);
+	for (; p - 64 >= s; p -= 64) {
+		__m128i a = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p-64)), v);
+		__m128i b = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p-48)), v);
+		__m128i e = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p-32)), v);
+		__m128i f = _mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p-16)), v);
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(e, f)))) {
+			u64 m = cast(u64)cast(u32)_mm_movemask_epi8(a)
+			      | cast(u64)cast(u32)_mm_movemask_epi8(b) << 16
+			      | cast(u64)cast(u32)_mm_movemask_epi8(e) << 32
+			      | cast(u64)cast(u32)_mm_movemask_epi8(f) << 48;
+			return p - 64 + gb__bit_scan_reverse(m);
+		}
+	}
+	for (; p - 16 >= s; p -= 16) {
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)(p-16)), v));
+		if (mask) return p - 16 + gb__bit_scan_reverse(mask);
+	}
+	if (p > s) {
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)s), v));
+		if (mask) return s + gb__bit_scan_reverse(mask);
+	}
+	return NULL;
 }
 
-gb_inline void gb_atomic64_store(gbAtomic64 volatile *a, i64 value) {
-#if defined(GB_ARCH_64_BIT)
-	a->value = value;
-#elif GB_CPU_X86
-	// NOTE(bill): The most compatible way to get an atomic 64-bit store on x86 is with cmpxchg8b
-	__asm {
-		mov esi, a;
-		mov ebx, dword ptr value;
-		mov ecx, dword ptr value[4];
-	retry:
-		cmpxchg8b [esi];
-		jne retry;
+gb_internal GB_NO_ASAN GB_TARGET("avx2") void const *gb__memrchr_avx2(void const *data, u8 c, isize n) {
+	u8 const *s = cast(u8 const *)data, *end = s + n, *p;
+	__m256i v;
+	u32 mask;
+
+	if (n < 32)
+		return gb__memrchr_sse2(data, c, n);
+
+	v = _mm256_set1_epi8(cast(char)c);
+	mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)(end-32)), v));
+	if (mask) return end - 32 + gb__bit_scan_reverse(mask);
+
+	p = cast(u8 const *)(cast(uintptr)end & ~cast(uintptr)31);
+	for (; p - 128 >= s; p -= 128) {
+		__m256i a = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p-128)), v);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p- 96)), v);
+		__m256i e = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p- 64)), v);
+		__m256i f = _mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p- 32)), v);
+		if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(e, f)))) {
+			u64 m = cast(u64)cast(u32)_mm256_movemask_epi8(e) | cast(u64)cast(u32)_mm256_movemask_epi8(f) << 32;
+			if (m) return p - 64 + gb__bit_scan_reverse(m);
+			m = cast(u64)cast(u32)_mm256_movemask_epi8(a) | cast(u64)cast(u32)_mm256_movemask_epi8(b) << 32;
+			return p - 128 + gb__bit_scan_reverse(m);
+		}
 	}
-#else
-#error TODO(bill): atomics for this CPU
-#endif
+	for (; p - 32 >= s; p -= 32) {
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)(p-32)), v));
+		if (mask) return p - 32 + gb__bit_scan_reverse(mask);
+	}
+	if (p > s) {
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)s), v));
+		if (mask) return s + gb__bit_scan_reverse(mask);
+	}
+	return NULL;
 }
 
-gb_inline i64 gb_atomic64_compare_exchange(gbAtomic64 volatile *a, i64 expected, i64 desired) {
-	return _InterlockedCompareExchange64(cast(i64 volatile *)a, desired, expected);
+gb_internal GB_NO_ASAN GB_TARGET("sse2") isize gb__strlen_sse2(char const *str) {
+	// NOTE(bill): Aligned loads so it never reads into the next page, the bytes before str are masked off
+	u8 const *p = cast(u8 const *)(cast(uintptr)str & ~cast(uintptr)15);
+	__m128i zero = _mm_setzero_si128();
+	u32 mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)p), zero));
+	mask >>= cast(uintptr)str & 15;
+	if (mask) return gb__bit_scan_forward(mask);
+
+	for (p += 16; cast(uintptr)p & 63; p += 16) {
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(cast(__m128i const *)p), zero));
+		if (mask) return (p - cast(u8 const *)str) + gb__bit_scan_forward(mask);
+	}
+	for (;; p += 64) {
+		// NOTE(bill): A 64 byte aligned block is within a page, min is only zero if one of them is
+		__m128i a = _mm_load_si128(cast(__m128i const *)(p+ 0));
+		__m128i b = _mm_load_si128(cast(__m128i const *)(p+16));
+		__m128i e = _mm_load_si128(cast(__m128i const *)(p+32));
+		__m128i f = _mm_load_si128(cast(__m128i const *)(p+48));
+		__m128i m = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(e, f));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(m, zero))) {
+			u64 bits = cast(u64)cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero))
+			         | cast(u64)cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(b, zero)) << 16
+			         | cast(u64)cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(e, zero)) << 32
+			         | cast(u64)cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(f, zero)) << 48;
+			return (p - cast(u8 const *)str) + gb__bit_scan_forward(bits);
+		}
+	}
 }
 
-gb_inline i64 gb_atomic64_exchanged(gbAtomic64 volatile *a, i64 desired) {
-#if defined(GB_ARCH_64_BIT)
-	return _InterlockedExchange64(cast(i64 volatile *)a, desired);
-#elif GB_CPU_X86
-	i64 expected = a->value;
-	for (;;) {
-		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, desired, expected);
-		if (original == expected)
-			return original;
-		expected = original;
+gb_internal GB_NO_ASAN GB_TARGET("avx2") isize gb__strlen_avx2(char const *str) {
+	u8 const *p = cast(u8 const *)(cast(uintptr)str & ~cast(uintptr)31);
+	__m256i zero = _mm256_setzero_si256();
+	u32 mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)p), zero));
+	mask >>= cast(uintptr)str & 31;
+	if (mask) return gb__bit_scan_forward(mask);
+
+	for (p += 32; cast(uintptr)p & 63; p += 32) {
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(cast(__m256i const *)p), zero));
+		if (mask) return (p - cast(u8 const *)str) + gb__bit_scan_forward(mask);
+	}
+	for (;; p += 64) {
+		__m256i a = _mm256_load_si256(cast(__m256i const *)(p+ 0));
+		__m256i b = _mm256_load_si256(cast(__m256i const *)(p+32));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(a, b), zero))) {
+			u64 bits = cast(u64)cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero))
+			         | cast(u64)cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, zero)) << 32;
+			return (p - cast(u8 const *)str) + gb__bit_scan_forward(bits);
+		}
 	}
-#else
-#error TODO(bill): atomics for this CPU
-#endif
 }
 
-gb_inline i64 gb_atomic64_fetch_add(gbAtomic64 volatile *a, i64 operand) {
-#if defined(GB_ARCH_64_BIT)
-	return _InterlockedExchangeAdd64(cast(i64 volatile *)a, operand);
-#elif GB_CPU_X86
-	i64 expected = a->value;
-	for (;;) {
-		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, expected + operand, expected);
-		if (original == expected)
-			return original;
-		expected = original;
+gb_internal GB_NO_ASAN GB_TARGET("sse2") i32 gb__memcompare_sse2(void const *s1, void const *s2, isize n) {
+	u8 const *a = cast(u8 const *)s1, *b = cast(u8 const *)s2;
+	isize i = 0;
+	u32 mask;
+
+	if (n < 16) {
+		if (n <= 0) return 0;
+		if (!GB__PAGE_SAFE(a, 16) || !GB__PAGE_SAFE(b, 16)) return gb__memcompare_generic(s1, s2, n);
+		mask = ~cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)a), _mm_loadu_si128(cast(__m128i const *)b)));
+		mask &= (1u << n) - 1;
+		if (mask) {
+			i = gb__bit_scan_forward(mask);
+			return a[i] - b[i];
+		}
+		return 0;
 	}
-#else
-#error TODO(bill): atomics for this CPU
-#endif
+
+	for (; i + 16 <= n; i += 16) {
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)(a+i)), _mm_loadu_si128(cast(__m128i const *)(b+i))));
+		if (mask != 0xffff) {
+			i += gb__bit_scan_forward(~mask);
+			return a[i] - b[i];
+		}
+	}
+	if (i < n) {
+		// NOTE(bill): Everything before the overlapping last block is equal
+		i = n - 16;
+		mask = cast(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(cast(__m128i const *)(a+i)), _mm_loadu_si128(cast(__m128i const *)(b+i))));
+		if (mask != 0xffff) {
+			i += gb__bit_scan_forward(~mask);
+			return a[i] - b[i];
+		}
+	}
+	return 0;
 }
 
-gb_inline i64 gb_atomic64_fetch_and(gbAtomic64 volatile *a, i64 operand) {
-#if defined(GB_ARCH_64_BIT)
-	return _InterlockedAnd64(cast(i64 volatile *)a, operand);
-#elif GB_CPU_X86
-	i64 expected = a->value;
-	for (;;) {
-		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, expected & operand, expected);
-		if (original == expected)
-			return original;
-		expected = original;
+gb_internal GB_NO_ASAN GB_TARGET("avx2") i32 gb__memcompare_avx2(void const *s1, void const *s2, isize n) {
+	u8 const *a = cast(u8 const *)s1, *b = cast(u8 const *)s2;
+	isize i = 0;
+	u32 mask;
+
+	if (n < 32)
+		return gb__memcompare_sse2(s1, s2, n);
+
+	for (; i + 64 <= n; i += 64) {
+		__m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)(a+i)),    _mm256_loadu_si256(cast(__m256i const *)(b+i)));
+		__m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)(a+i+32)), _mm256_loadu_si256(cast(__m256i const *)(b+i+32)));
+		if (cast(u32)_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) != 0xffffffffu) {
+			u64 m = cast(u64)cast(u32)_mm256_movemask_epi8(e0) | cast(u64)cast(u32)_mm256_movemask_epi8(e1) << 32;
+			i += gb__bit_scan_forward(~m);
+			return a[i] - b[i];
+		}
+	}
+	for (; i + 32 <= n; i += 32) {
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)(a+i)), _mm256_loadu_si256(cast(__m256i const *)(b+i))));
+		if (mask != 0xffffffffu) {
+			i += gb__bit_scan_forward(~mask);
+			return a[i] - b[i];
+		}
+	}
+	if (i < n) {
+		i = n - 32;
+		mask = cast(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(cast(__m256i const *)(a+i)), _mm256_loadu_si256(cast(__m256i const *)(b+i))));
+		if (mask != 0xffffffffu) {
+			i += gb__bit_scan_forward(~mask);
+			return a[i] - b[i];
+		}
 	}
+	return 0;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////
+//
+// CPU Info
+//
+//
+
+
+#if defined(GB_CPU_X86)
+gb_internal void gb__cpuid(u32 leaf, u32 subleaf, u32 regs[4]) {
+#if defined(GB_COMPILER_MSVC)
+	__cpuidex(cast(int *)regs, cast(int)leaf, cast(int)subleaf);
+#elif defined(GB_ARCH_32_BIT) && defined(__PIC__)
+	// NOTE(bill): ebx is the PIC register on 32 bit
+	__asm__ __volatile__("xchgl %%ebx, %k1\n\tcpuid\n\txchgl %%ebx, %k1"
+	                     : "=a"(regs[0]), "=&r"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+	                     : "0"(leaf), "2"(subleaf));
 #else
-#error TODO(bill): atomics for this CPU
+	__asm__ __volatile__("cpuid"
+	                     : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+	                     : "0"(leaf), "2"(subleaf));
 #endif
 }
 
-gb_inline i64 gb_atomic64_fetch_or(gbAtomic64 volatile *a, i64 operand) {
-#if defined(GB_ARCH_64_BIT)
-	return _InterlockedOr64(cast(i64 volatile *)a, operand);
-#elif GB_CPU_X86
-	i64 expected = a->value;
-	for (;;) {
-		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, expected | operand, expected);
-		if (original == expected)
-			return original;
-		expected = original;
-	}
+gb_internal u64 gb__xgetbv(u32 index) {
+#if defined(GB_COMPILER_MSVC)
+	return _xgetbv(index);
 #else
-#error TODO(bill): atomics for this CPU
+	u32 lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(index));
+	return (cast(u64)hi << 32) | lo;
 #endif
 }
 
+gb_internal void gb__cpu_info_caches(gbCpuInfo *info, u32 leaf) {
+	// NOTE(bill): Deterministic cache parameters (leaf 4 on Intel, 0x8000001d on AMD)
+	u32 i, r[4];
+	for (i = 0; i < 16; i++) {
+		u32 type, level;
+		isize size;
+		gb__cpuid(leaf, i, r);
+		type  = r[0] & 31;
+		level = (r[0] >> 5) & 7;
+		if (type == 0)
+			break;
+		if (type == 2) // NOTE(bill): Instruction cache
+			continue;
+		size = cast(isize)((r[1] >> 22) + 1)              // NOTE(bill): Ways
+		     * cast(isize)(((r[1] >> 12) & 0x3ff) + 1)    // NOTE(bill): Partitions
+		     * cast(isize)((r[1] & 0xfff) + 1)            // NOTE(bill): Line size
+		     * cast(isize)(r[2] + 1);                     // NOTE(bill): Sets
+		switch (level) {
+		case 1: info->l1d_cache_size = size; info->cache_line_size = cast(isize)((r[1] & 0xfff) + 1); break;
+		case 2: info->l2_cache_size  = size; break;
+		case 3: info->l3_cache_size  = size; break;
+		}
+	}
+}
 
+gb_internal void gb__cpu_info_query(gbCpuInfo *info) {
+	u32 r[4], max_leaf, max_ext_leaf, i;
+	u64 xcr0 = 0;
+	b32 is_amd;
+
+	gb__cpuid(0, 0, r);
+	max_leaf = r[0];
+	*cast(gb__u32_unaligned *)(info->vendor+0) = r[1];
+	*cast(gb__u32_unaligned *)(info->vendor+4) = r[3];
+	*cast(gb__u32_unaligned *)(info->vendor+8) = r[2];
+	info->vendor[12] = '\0';
+	is_amd = gb_strncmp(info->vendor, "AuthenticAMD", 12) == 0 || gb_strncmp(info->vendor, "HygonGenuine", 12) == 0;
+
+	if (max_leaf >= 1) {
+		gb__cpuid(1, 0, r);
+		if (r[3] & GB_BIT(26)) info->features |= gbCpuFeature_SSE2;
+		if (r[2] & GB_BIT(0))  info->features |= gbCpuFeature_SSE3;
+		if (r[2] & GB_BIT(9))  info->features |= gbCpuFeature_SSSE3;
+		if (r[2] & GB_BIT(19)) info->features |= gbCpuFeature_SSE4_1;
+		if (r[2] & GB_BIT(20)) info->features |= gbCpuFeature_SSE4_2;
+		if (r[2] & GB_BIT(23)) info->features |= gbCpuFeature_POPCNT;
+		if (r[2] & GB_BIT(1))  info->features |= gbCpuFeature_PCLMUL;
+		info->cache_line_size = cast(isize)((r[1] >> 8) & 0xff) * 8;
+		if (r[2] & GB_BIT(27)) // NOTE(bill): OSXSAVE
+			xcr0 = gb__xgetbv(0);
+		// NOTE(bill): The OS has to save the XMM and YMM state for any of the AVX family
+		if ((xcr0 & 6) == 6) {
+			if (r[2] & GB_BIT(28)) info->features |= gbCpuFeature_AVX;
+			if (r[2] & GB_BIT(12)) info->features |= gbCpuFeature_FMA;
+			if (r[2] & GB_BIT(29)) info->features |= gbCpuFeature_F16C;
+		}
+	}
+	if (max_leaf >= 7) {
+		gb__cpuid(7, 0, r);
+		if (r[1] & GB_BIT(3)) info->features |= gbCpuFeature_BMI1;
+		if (r[1] & GB_BIT(8)) info->features |= gbCpuFeature_BMI2;
+		if (r[1] & GB_BIT(9)) info->features |= gbCpuFeature_ERMS;
+		if ((xcr0 & 6) == 6 && (r[1] & GB_BIT(5)))
+			info->features |= gbCpuFeature_AVX2;
+		// NOTE(bill): And the opmask and ZMM state for AVX-512
+		if ((xcr0 & 0xe6) == 0xe6 && (r[1] & GB_BIT(16))) {
+			info->features |= gbCpuFeature_AVX512F;
+			if (r[1] & GB_BIT(30))           info->features |= gbCpuFeature_AVX512BW;
+			if (r[1] & 0x80000000u)  info->features |= gbCpuFeature_AVX512VL;
+		}
+	}
 
-#elif defined(GB_CPU_X86)
-
-gb_inline i32  gb_atomic32_load (gbAtomic32 const volatile *a)      { return a->value;  }
-gb_inline void gb_atomic32_store(gbAtomic32 volatile *a, i32 value) { a->value = value; }
+	gb__cpuid(0x80000000, 0, r);
+	max_ext_leaf = r[0];
+	if (max_ext_leaf >= 0x80000004) {
+		for (i = 0; i < 3; i++) {
+			gb__cpuid(0x80000002+i, 0, r);
+			*cast(gb__u32_unaligned *)(info->brand + i*16 +  0) = r[0];
+			*cast(gb__u32_unaligned *)(info->brand + i*16 +  4) = r[1];
+			*cast(gb__u32_unaligned *)(info->brand + i*16 +  8) = r[2];
+			*cast(gb__u32_unaligned *)(info->brand + i*16 + 12) = r[3];
+		}
+		info->brand[48] = '\0';
+	}
 
-gb_inline i32 gb_atomic32_compare_exchange(gbAtomic32 volatile *a, i32 expected, i32 desired) {
-	i32 original;
-	__asm__ volatile(
-		"lock; cmpxchgl %2, %1"
-		: "=a"(original), "+m"(a->value)
-		: "q"(desired), "0"(expected)
-	);
-	return original;
+	if (is_amd) {
+		if (max_ext_leaf >= 0x8000001d) {
+			gb__cpu_info_caches(info, 0x8000001d);
+		} else if (max_ext_leaf >= 0x80000006) {
+			gb__cpuid(0x80000005, 0, r);
+			info->l1d_cache_size  = cast(isize)(r[2] >> 24) * 1024;
+			info->cache_line_size = cast(isize)(r[2] & 0xff);
+			gb__cpuid(0x80000006, 0, r);
+			info->l2_cache_size   = cast(isize)(r[2] >> 16) * 1024;
+			info->l3_cache_size   = cast(isize)(r[3] >> 18) * 512 * 1024;
+		}
+	} else if (max_leaf >= 4) {
+		gb__cpu_info_caches(info, 4);
+	}
 }
-
-gb_inline i32 gb_atomic32_exchanged(gbAtomic32 volatile *a, i32 desired) {
-	// NOTE(bill): No lock prefix is necessary for xchgl
-	i32 original;
-	__asm__ volatile(
-		"xchgl %0, %1"
-		: "=r"(original), "+m"(a->value)
-		: "0"(desired)
-	);
-	return original;
+#else
+gb_internal void gb__cpu_info_query(gbCpuInfo *info) {
+	info->cache_line_size = GB_CACHE_LINE_SIZE;
+#if defined(GB_SYSTEM_LINUX) && defined(_SC_LEVEL1_DCACHE_SIZE)
+	info->l1d_cache_size = gb_max(cast(isize)sysconf(_SC_LEVEL1_DCACHE_SIZE), 0);
+	info->l2_cache_size  = gb_max(cast(isize)sysconf(_SC_LEVEL2_CACHE_SIZE),  0);
+	info->l3_cache_size  = gb_max(cast(isize)sysconf(_SC_LEVEL3_CACHE_SIZE),  0);
+#endif
 }
+#endif
 
-gb_inline i32 gb_atomic32_fetch_add(gbAtomic32 volatile *a, i32 operand) {
-	i32 original;
-	__asm__ volatile(
-		"lock; xaddl %0, %1"
-		: "=r"(original), "+m"(a->value)
-		: "0"(operand)
-	);
-	return original;
+gbCpuInfo const *gb_cpu_info(void) {
+	// NOTE(bill): Racing threads compute the same thing so it does not need a lock
+	if (!gb__cpu_info_done) {
+		gbCpuInfo info = {0};
+		gb__cpu_info_query(&info);
+		if (info.cache_line_size == 0)
+			info.cache_line_size = GB_CACHE_LINE_SIZE;
+		gb__cpu_info = info;
+		gb_sfence(); // NOTE(bill): The info must be written before the flag says so
+		gb__cpu_info_done = true;
+	}
+	return &gb__cpu_info;
+}
+
+gb_inline b32 gb_cpu_has(u32 features) { return (gb_cpu_info()->features & features) == features; }
+
+
+void gb_cpu_dispatch_select(u32 features) {
+	// NOTE(bill): The struct copy at the end is not atomic, another thread may read a mix of the old
+	// and new entries. That is fine as every entry is valid on its own (a resolver or a kernel the CPU
+	// supports), it only ever swaps one working function for another
+	gbCpuDispatch d;
+	features &= gb_cpu_info()->features;
+
+	d.features = features;
+	d.memcopy    = gb__memcopy_generic;
+	d.memset     = gb__memset_generic;
+	d.memcopy_non_temporal = gb__memcopy_generic;
+	d.memset_non_temporal  = gb__memset_generic;
+	d.memswap    = gb__memswap_generic;
+	d.memcompare = gb__memcompare_generic;
+	d.memchr     = gb__memchr_generic;
+	d.memrchr    = gb__memrchr_generic;
+	d.strlen     = gb__strlen_generic;
+
+	// NOTE(bill): The last level cache is shared so this is generous for a single thread, but anything
+	// bigger would evict it all anyway
+	d.non_temporal_threshold = gb_cpu_info()->l3_cache_size;
+	if (d.non_temporal_threshold == 0)
+		d.non_temporal_threshold = gb_cpu_info()->l2_cache_size;
+
+#if defined(GB_CPU_X86)
+	if (features & gbCpuFeature_ERMS)
+		d.memset = gb__memset_erms;
+	if (features & gbCpuFeature_SSE2) {
+		d.memcopy    = gb__memcopy_sse2;
+		d.memset     = gb__memset_sse2;
+		d.memcopy_non_temporal = gb__memcopy_sse2_nt;
+		d.memset_non_temporal  = gb__memset_sse2_nt;
+		d.memswap    = gb__memswap_sse2;
+		d.memcompare = gb__memcompare_sse2;
+		d.memchr     = gb__memchr_sse2;
+		d.memrchr    = gb__memrchr_sse2;
+		d.strlen     = gb__strlen_sse2;
+	}
+	if (features & gbCpuFeature_AVX2) {
+		d.memcopy    = gb__memcopy_avx2;
+		d.memset     = gb__memset_avx2;
+		d.memcopy_non_temporal = gb__memcopy_avx2_nt;
+		d.memset_non_temporal  = gb__memset_avx2_nt;
+		d.memswap    = gb__memswap_avx2;
+		d.memcompare = gb__memcompare_avx2;
+		d.memchr     = gb__memchr_avx2;
+		d.memrchr    = gb__memrchr_avx2;
+		d.strlen     = gb__strlen_avx2;
+	}
+#endif
+
+	gb__cpu_dispatch = d;
 }
 
-gb_inline i32 gb_atomic32_fetch_and(gbAtomic32 volatile *a, i32 operand) {
-	i32 original;
-	i32 tmp;
-	__asm__ volatile(
-		"1:     movl    %1, %0\n"
-		"       movl    %0, %2\n"
-		"       andl    %3, %2\n"
-		"       lock; cmpxchgl %2, %1\n"
-		"       jne     1b"
-		: "=&a"(original), "+m"(a->value), "=&r"(tmp)
-		: "r"(operand)
-	);
-	return original;
+gb_internal void *gb__memcopy_resolve(void *dest, void const *source, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memcopy(dest, source, n);
 }
 
-gb_inline i32 gb_atomic32_fetch_or(gbAtomic32 volatile *a, i32 operand) {
-	i32 original;
-	i32 temp;
-	__asm__ volatile(
-		"1:     movl    %1, %0\n"
-		"       movl    %0, %2\n"
-		"       orl     %3, %2\n"
-		"       lock; cmpxchgl %2, %1\n"
-		"       jne     1b"
-		: "=&a"(original), "+m"(a->value), "=&r"(temp)
-		: "r"(operand)
-	);
-	return original;
+gb_internal void *gb__memset_resolve(void *dest, u8 c, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memset(dest, c, n);
 }
 
+gb_internal void *gb__memcopy_non_temporal_resolve(void *dest, void const *source, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memcopy_non_temporal(dest, source, n);
+}
 
-gb_inline i64 gb_atomic64_load(gbAtomic64 const volatile *a) {
-#if defined(GB_ARCH_64_BIT)
-	return a->value;
-#else
-	i64 original;
-	__asm__ volatile(
-		"movl %%ebx, %%eax\n"
-		"movl %%ecx, %%edx\n"
-		"lock; cmpxchg8b %1"
-		: "=&A"(original)
-		: "m"(a->value)
-	);
-	return original;
-#endif
+gb_internal void *gb__memset_non_temporal_resolve(void *dest, u8 c, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memset_non_temporal(dest, c, n);
 }
 
-gb_inline void gb_atomic64_store(gbAtomic64 volatile *a, i64 value) {
-#if defined(GB_ARCH_64_BIT)
-	a->value = value;
-#else
-	i64 expected = a->value;
-	__asm__ volatile(
-		"1:    cmpxchg8b %0\n"
-		"      jne 1b"
-		: "=m"(a->value)
-		: "b"((i32)value), "c"((i32)(value >> 32)), "A"(expected)
-	);
-#endif
+gb_internal void gb__memswap_resolve(void *i, void *j, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	gb__cpu_dispatch.memswap(i, j, n);
 }
 
-gb_inline i64 gb_atomic64_compare_exchange(gbAtomic64 volatile *a, i64 expected, i64 desired) {
-#if defined(GB_ARCH_64_BIT)
-	i64 original;
-	__asm__ volatile(
-		"lock; cmpxchgq %2, %1"
-		: "=a"(original), "+m"(a->value)
-		: "q"(desired), "0"(expected)
-	);
-	return original;
-#else
-	i64 original;
-	__asm__ volatile(
-		"lock; cmpxchg8b %1"
-		: "=A"(original), "+m"(a->value)
-		: "b"((i32)desired), "c"((i32)(desired >> 32)), "0"(expected)
-	);
-	return original;
-#endif
+gb_internal i32 gb__memcompare_resolve(void const *s1, void const *s2, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memcompare(s1, s2, n);
 }
 
-gb_inline i64 gb_atomic64_exchanged(gbAtomic64 volatile *a, i64 desired) {
-#if defined(GB_ARCH_64_BIT)
-	i64 original;
-	__asm__ volatile(
-		"xchgq %0, %1"
-		: "=r"(original), "+m"(a->value)
-		: "0"(desired)
-	);
-	return original;
-#else
-	i64 original = a->value;
-	for (;;) {
-		i64 previous = gb_atomic64_compare_exchange(a, original, desired);
-		if (original == previous)
-			return original;
-		original = previous;
-	}
-#endif
+gb_internal void const *gb__memchr_resolve(void const *data, u8 c, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memchr(data, c, n);
 }
 
-gb_inline i64 gb_atomic64_fetch_add(gbAtomic64 volatile *a, i64 operand) {
-#if defined(GB_ARCH_64_BIT)
-	i64 original;
-	__asm__ volatile(
-		"lock; xaddq %0, %1"
-		: "=r"(original), "+m"(a->value)
-		: "0"(operand)
-	);
-	return original;
-#else
-	for (;;) {
-		i64 original = a->value;
-		if (gb_atomic64_compare_exchange(a, original, original + operand) == original)
-			return original;
-	}
-#endif
+gb_internal void const *gb__memrchr_resolve(void const *data, u8 c, isize n) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.memrchr(data, c, n);
 }
 
-gb_inline i64 gb_atomic64_fetch_and(gbAtomic64 volatile *a, i64 operand) {
-#if defined(GB_ARCH_64_BIT)
-	i64 original;
-	i64 tmp;
-	__asm__ volatile(
-		"1:     movq    %1, %0\n"
-		"       movq    %0, %2\n"
-		"       andq    %3, %2\n"
-		"       lock; cmpxchgq %2, %1\n"
-		"       jne     1b"
-		: "=&a"(original), "+m"(a->value), "=&r"(tmp)
-		: "r"(operand)
-	);
-	return original;
-#else
-	for (;;) {
-		i64 original = a->value;
-		if (gb_atomic64_compare_exchange(a, original, original & operand) == original)
-			return original;
-	}
-#endif
+gb_internal isize gb__strlen_resolve(char const *str) {
+	gb_cpu_dispatch_select(cast(u32)-1);
+	return gb__cpu_dispatch.strlen(str);
 }
 
-gb_inline i64 gb_atomic64_fetch_or(gbAtomic64 volatile *a, i64 operand) {
-#if defined(GB_ARCH_64_BIT)
-	i64 original;
-	i64 temp;
-	__asm__ volatile(
-		"1:     movq    %1, %0\n"
-		"       movq    %0, %2\n"
-		"       orq     %3, %2\n"
-		"       lock; cmpxchgq %2, %1\n"
-		"       jne     1b"
-		: "=&a"(original), "+m"(a->value), "=&r"(temp)
-		: "r"(operand)
-	);
-	return original;
-#else
-	for (;;) {
-		i64 original = a->value;
-		if (gb_atomic64_compare_exchange(a, original, original | operand) == original)
-			return original;
-	}
-#endif
+gb_inline gbCpuDispatch const *gb_cpu_dispatch(void) {
+	if (gb__cpu_dispatch.memcopy == gb__memcopy_resolve)
+		gb_cpu_dispatch_select(cast(u32)-1);
+	return &gb__cpu_dispatch;
 }
 
-#else
-#error TODO(bill): Implement Atomics for this CPU
-#endif
 
-gb_inline b32 gb_atomic32_spin_lock(gbAtomic32 volatile *a, isize time_out) {
-	i32 old_value = gb_atomic32_compare_exchange(a, 1, 0);
-	i32 counter = 0;
-	while (old_value != 0 && (time_out < 0 || counter++ < time_out)) {
-		gb_yield_thread();
-		old_value = gb_atomic32_compare_exchange(a, 1, 0);
-		gb_mfence();
+gb_inline void *gb_memcopy(void *dest, void const *source, isize n) {
+	if (dest == NULL) {
+		return NULL;
 	}
-	return old_value == 0;
-}
-gb_inline void gb_atomic32_spin_unlock(gbAtomic32 volatile *a) {
-	gb_atomic32_store(a, 0);
-	gb_mfence();
+	return gb__cpu_dispatch.memcopy(dest, source, n);
 }
 
-gb_inline b32 gb_atomic64_spin_lock(gbAtomic64 volatile *a, isize time_out) {
-	i64 old_value = gb_atomic64_compare_exchange(a, 1, 0);
-	i64 counter = 0;
-	while (old_value != 0 && (time_out < 0 || counter++ < time_out)) {
-		gb_yield_thread();
-		old_value = gb_atomic64_compare_exchange(a, 1, 0);
-		gb_mfence();
+gb_inline void *gb_memset(void *dest, u8 c, isize n) {
+	if (dest == NULL) {
+		return NULL;
 	}
-	return old_value == 0;
-}
-
-gb_inline void gb_atomic64_spin_unlock(gbAtomic64 volatile *a) {
-	gb_atomic64_store(a, 0);
-	gb_mfence();
-}
-
-gb_inline b32 gb_atomic32_try_acquire_lock(gbAtomic32 volatile *a) {
-	i32 old_value;
-	gb_yield_thread();
-	old_value = gb_atomic32_compare_exchange(a, 1, 0);
-	gb_mfence();
-	return old_value == 0;
+	return gb__cpu_dispatch.memset(dest, c, n);
 }
 
-gb_inline b32 gb_atomic64_try_acquire_lock(gbAtomic64 volatile *a) {
-	i64 old_value;
-	gb_yield_thread();
-	old_value = gb_atomic64_compare_exchange(a, 1, 0);
-	gb_mfence();
-	return old_value == 0;
+gb_inline i32 gb_memcompare(void const *s1, void const *s2, isize size) {
+	if (s1 == NULL || s2 == NULL) {
+		return 0;
+	}
+	return gb__cpu_dispatch.memcompare(s1, s2, size);
 }
 
+gb_inline void const *gb_memchr (void const *data, u8 c, isize n) { return gb__cpu_dispatch.memchr(data, c, n); }
+gb_inline void const *gb_memrchr(void const *data, u8 c, isize n) { return gb__cpu_dispatch.memrchr(data, c, n); }
 
+void gb_memswap(void *i, void *j, isize size) {
+	if (i == j) return;
 
-#if defined(GB_ARCH_32_BIT)
+	// NOTE(bill): The common element sizes skip the table
+	if (size == 4) {
+		gb_swap(u32, *cast(gb__u32_unaligned *)i, *cast(gb__u32_unaligned *)j);
+	} else if (size == 8) {
+		gb_swap(u64, *cast(gb__u64_unaligned *)i, *cast(gb__u64_unaligned *)j);
+	} else {
+		gb__cpu_dispatch.memswap(i, j, size);
+	}
+}
+
+gb_inline void *gb_alloc_align (gbAllocator a, isize size, isize alignment)                                { return a.proc(a.data, gbAllocation_Alloc, size, alignment, NULL, 0, GB_DEFAULT_ALLOCATOR_FLAGS); }
+gb_inline void *gb_alloc       (gbAllocator a, isize size)                                                 { return gb_alloc_align(a, size, GB_DEFAULT_MEMORY_ALIGNMENT); }
+gb_inline void  gb_free        (gbAllocator a, void *ptr)                                                  { if (ptr != NULL) a.proc(a.data, gbAllocation_Free, 0, 0, ptr, 0, GB_DEFAULT_ALLOCATOR_FLAGS); }
+gb_inline void  gb_free_all    (gbAllocator a)                                                             { a.proc(a.data, gbAllocation_FreeAll, 0, 0, NULL, 0, GB_DEFAULT_ALLOCATOR_FLAGS); }
+gb_inline void *gb_resize      (gbAllocator a, void *ptr, isize old_size, isize new_size)                  { return gb_resize_align(a, ptr, old_size, new_size, GB_DEFAULT_MEMORY_ALIGNMENT); }
+gb_inline void *gb_resize_align(gbAllocator a, void *ptr, isize old_size, isize new_size, isize alignment) { return a.proc(a.data, gbAllocation_Resize, new_size, alignment, ptr, old_size, GB_DEFAULT_ALLOCATOR_FLAGS); }
+
+gb_inline void *gb_alloc_copy      (gbAllocator a, void const *src, isize size) {
+	return gb_memcopy(gb_alloc(a, size), src, size);
+}
+gb_inline void *gb_alloc_copy_align(gbAllocator a, void const *src, isize size, isize alignment) {
+	return gb_memcopy(gb_alloc_align(a, size, alignment), src, size);
+}
+
+gb_inline char *gb_alloc_str(gbAllocator a, char const *str) {
+	return gb_alloc_str_len(a, str, gb_strlen(str));
+}
+
+gb_inline char *gb_alloc_str_len(gbAllocator a, char const *str, isize len) {
+	char *result;
+	result = cast(char *)gb_alloc_copy(a, str, len+1);
+	result[len] = '\0';
+	return result;
+}
+
+
+gb_inline void *gb_default_resize_align(gbAllocator a, void *old_memory, isize old_size, isize new_size, isize alignment) {
+	if (!old_memory) return gb_alloc_align(a, new_size, alignment);
+
+	if (new_size == 0) {
+		gb_free(a, old_memory);
+		return NULL;
+	}
+
+	if (new_size < old_size)
+		new_size = old_size;
+
+	if (old_size == new_size) {
+		return old_memory;
+	} else {
+		void *new_memory = gb_alloc_align(a, new_size, alignment);
+		if (!new_memory) return NULL;
+		gb_memmove(new_memory, old_memory, gb_min(new_size, old_size));
+		gb_free(a, old_memory);
+		return new_memory;
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Concurrency
+//
+//
+// IMPORTANT TODO(bill): Use compiler intrinsics for the atomics
+
+#if defined(GB_COMPILER_MSVC) && !defined(GB_COMPILER_CLANG)
+gb_inline i32  gb_atomic32_load (gbAtomic32 const volatile *a)      { return a->value;  }
+gb_inline void gb_atomic32_store(gbAtomic32 volatile *a, i32 value) { a->value = value; }
+
+gb_inline i32 gb_atomic32_compare_exchange(gbAtomic32 volatile *a, i32 expected, i32 desired) {
+	return _InterlockedCompareExchange(cast(long volatile *)a, desired, expected);
+}
+gb_inline i32 gb_atomic32_exchanged(gbAtomic32 volatile *a, i32 desired) {
+	return _InterlockedExchange(cast(long volatile *)a, desired);
+}
+gb_inline i32 gb_atomic32_fetch_add(gbAtomic32 volatile *a, i32 operand) {
+	return _InterlockedExchangeAdd(cast(long volatile *)a, operand);
+}
+gb_inline i32 gb_atomic32_fetch_and(gbAtomic32 volatile *a, i32 operand) {
+	return _InterlockedAnd(cast(long volatile *)a, operand);
+}
+gb_inline i32 gb_atomic32_fetch_or(gbAtomic32 volatile *a, i32 operand) {
+	return _InterlockedOr(cast(long volatile *)a, operand);
+}
+
+gb_inline i64 gb_atomic64_load(gbAtomic64 const volatile *a) {
+#if defined(GB_ARCH_64_BIT)
+	return a->value;
+#elif GB_CPU_X86
+	// NOTE(bill): The most compatible way to get an atomic 64-bit load on x86 is with cmpxchg8b
+	i64 result;
+	__asm {
+		mov esi, a;
+		mov ebx, eax;
+		mov ecx, edx;
+		lock cmpxchg8b [esi];
+		mov dword ptr result, eax;
+		mov dword ptr result[4], edx;
+	}
+	return result;
+#else
+#error TODO(bill): atomics for this CPU
+#endif
+}
+
+gb_inline void gb_atomic64_store(gbAtomic64 volatile *a, i64 value) {
+#if defined(GB_ARCH_64_BIT)
+	a->value = value;
+#elif GB_CPU_X86
+	// NOTE(bill): The most compatible way to get an atomic 64-bit store on x86 is with cmpxchg8b
+	__asm {
+		mov esi, a;
+		mov ebx, dword ptr value;
+		mov ecx, dword ptr value[4];
+	retry:
+		cmpxchg8b [esi];
+		jne retry;
+	}
+#else
+#error TODO(bill): atomics for this CPU
+#endif
+}
+
+gb_inline i64 gb_atomic64_compare_exchange(gbAtomic64 volatile *a, i64 expected, i64 desired) {
+	return _InterlockedCompareExchange64(cast(i64 volatile *)a, desired, expected);
+}
+
+gb_inline i64 gb_atomic64_exchanged(gbAtomic64 volatile *a, i64 desired) {
+#if defined(GB_ARCH_64_BIT)
+	return _InterlockedExchange64(cast(i64 volatile *)a, desired);
+#elif GB_CPU_X86
+	i64 expected = a->value;
+	for (;;) {
+		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, desired, expected);
+		if (original == expected)
+			return original;
+		expected = original;
+	}
+#else
+#error TODO(bill): atomics for this CPU
+#endif
+}
+
+gb_inline i64 gb_atomic64_fetch_add(gbAtomic64 volatile *a, i64 operand) {
+#if defined(GB_ARCH_64_BIT)
+	return _InterlockedExchangeAdd64(cast(i64 volatile *)a, operand);
+#elif GB_CPU_X86
+	i64 expected = a->value;
+	for (;;) {
+		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, expected + operand, expected);
+		if (original == expected)
+			return original;
+		expected = original;
+	}
+#else
+#error TODO(bill): atomics for this CPU
+#endif
+}
+
+gb_inline i64 gb_atomic64_fetch_and(gbAtomic64 volatile *a, i64 operand) {
+#if defined(GB_ARCH_64_BIT)
+	return _InterlockedAnd64(cast(i64 volatile *)a, operand);
+#elif GB_CPU_X86
+	i64 expected = a->value;
+	for (;;) {
+		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, expected & operand, expected);
+		if (original == expected)
+			return original;
+		expected = original;
+	}
+#else
+#error TODO(bill): atomics for this CPU
+#endif
+}
+
+gb_inline i64 gb_atomic64_fetch_or(gbAtomic64 volatile *a, i64 operand) {
+#if defined(GB_ARCH_64_BIT)
+	return _InterlockedOr64(cast(i64 volatile *)a, operand);
+#elif GB_CPU_X86
+	i64 expected = a->value;
+	for (;;) {
+		i64 original = _InterlockedCompareExchange64(cast(i64 volatile *)a, expected | operand, expected);
+		if (original == expected)
+			return original;
+		expected = original;
+	}
+#else
+#error TODO(bill): atomics for this CPU
+#endif
+}
+
+
+
+#elif defined(GB_CPU_X86)
+
+gb_inline i32  gb_atomic32_load (gbAtomic32 const volatile *a)      { return a->value;  }
+gb_inline void gb_atomic32_store(gbAtomic32 volatile *a, i32 value) { a->value = value; }
+
+gb_inline i32 gb_atomic32_compare_exchange(gbAtomic32 volatile *a, i32 expected, i32 desired) {
+	i32 original;
+	__asm__ volatile(
+		"lock; cmpxchgl %2, %1"
+		: "=a"(original), "+m"(a->value)
+		: "q"(desired), "0"(expected)
+	);
+	return original;
+}
+
+gb_inline i32 gb_atomic32_exchanged(gbAtomic32 volatile *a, i32 desired) {
+	// NOTE(bill): No lock prefix is necessary for xchgl
+	i32 original;
+	__asm__ volatile(
+		"xchgl %0, %1"
+		: "=r"(original), "+m"(a->value)
+		: "0"(desired)
+	);
+	return original;
+}
+
+gb_inline i32 gb_atomic32_fetch_add(gbAtomic32 volatile *a, i32 operand) {
+	i32 original;
+	__asm__ volatile(
+		"lock; xaddl %0, %1"
+		: "=r"(original), "+m"(a->value)
+		: "0"(operand)
+	);
+	return original;
+}
+
+gb_inline i32 gb_atomic32_fetch_and(gbAtomic32 volatile *a, i32 operand) {
+	i32 original;
+	i32 tmp;
+	__asm__ volatile(
+		"1:     movl    %1, %0\n"
+		"       movl    %0, %2\n"
+		"       andl    %3, %2\n"
+		"       lock; cmpxchgl %2, %1\n"
+		"       jne     1b"
+		: "=&a"(original), "+m"(a->value), "=&r"(tmp)
+		: "r"(operand)
+	);
+	return original;
+}
+
+gb_inline i32 gb_atomic32_fetch_or(gbAtomic32 volatile *a, i32 operand) {
+	i32 original;
+	i32 temp;
+	__asm__ volatile(
+		"1:     movl    %1, %0\n"
+		"       movl    %0, %2\n"
+		"       orl     %3, %2\n"
+		"       lock; cmpxchgl %2, %1\n"
+		"       jne     1b"
+		: "=&a"(original), "+m"(a->value), "=&r"(temp)
+		: "r"(operand)
+	);
+	return original;
+}
+
+
+gb_inline i64 gb_atomic64_load(gbAtomic64 const volatile *a) {
+#if defined(GB_ARCH_64_BIT)
+	return a->value;
+#else
+	i64 original;
+	__asm__ volatile(
+		"movl %%ebx, %%eax\n"
+		"movl %%ecx, %%edx\n"
+		"lock; cmpxchg8b %1"
+		: "=&A"(original)
+		: "m"(a->value)
+	);
+	return original;
+#endif
+}
+
+gb_inline void gb_atomic64_store(gbAtomic64 volatile *a, i64 value) {
+#if defined(GB_ARCH_64_BIT)
+	a->value = value;
+#else
+	i64 expected = a->value;
+	__asm__ volatile(
+		"1:    cmpxchg8b %0\n"
+		"      jne 1b"
+		: "=m"(a->value)
+		: "b"((i32)value), "c"((i32)(value >> 32)), "A"(expected)
+	);
+#endif
+}
+
+gb_inline i64 gb_atomic64_compare_exchange(gbAtomic64 volatile *a, i64 expected, i64 desired) {
+#if defined(GB_ARCH_64_BIT)
+	i64 original;
+	__asm__ volatile(
+		"lock; cmpxchgq %2, %1"
+		: "=a"(original), "+m"(a->value)
+		: "q"(desired), "0"(expected)
+	);
+	return original;
+#else
+	i64 original;
+	__asm__ volatile(
+		"lock; cmpxchg8b %1"
+		: "=A"(original), "+m"(a->value)
+		: "b"((i32)desired), "c"((i32)(desired >> 32)), "0"(expected)
+	);
+	return original;
+#endif
+}
+
+gb_inline i64 gb_atomic64_exchanged(gbAtomic64 volatile *a, i64 desired) {
+#if defined(GB_ARCH_64_BIT)
+	i64 original;
+	__asm__ volatile(
+		"xchgq %0, %1"
+		: "=r"(original), "+m"(a->value)
+		: "0"(desired)
+	);
+	return original;
+#else
+	i64 original = a->value;
+	for (;;) {
+		i64 previous = gb_atomic64_compare_exchange(a, original, desired);
+		if (original == previous)
+			return original;
+		original = previous;
+	}
+#endif
+}
+
+gb_inline i64 gb_atomic64_fetch_add(gbAtomic64 volatile *a, i64 operand) {
+#if defined(GB_ARCH_64_BIT)
+	i64 original;
+	__asm__ volatile(
+		"lock; xaddq %0, %1"
+		: "=r"(original), "+m"(a->value)
+		: "0"(operand)
+	);
+	return original;
+#else
+	for (;;) {
+		i64 original = a->value;
+		if (gb_atomic64_compare_exchange(a, original, original + operand) == original)
+			return original;
+	}
+#endif
+}
+
+gb_inline i64 gb_atomic64_fetch_and(gbAtomic64 volatile *a, i64 operand) {
+#if defined(GB_ARCH_64_BIT)
+	i64 original;
+	i64 tmp;
+	__asm__ volatile(
+		"1:     movq    %1, %0\n"
+		"       movq    %0, %2\n"
+		"       andq    %3, %2\n"
+		"       lock; cmpxchgq %2, %1\n"
+		"       jne     1b"
+		: "=&a"(original), "+m"(a->value), "=&r"(tmp)
+		: "r"(operand)
+	);
+	return original;
+#else
+	for (;;) {
+		i64 original = a->value;
+		if (gb_atomic64_compare_exchange(a, original, original & operand) == original)
+			return original;
+	}
+#endif
+}
+
+gb_inline i64 gb_atomic64_fetch_or(gbAtomic64 volatile *a, i64 operand) {
+#if defined(GB_ARCH_64_BIT)
+	i64 original;
+	i64 temp;
+	__asm__ volatile(
+		"1:     movq    %1, %0\n"
+		"       movq    %0, %2\n"
+		"       orq     %3, %2\n"
+		"       lock; cmpxchgq %2, %1\n"
+		"       jne     1b"
+		: "=&a"(original), "+m"(a->value), "=&r"(temp)
+		: "r"(operand)
+	);
+	return original;
+#else
+	for (;;) {
+		i64 original = a->value;
+		if (gb_atomic64_compare_exchange(a, original, original | operand) == original)
+			return original;
+	}
+#endif
+}
+
+#else
+#error TODO(bill): Implement Atomics for this CPU
+#endif
+
+gb_inline b32 gb_atomic32_spin_lock(gbAtomic32 volatile *a, isize time_out) {
+	i32 old_value = gb_atomic32_compare_exchange(a, 1, 0);
+	i32 counter = 0;
+	while (old_value != 0 && (time_out < 0 || counter++ < time_out)) {
+		gb_yield_thread();
+		old_value = gb_atomic32_compare_exchange(a, 1, 0);
+		gb_mfence();
+	}
+	return old_value == 0;
+}
+gb_inline void gb_atomic32_spin_unlock(gbAtomic32 volatile *a) {
+	gb_atomic32_store(a, 0);
+	gb_mfence();
+}
+
+gb_inline b32 gb_atomic64_spin_lock(gbAtomic64 volatile *a, isize time_out) {
+	i64 old_value = gb_atomic64_compare_exchange(a, 1, 0);
+	i64 counter = 0;
+	while (old_value != 0 && (time_out < 0 || counter++ < time_out)) {
+		gb_yield_thread();
+		old_value = gb_atomic64_compare_exchange(a, 1, 0);
+		gb_mfence();
+	}
+	return old_value == 0;
+}
+
+gb_inline void gb_atomic64_spin_unlock(gbAtomic64 volatile *a) {
+	gb_atomic64_store(a, 0);
+	gb_mfence();
+}
+
+gb_inline b32 gb_atomic32_try_acquire_lock(gbAtomic32 volatile *a) {
+	i32 old_value;
+	gb_yield_thread();
+	old_value = gb_atomic32_compare_exchange(a, 1, 0);
+	gb_mfence();
+	return old_value == 0;
+}
+
+gb_inline b32 gb_atomic64_try_acquire_lock(gbAtomic64 volatile *a) {
+	i64 old_value;
+	gb_yield_thread();
+	old_value = gb_atomic64_compare_exchange(a, 1, 0);
+	gb_mfence();
+	return old_value == 0;
+}
+
+
+
+#if defined(GB_ARCH_32_BIT)
+
+gb_inline void *gb_atomic_ptr_load(gbAtomicPtr const volatile *a) {
+	return cast(void *)cast(intptr)gb_atomic32_load(cast(gbAtomic32 const volatile *)a);
+}
+gb_inline void gb_atomic_ptr_store(gbAtomicPtr volatile *a, void *value) {
+	gb_atomic32_store(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)value);
+}
+gb_inline void *gb_atomic_ptr_compare_exchange(gbAtomicPtr volatile *a, void *expected, void *desired) {
+	return cast(void *)cast(intptr)gb_atomic32_compare_exchange(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)expected, cast(i32)cast(intptr)desired);
+}
+gb_inline void *gb_atomic_ptr_exchanged(gbAtomicPtr volatile *a, void *desired) {
+	return cast(void *)cast(intptr)gb_atomic32_exchanged(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)desired);
+}
+gb_inline void *gb_atomic_ptr_fetch_add(gbAtomicPtr volatile *a, void *operand) {
+	return cast(void *)cast(intptr)gb_atomic32_fetch_add(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)operand);
+}
+gb_inline void *gb_atomic_ptr_fetch_and(gbAtomicPtr volatile *a, void *operand) {
+	return cast(void *)cast(intptr)gb_atomic32_fetch_and(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)operand);
+}
+gb_inline void *gb_atomic_ptr_fetch_or(gbAtomicPtr volatile *a, void *operand) {
+	return cast(void *)cast(intptr)gb_atomic32_fetch_or(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)operand);
+}
+gb_inline b32 gb_atomic_ptr_spin_lock(gbAtomicPtr volatile *a, isize time_out) {
+	return gb_atomic32_spin_lock(cast(gbAtomic32 volatile *)a, time_out);
+}
+gb_inline void gb_atomic_ptr_spin_unlock(gbAtomicPtr volatile *a) {
+	gb_atomic32_spin_unlock(cast(gbAtomic32 volatile *)a);
+}
+gb_inline b32 gb_atomic_ptr_try_acquire_lock(gbAtomicPtr volatile *a) {
+	return gb_atomic32_try_acquire_lock(cast(gbAtomic32 volatile *)a);
+}
+
+#elif defined(GB_ARCH_64_BIT)
 
 gb_inline void *gb_atomic_ptr_load(gbAtomicPtr const volatile *a) {
-	return cast(void *)cast(intptr)gb_atomic32_load(cast(gbAtomic32 const volatile *)a);
+	return cast(void *)cast(intptr)gb_atomic64_load(cast(gbAtomic64 const volatile *)a);
+}
+gb_inline void gb_atomic_ptr_store(gbAtomicPtr volatile *a, void *value) {
+	gb_atomic64_store(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)value);
+}
+gb_inline void *gb_atomic_ptr_compare_exchange(gbAtomicPtr volatile *a, void *expected, void *desired) {
+	return cast(void *)cast(intptr)gb_atomic64_compare_exchange(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)expected, cast(i64)cast(intptr)desired);
+}
+gb_inline void *gb_atomic_ptr_exchanged(gbAtomicPtr volatile *a, void *desired) {
+	return cast(void *)cast(intptr)gb_atomic64_exchanged(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)desired);
+}
+gb_inline void *gb_atomic_ptr_fetch_add(gbAtomicPtr volatile *a, void *operand) {
+	return cast(void *)cast(intptr)gb_atomic64_fetch_add(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)operand);
+}
+gb_inline void *gb_atomic_ptr_fetch_and(gbAtomicPtr volatile *a, void *operand) {
+	return cast(void *)cast(intptr)gb_atomic64_fetch_and(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)operand);
+}
+gb_inline void *gb_atomic_ptr_fetch_or(gbAtomicPtr volatile *a, void *operand) {
+	return cast(void *)cast(intptr)gb_atomic64_fetch_or(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)operand);
+}
+gb_inline b32 gb_atomic_ptr_spin_lock(gbAtomicPtr volatile *a, isize time_out) {
+	return gb_atomic64_spin_lock(cast(gbAtomic64 volatile *)a, time_out);
+}
+gb_inline void gb_atomic_ptr_spin_unlock(gbAtomicPtr volatile *a) {
+	gb_atomic64_spin_unlock(cast(gbAtomic64 volatile *)a);
+}
+gb_inline b32 gb_atomic_ptr_try_acquire_lock(gbAtomicPtr volatile *a) {
+	return gb_atomic64_try_acquire_lock(cast(gbAtomic64 volatile *)a);
+}
+#endif
+
+
+gb_inline void gb_yield_thread(void) {
+#if defined(GB_SYSTEM_WINDOWS)
+	_mm_pause();
+#elif defined(GB_SYSTEM_OSX)
+	__asm__ volatile ("" : : : "memory");
+#elif defined(GB_CPU_X86)
+	_mm_pause();
+#else
+#error Unknown architecture
+#endif
+}
+
+gb_inline void gb_mfence(void) {
+#if defined(GB_SYSTEM_WINDOWS)
+	_ReadWriteBarrier();
+#elif defined(GB_SYSTEM_OSX)
+	__sync_synchronize();
+#elif defined(GB_CPU_X86)
+	_mm_mfence();
+#else
+#error Unknown architecture
+#endif
+}
+
+gb_inline void gb_sfence(void) {
+#if defined(GB_SYSTEM_WINDOWS)
+	_WriteBarrier();
+#elif defined(GB_SYSTEM_OSX)
+	__asm__ volatile ("" : : : "memory");
+#elif defined(GB_CPU_X86)
+	_mm_sfence();
+#else
+#error Unknown architecture
+#endif
+}
+
+gb_inline void gb_lfence(void) {
+#if defined(GB_SYSTEM_WINDOWS)
+	_ReadBarrier();
+#elif defined(GB_SYSTEM_OSX)
+	__asm__ volatile ("" : : : "memory");
+#elif defined(GB_CPU_X86)
+	_mm_lfence();
+#else
+#error Unknown architecture
+#endif
+}
+
+
+gb_inline void gb_semaphore_release(gbSemaphore *s) { gb_semaphore_post(s, 1); }
+
+#if defined(GB_SYSTEM_WINDOWS)
+	gb_inline void gb_semaphore_init   (gbSemaphore *s)            { s->win32_handle = CreateSemaphoreA(NULL, 0, I32_MAX, NULL); }
+	gb_inline void gb_semaphore_destroy(gbSemaphore *s)            { CloseHandle(s->win32_handle); }
+	gb_inline void gb_semaphore_post   (gbSemaphore *s, i32 count) { ReleaseSemaphore(s->win32_handle, count, NULL); }
+	gb_inline void gb_semaphore_wait   (gbSemaphore *s)            { WaitForSingleObject(s->win32_handle, INFINITE); }
+
+#elif defined(GB_SYSTEM_OSX)
+	gb_inline void gb_semaphore_init   (gbSemaphore *s)            { semaphore_create(mach_task_self(), &s->osx_handle, SYNC_POLICY_FIFO, 0); }
+	gb_inline void gb_semaphore_destroy(gbSemaphore *s)            { semaphore_destroy(mach_task_self(), s->osx_handle); }
+	gb_inline void gb_semaphore_post   (gbSemaphore *s, i32 count) { while (count --> 0) semaphore_signal(s->osx_handle); }
+	gb_inline void gb_semaphore_wait   (gbSemaphore *s)            { semaphore_wait(s->osx_handle); }
+
+#elif defined(GB_SYSTEM_UNIX)
+	gb_inline void gb_semaphore_init   (gbSemaphore *s)            { sem_init(&s->unix_handle, 0, 0); }
+	gb_inline void gb_semaphore_destroy(gbSemaphore *s)            { sem_destroy(&s->unix_handle); }
+	gb_inline void gb_semaphore_post   (gbSemaphore *s, i32 count) { while (count --> 0) sem_post(&s->unix_handle); }
+	gb_inline void gb_semaphore_wait   (gbSemaphore *s)            { int i; do { i = sem_wait(&s->unix_handle); } while (i == -1 && errno == EINTR); }
+
+#else
+#error
+#endif
+
+gb_inline void gb_mutex_init(gbMutex *m) {
+#if defined(GB_SYSTEM_WINDOWS)
+	InitializeCriticalSection(&m->win32_critical_section);
+#else
+	pthread_mutexattr_init(&m->pthread_mutexattr);
+	pthread_mutexattr_settype(&m->pthread_mutexattr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&m->pthread_mutex, &m->pthread_mutexattr);
+#endif
+}
+
+gb_inline void gb_mutex_destroy(gbMutex *m) {
+#if defined(GB_SYSTEM_WINDOWS)
+	DeleteCriticalSection(&m->win32_critical_section);
+#else
+	pthread_mutex_destroy(&m->pthread_mutex);
+#endif
+}
+
+gb_inline void gb_mutex_lock(gbMutex *m) {
+#if defined(GB_SYSTEM_WINDOWS)
+	EnterCriticalSection(&m->win32_critical_section);
+#else
+	pthread_mutex_lock(&m->pthread_mutex);
+#endif
+}
+
+gb_inline b32 gb_mutex_try_lock(gbMutex *m) {
+#if defined(GB_SYSTEM_WINDOWS)
+	return TryEnterCriticalSection(&m->win32_critical_section) != 0;
+#else
+	return pthread_mutex_trylock(&m->pthread_mutex) == 0;
+#endif
+}
+
+gb_inline void gb_mutex_unlock(gbMutex *m) {
+#if defined(GB_SYSTEM_WINDOWS)
+	LeaveCriticalSection(&m->win32_critical_section);
+#else
+	pthread_mutex_unlock(&m->pthread_mutex);
+#endif
+}
+
+
+
+
+
+
+
+void gb_thread_init(gbThread *t) {
+	gb_zero_item(t);
+#if defined(GB_SYSTEM_WINDOWS)
+	t->win32_handle = INVALID_HANDLE_VALUE;
+#else
+	t->posix_handle = 0;
+#endif
+	gb_semaphore_init(&t->semaphore);
+}
+
+void gb_thread_destroy(gbThread *t) {
+	if (t->is_running) gb_thread_join(t);
+	gb_semaphore_destroy(&t->semaphore);
+}
+
+
+gb_inline void gb__thread_run(gbThread *t) {
+	gb_semaphore_release(&t->semaphore);
+	t->return_value = t->proc(t);
+}
+
+#if defined(GB_SYSTEM_WINDOWS)
+	gb_inline DWORD __stdcall gb__thread_proc(void *arg) {
+		gbThread *t = cast(gbThread *)arg;
+		gb__thread_run(t);
+		t->is_running = false;
+		return 0;
+	}
+#else
+	gb_inline void *          gb__thread_proc(void *arg) {
+		gbThread *t = cast(gbThread *)arg;
+		gb__thread_run(t);
+		t->is_running = false;
+		return NULL;
+	}
+#endif
+
+gb_inline void gb_thread_start(gbThread *t, gbThreadProc *proc, void *user_data) { gb_thread_start_with_stack(t, proc, user_data, 0); }
+
+gb_inline void gb_thread_start_with_stack(gbThread *t, gbThreadProc *proc, void *user_data, isize stack_size) {
+	GB_ASSERT(!t->is_running);
+	GB_ASSERT(proc != NULL);
+	t->proc = proc;
+	t->user_data = user_data;
+	t->stack_size = stack_size;
+	t->is_running = true;
+
+#if defined(GB_SYSTEM_WINDOWS)
+	t->win32_handle = CreateThread(NULL, stack_size, gb__thread_proc, t, 0, NULL);
+	GB_ASSERT_MSG(t->win32_handle != NULL, "CreateThread: GetLastError");
+#else
+	{
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+		if (stack_size != 0) {
+			pthread_attr_setstacksize(&attr, stack_size);
+		}
+		pthread_create(&t->posix_handle, &attr, gb__thread_proc, t);
+		pthread_attr_destroy(&attr);
+	}
+#endif
+
+	gb_semaphore_wait(&t->semaphore);
+}
+
+gb_inline void gb_thread_join(gbThread *t) {
+	if (!t->is_running) return;
+
+#if defined(GB_SYSTEM_WINDOWS)
+	WaitForSingleObject(t->win32_handle, INFINITE);
+	CloseHandle(t->win32_handle);
+	t->win32_handle = INVALID_HANDLE_VALUE;
+#else
+	pthread_join(t->posix_handle, NULL);
+	t->posix_handle = 0;
+#endif
+	t->is_running = false;
+}
+
+gb_inline b32 gb_thread_is_running(gbThread const *t) { return t->is_running != 0; }
+
+gb_inline u32 gb_thread_current_id(void) {
+	u32 thread_id;
+#if defined(GB_SYSTEM_WINDOWS)
+	#if defined(GB_ARCH_32_BIT) && defined(GB_CPU_X86)
+		thread_id = (cast(u32 *)__readfsdword(24))[9];
+	#elif defined(GB_ARCH_64_BIT) && defined(GB_CPU_X86)
+		thread_id = (cast(u32 *)__readgsqword(48))[18];
+	#else
+		thread_id = GetCurrentThreadId();
+	#endif
+
+#elif defined(GB_SYSTEM_OSX) && defined(GB_ARCH_64_BIT)
+	thread_id = pthread_mach_thread_np(pthread_self());
+#elif defined(GB_ARCH_32_BIT) && defined(GB_CPU_X86)
+	__asm__("mov %%gs:0x08,%0" : "=r"(thread_id));
+#elif defined(GB_ARCH_64_BIT) && defined(GB_CPU_X86)
+	__asm__("mov %%fs:0x10,%0" : "=r"(thread_id));
+#else
+	#error Unsupported architecture for gb_thread_current_id()
+#endif
+
+	return thread_id;
+}
+
+
+
+void gb_thread_set_name(gbThread *t, char const *name) {
+#if defined(GB_COMPILER_MSVC)
+	#pragma pack(push, 8)
+		typedef struct {
+			DWORD       type;
+			char const *name;
+			DWORD       id;
+			DWORD       flags;
+		} gbprivThreadName;
+	#pragma pack(pop)
+		gbprivThreadName tn;
+		tn.type  = 0x1000;
+		tn.name  = name;
+		tn.id    = GetThreadId(cast(HANDLE)t->win32_handle);
+		tn.flags = 0;
+
+		__try {
+			RaiseException(0x406d1388, 0, gb_size_of(tn)/4, cast(ULONG_PTR *)&tn);
+		} __except(1 /*EXCEPTION_EXECUTE_HANDLER*/) {
+		}
+
+#elif defined(GB_SYSTEM_WINDOWS) && !defined(GB_COMPILER_MSVC)
+	// IMPORTANT TODO(bill): Set thread name for GCC/Clang on windows
+	return;
+#elif defined(GB_SYSTEM_OSX)
+	// TODO(bill): Test if this works
+	pthread_setname_np(name);
+#else
+	// TODO(bill): Test if this works
+	pthread_setname_np(t->posix_handle, name);
+#endif
+}
+
+
+
+
+void gb_sync_init(gbSync *s) {
+	gb_zero_item(s);
+	gb_mutex_init(&s->mutex);
+	gb_mutex_init(&s->start);
+	gb_semaphore_init(&s->release);
+}
+
+void gb_sync_destroy(gbSync *s) {
+	if (s->waiting)
+		GB_PANIC("Cannot destroy while threads are waiting!");
+
+	gb_mutex_destroy(&s->mutex);
+	gb_mutex_destroy(&s->start);
+	gb_semaphore_destroy(&s->release);
+}
+
+void gb_sync_set_target(gbSync *s, i32 count) {
+	gb_mutex_lock(&s->start);
+
+	gb_mutex_lock(&s->mutex);
+	GB_ASSERT(s->target == 0);
+	s->target = count;
+	s->current = 0;
+	s->waiting = 0;
+	gb_mutex_unlock(&s->mutex);
+}
+
+void gb_sync_release(gbSync *s) {
+	if (s->waiting) {
+		gb_semaphore_release(&s->release);
+	} else {
+		s->target = 0;
+		gb_mutex_unlock(&s->start);
+	}
+}
+
+i32 gb_sync_reach(gbSync *s) {
+	i32 n;
+	gb_mutex_lock(&s->mutex);
+	GB_ASSERT(s->current < s->target);
+	n = ++s->current; // NOTE(bill): Record this value to avoid possible race if `return s->current` was done
+	if (s->current == s->target)
+		gb_sync_release(s);
+	gb_mutex_unlock(&s->mutex);
+	return n;
+}
+
+void gb_sync_reach_and_wait(gbSync *s) {
+	gb_mutex_lock(&s->mutex);
+	GB_ASSERT(s->current < s->target);
+	s->current++;
+	if (s->current == s->target) {
+		gb_sync_release(s);
+		gb_mutex_unlock(&s->mutex);
+	} else {
+		s->waiting++;                   // NOTE(bill): Waiting, so one more waiter
+		gb_mutex_unlock(&s->mutex);     // NOTE(bill): Release the mutex to other threads
+
+		gb_semaphore_wait(&s->release); // NOTE(bill): Wait for merge completion
+
+		gb_mutex_lock(&s->mutex);       // NOTE(bill): On merge completion, lock mutex
+		s->waiting--;                   // NOTE(bill): Done waiting
+		gb_sync_release(s);             // NOTE(bill): Restart the next waiter
+		gb_mutex_unlock(&s->mutex);
+	}
+}
+
+
+
+
+
+
+
+
+gb_inline gbAllocator gb_heap_allocator(void) {
+	gbAllocator a;
+	a.proc = gb_heap_allocator_proc;
+	a.data = NULL;
+	return a;
+}
+
+GB_ALLOCATOR_PROC(gb_heap_allocator_proc) {
+	void *ptr = NULL;
+	gb_unused(allocator_data);
+	gb_unused(old_size);
+// TODO(bill): Throughly test!
+	switch (type) {
+#if defined(GB_COMPILER_MSVC)
+	case gbAllocation_Alloc:
+		ptr = _aligned_malloc(size, alignment);
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+		break;
+	case gbAllocation_Free:
+		_aligned_free(old_memory);
+		break;
+	case gbAllocation_Resize:
+		ptr = _aligned_realloc(old_memory, size, alignment);
+		break;
+
+#elif defined(GB_SYSTEM_LINUX)
+	// TODO(bill): *nix version that's decent
+	case gbAllocation_Alloc: {
+		// NOTE(bill): aligned_alloc requires the size to be a multiple of the alignment, posix_memalign does not
+		if (posix_memalign(&ptr, gb_max(alignment, gb_size_of(void *)), size) != 0)
+			ptr = NULL;
+
+		if (flags & gbAllocatorFlag_ClearToZero) {
+			gb_zero_size(ptr, size);
+		}
+	} break;
+
+	case gbAllocation_Free: {
+		free(old_memory);
+	} break;
+
+	case gbAllocation_Resize: {
+		// NOTE(bill): realloc only guarantees malloc's alignment but it can grow in place
+		// (and glibc uses mremap for large blocks) so no copy is needed
+		if (alignment <= 2*gb_size_of(void *) && size > 0) {
+			ptr = realloc(old_memory, size);
+		} else {
+			ptr = gb_default_resize_align(gb_heap_allocator(), old_memory, old_size, size, alignment);
+		}
+	} break;
+#else
+	// TODO(bill): *nix version that's decent
+	case gbAllocation_Alloc: {
+		posix_memalign(&ptr, alignment, size);
+
+		if (flags & gbAllocatorFlag_ClearToZero) {
+			gb_zero_size(ptr, size);
+		}
+	} break;
+
+	case gbAllocation_Free: {
+		free(old_memory);
+	} break;
+
+	case gbAllocation_Resize: {
+		if (alignment <= 2*gb_size_of(void *) && size > 0) {
+			ptr = realloc(old_memory, size);
+		} else {
+			ptr = gb_default_resize_align(gb_heap_allocator(), old_memory, old_size, size, alignment);
+		}
+	} break;
+#endif
+
+	case gbAllocation_FreeAll:
+		break;
+	}
+
+	return ptr;
+}
+
+
+
+typedef struct gbVmAllocationHeader {
+	isize size;   // NOTE(bill): Of the whole mapping
+	isize offset; // NOTE(bill): From the start of the mapping to the memory
+} gbVmAllocationHeader;
+
+gb_inline gbAllocator gb_vm_allocator(void) {
+	gbAllocator a;
+	a.proc = gb_vm_allocator_proc;
+	a.data = NULL;
+	return a;
+}
+
+GB_ALLOCATOR_PROC(gb_vm_allocator_proc) {
+	gbVmAllocationHeader *h;
+	void *ptr = NULL;
+	isize page_size = gb_virtual_memory_page_size(NULL);
+	gb_unused(allocator_data);
+	gb_unused(flags);
+
+	switch (type) {
+	case gbAllocation_Alloc: {
+		gbVirtualMemory vm;
+		isize offset = gb_max(alignment, gb_size_of(gbVmAllocationHeader));
+		isize total = (offset + size + page_size-1) & ~(page_size-1);
+		GB_ASSERT_MSG(alignment <= page_size, "%td", alignment);
+		vm = gb_vm_alloc(NULL, total);
+	#if !defined(GB_SYSTEM_WINDOWS)
+		if (vm.data == MAP_FAILED) vm.data = NULL;
+	#endif
+		if (vm.data == NULL)
+			return NULL;
+		// NOTE(bill): New pages are already zeroed
+		ptr = gb_pointer_add(vm.data, offset);
+		h = cast(gbVmAllocationHeader *)ptr - 1;
+		h->size   = total;
+		h->offset = offset;
+	} break;
+
+	case gbAllocation_Free: {
+		h = cast(gbVmAllocationHeader *)old_memory - 1;
+		gb_vm_free(gb_virtual_memory(gb_pointer_sub(old_memory, h->offset), h->size));
+	} break;
+
+	case gbAllocation_Resize: {
+		isize total;
+		if (old_memory == NULL || size == 0)
+			return gb_default_resize_align(gb_vm_allocator(), old_memory, old_size, size, alignment);
+
+		h = cast(gbVmAllocationHeader *)old_memory - 1;
+		if (h->offset % alignment != 0) // NOTE(bill): Remapping keeps the offset within the page
+			return gb_default_resize_align(gb_vm_allocator(), old_memory, old_size, size, alignment);
+
+		total = (h->offset + size + page_size-1) & ~(page_size-1);
+		if (total <= h->size) {
+		#if !defined(GB_SYSTEM_WINDOWS)
+			if (total < h->size) {
+				gb_vm_free(gb_virtual_memory(gb_pointer_add(gb_pointer_sub(old_memory, h->offset), total), h->size - total));
+				h->size = total;
+			}
+		#endif
+			return old_memory;
+		}
+
+	#if defined(GB_SYSTEM_LINUX)
+		{
+			isize offset = h->offset;
+			void *base = mremap(gb_pointer_sub(old_memory, offset), h->size, total, MREMAP_MAYMOVE);
+			if (base == MAP_FAILED)
+				return NULL;
+			ptr = gb_pointer_add(base, offset);
+			h = cast(gbVmAllocationHeader *)ptr - 1;
+			h->size = total;
+		}
+	#else
+		ptr = gb_default_resize_align(gb_vm_allocator(), old_memory, old_size, size, alignment);
+	#endif
+	} break;
+
+	case gbAllocation_FreeAll:
+		break;
+	}
+
+	return ptr;
+}
+
+
+#if defined(GB_SYSTEM_WINDOWS)
+void gb_affinity_init(gbAffinity *a) {
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION *start_processor_info = NULL;
+	DWORD length = 0;
+	b32 result  = GetLogicalProcessorInformation(NULL, &length);
+
+	gb_zero_item(a);
+
+	if (!result && GetLastError() == 122l /*ERROR_INSUFFICIENT_BUFFER*/ && length > 0) {
+		start_processor_info = cast(SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)gb_alloc(gb_heap_allocator(), length);
+		result = GetLogicalProcessorInformation(start_processor_info, &length);
+		if (result) {
+			SYSTEM_LOGICAL_PROCESSOR_INFORMATION *end_processor_info, *processor_info;
+
+			a->is_accurate  = true;
+			a->core_count   = 0;
+			a->thread_count = 0;
+			end_processor_info = cast(SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)gb_pointer_add(start_processor_info, length);
+
+			for (processor_info = start_processor_info;
+			     processor_info < end_processor_info;
+			     processor_info++) {
+				if (processor_info->Relationship == RelationProcessorCore) {
+					isize thread = gb_count_set_bits(processor_info->ProcessorMask);
+					if (thread == 0) {
+						a->is_accurate = false;
+					} else if (a->thread_count + thread > GB_WIN32_MAX_THREADS) {
+						a->is_accurate = false;
+					} else {
+						GB_ASSERT(a->core_count <= a->thread_count &&
+						          a->thread_count < GB_WIN32_MAX_THREADS);
+						a->core_masks[a->core_count++] = processor_info->ProcessorMask;
+						a->thread_count += thread;
+					}
+				}
+			}
+		}
+
+		gb_free(gb_heap_allocator(), start_processor_info);
+	}
+
+	GB_ASSERT(a->core_count <= a->thread_count);
+	if (a->thread_count == 0) {
+		a->is_accurate   = false;
+		a->core_count    = 1;
+		a->thread_count  = 1;
+		a->core_masks[0] = 1;
+	}
+
+}
+void gb_affinity_destroy(gbAffinity *a) {
+	gb_unused(a);
+}
+
+
+b32 gb_affinity_set(gbAffinity *a, isize core, isize thread) {
+	usize available_mask, check_mask = 1;
+	GB_ASSERT(thread < gb_affinity_thread_count_for_core(a, core));
+
+	available_mask = a->core_masks[core];
+	for (;;) {
+		if ((available_mask & check_mask) != 0) {
+			if (thread-- == 0) {
+				usize result = SetThreadAffinityMask(GetCurrentThread(), check_mask);
+				return result != 0;
+			}
+		}
+		check_mask <<= 1; // NOTE(bill): Onto the next bit
+	}
+}
+
+isize gb_affinity_thread_count_for_core(gbAffinity *a, isize core) {
+	GB_ASSERT(core >= 0 && core < a->core_count);
+	return gb_count_set_bits(a->core_masks[core]);
+}
+
+#elif defined(GB_SYSTEM_OSX)
+void gb_affinity_init(gbAffinity *a) {
+	usize count = 0;
+	usize count_size = sizeof(count);
+
+	a->is_accurate      = false;
+	a->thread_count     = 1;
+	a->core_count       = 1;
+	a->threads_per_core = 1;
+
+	if (sysctlbyname("hw.logicalcpu", &count, &count_size, NULL, 0) == 0) {
+		if (count > 0) {
+			a->thread_count = count;
+			// Get # of physical cores
+			if (sysctlbyname("hw.physicalcpu", &count, &count_size, NULL, 0) == 0) {
+				if (count > 0) {
+					a->core_count = count;
+					a->threads_per_core = a->thread_count / count;
+					if (a->threads_per_core < 1)
+						a->threads_per_core = 1;
+					else
+						a->is_accurate = true;
+				}
+			}
+		}
+	}
+
+}
+
+void gb_affinity_destroy(gbAffinity *a) {
+	gb_unused(a);
+}
+
+b32 gb_affinity_set(gbAffinity *a, isize core, isize thread_index) {
+	isize index;
+	thread_t thread;
+	thread_affinity_policy_data_t info;
+	kern_return_t result;
+
+	GB_ASSERT(core < a->core_count);
+	GB_ASSERT(thread_index < a->threads_per_core);
+
+	index = core * a->threads_per_core + thread_index;
+	thread = mach_thread_self();
+	info.affinity_tag = cast(integer_t)index;
+	result = thread_policy_set(thread, THREAD_AFFINITY_POLICY, cast(thread_policy_t)&info, THREAD_AFFINITY_POLICY_COUNT);
+	return result == KERN_SUCCESS;
+}
+
+isize gb_affinity_thread_count_for_core(gbAffinity *a, isize core) {
+	GB_ASSERT(core >= 0 && core < a->core_count);
+	return a->threads_per_core;
+}
+
+#elif defined(GB_SYSTEM_LINUX)
+// IMPORTANT TODO(bill): This gbAffinity stuff for linux needs be improved a lot!
+// NOTE(zangent): I have to read /proc/cpuinfo to get the number of threads per core.
+#include <stdio.h>
+
+void gb_affinity_init(gbAffinity *a) {
+	b32   accurate = true;
+	isize threads = 0;
+
+	a->thread_count     = 1;
+	a->core_count       = sysconf(_SC_NPROCESSORS_ONLN);
+	a->threads_per_core = 1;
+
+
+	if(a->core_count <= 0) {
+		a->core_count = 1;
+		accurate = false;
+	}
+
+	// Parsing /proc/cpuinfo to get the number of threads per core.
+	// NOTE(zangent): This calls the CPU's threads "cores", although the wording
+	// is kind of weird. This should be right, though.
+
+	FILE* cpu_info = fopen("/proc/cpuinfo", "r");
+
+	if (cpu_info != NULL) {
+		for (;;) {
+			// The 'temporary char'. Everything goes into this char,
+			// so that we can check against EOF at the end of this loop.
+			char c;
+
+#define AF__CHECK(letter) ((c = getc(cpu_info)) == letter)
+			if (AF__CHECK('c') && AF__CHECK('p') && AF__CHECK('u') && AF__CHECK(' ') &&
+			    AF__CHECK('c') && AF__CHECK('o') && AF__CHECK('r') && AF__CHECK('e') && AF__CHECK('s')) {
+				// We're on a CPU info line.
+				while (!AF__CHECK(EOF)) {
+					if (c == '\n') {
+						break;
+					} else if (c < '0' || '9' > c) {
+						continue;
+					}
+					threads = threads * 10 + (c - '0');
+				}
+				break;
+			} else {
+				while (!AF__CHECK('\n')) {
+					if (c==EOF) {
+						break;
+					}
+				}
+			}
+			if (c == EOF) {
+				break;
+			}
+#undef AF__CHECK
+		}
+
+		fclose(cpu_info);
+	}
+
+	if (threads == 0) {
+		threads  = 1;
+		accurate = false;
+	}
+
+	a->threads_per_core = threads;
+	a->thread_count = a->threads_per_core * a->core_count;
+	a->is_accurate = accurate;
+
+}
+
+void gb_affinity_destroy(gbAffinity *a) {
+	gb_unused(a);
+}
+
+b32 gb_affinity_set(gbAffinity *a, isize core, isize thread_index) {
+	return true;
+}
+
+isize gb_affinity_thread_count_for_core(gbAffinity *a, isize core) {
+	GB_ASSERT(0 <= core && core < a->core_count);
+	return a->threads_per_core;
+}
+#else
+#error TODO(bill): Unknown system
+#endif
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Parallel Memory
+//
+//
+
+#ifndef GB__MEM_PARALLEL_MIN_CHUNK
+#define GB__MEM_PARALLEL_MIN_CHUNK (1024*1024) // NOTE(bill): Less than this is not worth starting a thread for
+#endif
+
+typedef struct gbMemParallelJob {
+	u8 *      dest;
+	u8 const *source;
+	isize     size;
+	u8        byte_value;
+	b32       is_set;
+	b32       non_temporal;
+} gbMemParallelJob;
+
+gb_global isize gb__mem_parallel_thread_count;
+
+gb_internal void gb__mem_parallel_job_run(gbMemParallelJob *job) {
+	if (job->is_set) {
+		if (job->non_temporal) gb__cpu_dispatch.memset_non_temporal(job->dest, job->byte_value, job->size);
+		else                   gb__cpu_dispatch.memset(job->dest, job->byte_value, job->size);
+	} else {
+		if (job->non_temporal) gb__cpu_dispatch.memcopy_non_temporal(job->dest, job->source, job->size);
+		else                   gb__cpu_dispatch.memcopy(job->dest, job->source, job->size);
+	}
+}
+
+gb_internal GB_THREAD_PROC(gb__mem_parallel_thread_proc) {
+	gb__mem_parallel_job_run(cast(gbMemParallelJob *)thread->user_data);
+	return 0;
+}
+
+gb_internal void gb__mem_parallel(gbMemParallelJob *job, isize thread_count, u32 flags) {
+	gbMemParallelJob jobs[GB_MEM_PARALLEL_MAX_THREADS];
+	gbThread threads[GB_MEM_PARALLEL_MAX_THREADS];
+	isize nt = gb_cpu_dispatch()->non_temporal_threshold; // NOTE(bill): Resolves the table before the threads race to
+	isize i, begin;
+
+	if (flags & gbMemParallel_NonTemporal) {
+		job->non_temporal = true;
+	} else if (!(flags & gbMemParallel_Cached)) {
+		// NOTE(bill): The chunks on their own could be under the threshold but together they still flush the cache
+		job->non_temporal = nt > 0 && job->size >= nt;
+	}
+
+	if (thread_count <= 0) {
+		if (gb__mem_parallel_thread_count == 0) {
+			gbAffinity a;
+			gb_affinity_init(&a);
+			gb__mem_parallel_thread_count = gb_max(a.thread_count, 1);
+			gb_affinity_destroy(&a);
+		}
+		thread_count = gb__mem_parallel_thread_count;
+	}
+	thread_count = gb_min(thread_count, job->size / GB__MEM_PARALLEL_MIN_CHUNK);
+	thread_count = gb_clamp(thread_count, 1, GB_MEM_PARALLEL_MAX_THREADS);
+
+	if (job->size < GB_MEM_PARALLEL_THRESHOLD || thread_count == 1) {
+		gb__mem_parallel_job_run(job);
+		return;
+	}
+
+	begin = 0;
+	for (i = 0; i < thread_count; i++) {
+		isize end = job->size;
+		if (i+1 < thread_count) {
+			end = gb_pointer_diff(job->dest, gb_align_forward(job->dest + job->size/thread_count*(i+1), GB_CACHE_LINE_SIZE));
+		}
+		jobs[i] = *job;
+		jobs[i].dest += begin;
+		jobs[i].size  = end - begin;
+		if (!job->is_set) {
+			jobs[i].source += begin;
+		}
+		begin = end;
+	}
+
+	// NOTE(bill): The calling thread does the first chunk
+	for (i = 1; i < thread_count; i++) {
+		gb_thread_init(&threads[i]);
+		gb_thread_start(&threads[i], cast(gbThreadProc *)gb__mem_parallel_thread_proc, &jobs[i]);
+	}
+	gb__mem_parallel_job_run(&jobs[0]);
+	for (i = 1; i < thread_count; i++) {
+		gb_thread_join(&threads[i]);
+		gb_thread_destroy(&threads[i]);
+	}
+}
+
+void *gb_memcopy_parallel(void *dest, void const *source, isize size, isize thread_count, u32 flags) {
+	gbMemParallelJob job = {0};
+	if (dest == NULL || size <= 0) {
+		return dest;
+	}
+	job.dest   = cast(u8 *)dest;
+	job.source = cast(u8 const *)source;
+	job.size   = size;
+	gb__mem_parallel(&job, thread_count, flags);
+	return dest;
+}
+
+void *gb_memset_parallel(void *data, u8 byte_value, isize size, isize thread_count, u32 flags) {
+	gbMemParallelJob job = {0};
+	if (data == NULL || size <= 0) {
+		return data;
+	}
+	job.dest       = cast(u8 *)data;
+	job.size       = size;
+	job.byte_value = byte_value;
+	job.is_set     = true;
+	gb__mem_parallel(&job, thread_count, flags);
+	return data;
+}
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Virtual Memory
+//
+//
+
+gbVirtualMemory gb_virtual_memory(void *data, isize size) {
+	gbVirtualMemory vm;
+	vm.data = data;
+	vm.size = size;
+	return vm;
+}
+
+
+#if defined(GB_SYSTEM_WINDOWS)
+gb_inline gbVirtualMemory gb_vm_alloc(void *addr, isize size) {
+	gbVirtualMemory vm;
+	GB_ASSERT(size > 0);
+	vm.data = VirtualAlloc(addr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	vm.size = size;
+	return vm;
+}
+
+gb_inline b32 gb_vm_free(gbVirtualMemory vm) {
+	MEMORY_BASIC_INFORMATION info;
+	while (vm.size > 0) {
+		isize region_size = 0;
+		if (VirtualQuery(vm.data, &info, gb_size_of(info)) == 0)
+			return false;
+		if (info.BaseAddress != vm.data ||
+		    info.AllocationBase != vm.data ||
+		    info.State == MEM_FREE) {
+			return false;
+		}
+		// NOTE(bill): A reservation may only be partially committed so it can span multiple regions
+		while (info.AllocationBase == vm.data && info.State != MEM_FREE) {
+			region_size += info.RegionSize;
+			if (VirtualQuery(gb_pointer_add(vm.data, region_size), &info, gb_size_of(info)) == 0)
+				break;
+		}
+		if (region_size > vm.size)
+			return false;
+		if (VirtualFree(vm.data, 0, MEM_RELEASE) == 0)
+			return false;
+		vm.data = gb_pointer_add(vm.data, region_size);
+		vm.size -= region_size;
+	}
+	return true;
+}
+
+gb_inline gbVirtualMemory gb_vm_trim(gbVirtualMemory vm, isize lead_size, isize size) {
+	gbVirtualMemory new_vm = {0};
+	void *ptr;
+	GB_ASSERT(vm.size >= lead_size + size);
+
+	ptr = gb_pointer_add(vm.data, lead_size);
+
+	gb_vm_free(vm);
+	new_vm = gb_vm_alloc(ptr, size);
+	if (new_vm.data == ptr)
+		return new_vm;
+	if (new_vm.data)
+		gb_vm_free(new_vm);
+	return new_vm;
+}
+
+gb_inline b32 gb_vm_purge(gbVirtualMemory vm) {
+	VirtualAlloc(vm.data, vm.size, MEM_RESET, PAGE_READWRITE);
+	// NOTE(bill): Can this really fail?
+	return true;
+}
+
+isize gb_virtual_memory_page_size(isize *alignment_out) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	if (alignment_out) *alignment_out = info.dwAllocationGranularity;
+	return info.dwPageSize;
+}
+
+gb_inline isize gb_virtual_memory_huge_page_size(void) {
+	return cast(isize)GetLargePageMinimum();
+}
+
+isize gb_vm_resident_size(isize *peak_out) {
+	PROCESS_MEMORY_COUNTERS counters = {0};
+	counters.cb = gb_size_of(counters);
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, gb_size_of(counters));
+	if (peak_out) *peak_out = cast(isize)counters.PeakWorkingSetSize;
+	return cast(isize)counters.WorkingSetSize;
+}
+
+gb_inline gbVirtualMemory gb_vm_reserve(void *addr, isize size) {
+	gbVirtualMemory vm;
+	GB_ASSERT(size > 0);
+	vm.data = VirtualAlloc(addr, size, MEM_RESERVE, PAGE_NOACCESS);
+	vm.size = size;
+	return vm;
+}
+
+gb_inline b32 gb_vm_commit(gbVirtualMemory vm) {
+	return VirtualAlloc(vm.data, vm.size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+gb_inline b32 gb_vm_decommit(gbVirtualMemory vm) {
+	return VirtualFree(vm.data, vm.size, MEM_DECOMMIT) != 0;
+}
+
+b32 gb_vm_protect(gbVirtualMemory vm, u32 protection) {
+	DWORD old_protect, protect;
+	b32 r = (protection & gbVirtualMemoryProtection_Read)    != 0;
+	b32 w = (protection & gbVirtualMemoryProtection_Write)   != 0;
+	b32 x = (protection & gbVirtualMemoryProtection_Execute) != 0;
+	if (x) protect = w ? PAGE_EXECUTE_READWRITE : r ? PAGE_EXECUTE_READ : PAGE_EXECUTE;
+	else   protect = w ? PAGE_READWRITE : r ? PAGE_READONLY : PAGE_NOACCESS;
+	return VirtualProtect(vm.data, vm.size, protect, &old_protect) != 0;
+}
+
+gbVirtualMemory gb_vm_alloc_huge(void *addr, isize size) {
+	isize huge_page_size = gb_virtual_memory_huge_page_size();
+	if (huge_page_size > 0) {
+		gbVirtualMemory vm;
+		vm.size = (size + huge_page_size-1) & ~(huge_page_size-1);
+		// NOTE(bill): Needs SeLockMemoryPrivilege
+		vm.data = VirtualAlloc(addr, vm.size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (vm.data != NULL)
+			return vm;
+	}
+	// NOTE(bill): Windows has no transparent huge pages
+	return gb_vm_alloc(addr, size);
+}
+
+gb_inline b32 gb_vm_advise_huge(gbVirtualMemory vm) {
+	gb_unused(vm);
+	return false;
+}
+
+#else
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+gb_inline gbVirtualMemory gb_vm_alloc(void *addr, isize size) {
+	gbVirtualMemory vm;
+	GB_ASSERT(size > 0);
+	vm.data = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	vm.size = size;
+	return vm;
+}
+
+gb_inline b32 gb_vm_free(gbVirtualMemory vm) {
+	munmap(vm.data, vm.size);
+	return true;
+}
+
+gb_inline gbVirtualMemory gb_vm_trim(gbVirtualMemory vm, isize lead_size, isize size) {
+	void *ptr;
+	isize trail_size;
+	GB_ASSERT(vm.size >= lead_size + size);
+
+	ptr = gb_pointer_add(vm.data, lead_size);
+	trail_size = vm.size - lead_size - size;
+
+	if (lead_size != 0)
+		gb_vm_free(gb_virtual_memory(vm.data, lead_size));
+	if (trail_size != 0)
+		gb_vm_free(gb_virtual_memory(gb_pointer_add(ptr, size), trail_size));
+	return gb_virtual_memory(ptr, size);
+
+}
+
+gb_inline b32 gb_vm_purge(gbVirtualMemory vm) {
+	int err = madvise(vm.data, vm.size, MADV_DONTNEED);
+	return err != 0;
+}
+
+isize gb_virtual_memory_page_size(isize *alignment_out) {
+	// TODO(bill): Is this always true?
+	isize result = cast(isize)sysconf(_SC_PAGE_SIZE);
+	if (alignment_out) *alignment_out = result;
+	return result;
+}
+
+// NOTE(bill): Reads a small file such as one in /proc, the result is always zero terminated
+gb_internal isize gb__vm_read_small_file(char const *path, char *buf, isize cap) {
+	isize len = 0;
+	int fd = open(path, O_RDONLY);
+	buf[0] = '\0';
+	if (fd >= 0) {
+		len = read(fd, buf, cap-1);
+		close(fd);
+		len = gb_max(len, 0);
+		buf[len] = '\0';
+	}
+	return len;
+}
+
+gb_global isize gb__vm_huge_page_size = -1;
+
+isize gb_virtual_memory_huge_page_size(void) {
+	if (gb__vm_huge_page_size < 0) {
+		isize result = 0;
+	#if defined(GB_SYSTEM_LINUX)
+		char buf[4096];
+		if (gb__vm_read_small_file("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", buf, gb_size_of(buf)) > 0) {
+			result = cast(isize)gb_str_to_i64(buf, NULL, 10);
+		} else if (gb__vm_read_small_file("/proc/meminfo", buf, gb_size_of(buf)) > 0) {
+			char const *p = buf;
+			while (*p && gb_strncmp(p, "Hugepagesize:", 13) != 0) {
+				while (*p && *p != '\n') p++;
+				if (*p) p++;
+			}
+			if (*p) {
+				p += 13;
+				while (*p == ' ') p++;
+				result = cast(isize)gb_str_to_i64(p, NULL, 10) * 1024;
+			}
+		}
+	#endif
+		gb__vm_huge_page_size = result;
+	}
+	return gb__vm_huge_page_size;
+}
+
+isize gb_vm_resident_size(isize *peak_out) {
+	isize result = 0;
+	if (peak_out) {
+		struct rusage usage = {0};
+		getrusage(RUSAGE_SELF, &usage);
+	#if defined(GB_SYSTEM_OSX)
+		*peak_out = cast(isize)usage.ru_maxrss; // NOTE(bill): In bytes on OSX
+	#else
+		*peak_out = cast(isize)usage.ru_maxrss * 1024;
+	#endif
+	}
+#if defined(GB_SYSTEM_OSX)
+	{
+		struct mach_task_basic_info info;
+		mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+		if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, cast(task_info_t)&info, &count) == KERN_SUCCESS)
+			result = cast(isize)info.resident_size;
+	}
+#else
+	{
+		// NOTE(bill): The second field of statm is the resident page count
+		char buf[128];
+		if (gb__vm_read_small_file("/proc/self/statm", buf, gb_size_of(buf)) > 0) {
+			char *p = buf;
+			while (*p && *p != ' ') p++;
+			while (*p == ' ') p++;
+			result = cast(isize)gb_str_to_i64(p, NULL, 10) * gb_virtual_memory_page_size(NULL);
+		}
+	}
+#endif
+	return result;
+}
+
+gb_inline gbVirtualMemory gb_vm_reserve(void *addr, isize size) {
+	gbVirtualMemory vm;
+	GB_ASSERT(size > 0);
+	vm.data = mmap(addr, size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+	if (vm.data == MAP_FAILED)
+		vm.data = NULL;
+	vm.size = size;
+	return vm;
+}
+
+gb_inline b32 gb_vm_commit(gbVirtualMemory vm) {
+	return mprotect(vm.data, vm.size, PROT_READ | PROT_WRITE) == 0;
+}
+
+gb_inline b32 gb_vm_decommit(gbVirtualMemory vm) {
+	// NOTE(bill): Mapping over the range drops the pages _and_ the commit charge, madvise only does the former
+	void *ptr = mmap(vm.data, vm.size, PROT_NONE, MAP_FIXED | MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+	return ptr != MAP_FAILED;
+}
+
+gb_inline b32 gb_vm_protect(gbVirtualMemory vm, u32 protection) {
+	int prot = PROT_NONE;
+	if (protection & gbVirtualMemoryProtection_Read)    prot |= PROT_READ;
+	if (protection & gbVirtualMemoryProtection_Write)   prot |= PROT_WRITE;
+	if (protection & gbVirtualMemoryProtection_Execute) prot |= PROT_EXEC;
+	return mprotect(vm.data, vm.size, prot) == 0;
+}
+
+gb_inline b32 gb_vm_advise_huge(gbVirtualMemory vm) {
+#if defined(MADV_HUGEPAGE)
+	return madvise(vm.data, vm.size, MADV_HUGEPAGE) == 0;
+#else
+	gb_unused(vm);
+	return false;
+#endif
+}
+
+gbVirtualMemory gb_vm_alloc_huge(void *addr, isize size) {
+	gbVirtualMemory vm = {0};
+	isize huge_page_size = gb_virtual_memory_huge_page_size();
+	if (huge_page_size <= 0)
+		return gb_vm_alloc(addr, size);
+
+	size = (size + huge_page_size-1) & ~(huge_page_size-1);
+#if defined(MAP_HUGETLB)
+	vm.data = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+	if (vm.data != MAP_FAILED) {
+		vm.size = size;
+		return vm;
+	}
+#endif
+
+	// NOTE(bill): Transparent huge pages need the range to be huge page aligned
+	vm = gb_vm_alloc(addr, size + huge_page_size);
+	if (vm.data == MAP_FAILED) {
+		vm.data = NULL;
+		vm.size = 0;
+		return vm;
+	}
+	vm = gb_vm_trim(vm, gb_pointer_diff(vm.data, gb_align_forward(vm.data, huge_page_size)), size);
+	gb_vm_advise_huge(vm);
+	return vm;
+}
+
+#endif
+
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Custom Allocation
+//
+//
+
+
+//
+// Arena Allocator
+//
+
+gb_inline void gb_arena_init_from_memory(gbArena *arena, void *start, isize size) {
+	gb_zero_item(arena);
+	arena->physical_start  = start;
+	arena->total_size      = size;
+}
+
+gb_inline void gb_arena_init_from_allocator(gbArena *arena, gbAllocator backing, isize size) {
+	gb_zero_item(arena);
+	arena->backing         = backing;
+	arena->physical_start  = gb_alloc(backing, size); // NOTE(bill): Uses default alignment
+	arena->total_size      = size;
+}
+
+void gb_arena_init_from_virtual_memory(gbArena *arena, isize reserve_size) {
+	isize page_size = gb_virtual_memory_page_size(NULL);
+	isize commit_size = gb_max(GB_ARENA_COMMIT_SIZE, page_size);
+	gbVirtualMemory vm;
+
+	gb_zero_item(arena);
+
+	commit_size  = (commit_size  + page_size-1) & ~(page_size-1);
+	reserve_size = (reserve_size + commit_size-1) & ~(commit_size-1);
+
+	vm = gb_vm_reserve(NULL, reserve_size);
+	if (vm.data == NULL) {
+		gb_printf_err("Arena failed to reserve %td bytes\n", reserve_size);
+		return;
+	}
+
+	arena->physical_start     = vm.data;
+	arena->total_size         = vm.size;
+	arena->commit_size        = commit_size;
+	arena->decommit_threshold = GB_ARENA_DECOMMIT_THRESHOLD;
+}
+
+gb_inline void gb_arena_init_sub(gbArena *arena, gbArena *parent_arena, isize size) { gb_arena_init_from_allocator(arena, gb_arena_allocator(parent_arena), size); }
+
+
+gb_inline void gb_arena_free(gbArena *arena) {
+	if (arena->commit_size > 0) {
+		if (arena->physical_start)
+			gb_vm_free(gb_virtual_memory(arena->physical_start, arena->total_size));
+		arena->physical_start  = NULL;
+		arena->total_committed = 0;
+	} else if (arena->backing.proc) {
+		gb_free(arena->backing, arena->physical_start);
+		arena->physical_start = NULL;
+	}
+}
+
+
+// NOTE(bill): Makes sure the first `size` bytes of a virtual memory arena can be touched
+gb_internal b32 gb__arena_commit(gbArena *arena, isize size) {
+	isize new_committed;
+	if (arena->commit_size <= 0 || size <= arena->total_committed)
+		return true;
+
+	new_committed = (size + arena->commit_size-1) & ~(arena->commit_size-1);
+	if (new_committed > arena->total_size)
+		new_committed = arena->total_size;
+
+	if (!gb_vm_commit(gb_virtual_memory(gb_pointer_add(arena->physical_start, arena->total_committed),
+	                                    new_committed - arena->total_committed))) {
+		return false;
+	}
+	arena->total_committed = new_committed;
+	return true;
+}
+
+// NOTE(bill): Gives pages back to the OS if too much committed memory is unused (e.g. after a spike)
+gb_internal void gb__arena_decommit(gbArena *arena) {
+	isize keep;
+	if (arena->commit_size <= 0 || arena->decommit_threshold < 0)
+		return;
+
+	keep = arena->total_allocated + arena->decommit_threshold;
+	keep = (keep + arena->commit_size-1) & ~(arena->commit_size-1);
+	if (keep < arena->total_committed) {
+		if (gb_vm_decommit(gb_virtual_memory(gb_pointer_add(arena->physical_start, keep),
+		                                     arena->total_committed - keep))) {
+			arena->total_committed = keep;
+		}
+	}
+}
+
+
+gb_inline isize gb_arena_alignment_of(gbArena *arena, isize alignment) {
+	isize alignment_offset, result_pointer, mask;
+	GB_ASSERT(gb_is_power_of_two(alignment));
+
+	alignment_offset = 0;
+	result_pointer = cast(isize)arena->physical_start + arena->total_allocated;
+	mask = alignment - 1;
+	if (result_pointer & mask)
+		alignment_offset = alignment - (result_pointer & mask);
+
+	return alignment_offset;
 }
-gb_inline void gb_atomic_ptr_store(gbAtomicPtr volatile *a, void *value) {
-	gb_atomic32_store(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)value);
+
+gb_inline isize gb_arena_size_remaining(gbArena *arena, isize alignment) {
+	isize result = arena->total_size - (arena->total_allocated + gb_arena_alignment_of(arena, alignment));
+	return result;
 }
-gb_inline void *gb_atomic_ptr_compare_exchange(gbAtomicPtr volatile *a, void *expected, void *desired) {
-	return cast(void *)cast(intptr)gb_atomic32_compare_exchange(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)expected, cast(i32)cast(intptr)desired);
+
+gb_inline void gb_arena_check(gbArena *arena) { GB_ASSERT(arena->temp_count == 0); }
+
+
+
+
+
+
+gb_inline gbAllocator gb_arena_allocator(gbArena *arena) {
+	gbAllocator allocator;
+	allocator.proc = gb_arena_allocator_proc;
+	allocator.data = arena;
+	return allocator;
 }
-gb_inline void *gb_atomic_ptr_exchanged(gbAtomicPtr volatile *a, void *desired) {
-	return cast(void *)cast(intptr)gb_atomic32_exchanged(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)desired);
+
+GB_ALLOCATOR_PROC(gb_arena_allocator_proc) {
+	gbArena *arena = cast(gbArena *)allocator_data;
+	void *ptr = NULL;
+
+	gb_unused(old_size);
+
+	switch (type) {
+	case gbAllocation_Alloc: {
+		isize offset = arena->total_allocated + gb_arena_alignment_of(arena, alignment);
+
+		// NOTE(bill): Out of memory
+		if (offset + size > cast(isize)arena->total_size) {
+			gb_printf_err("Arena out of memory\n");
+			return NULL;
+		}
+		if (!gb__arena_commit(arena, offset + size)) {
+			gb_printf_err("Arena failed to commit memory\n");
+			return NULL;
+		}
+
+		ptr = gb_pointer_add(arena->physical_start, offset);
+		arena->total_allocated = offset + size;
+		arena->prev_allocation = ptr;
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
+
+	case gbAllocation_Free:
+		// NOTE(bill): Free all at once
+		// Use Temp_Arena_Memory if you want to free a block
+		break;
+
+	case gbAllocation_FreeAll:
+		arena->total_allocated = 0;
+		arena->prev_allocation = NULL;
+		gb__arena_decommit(arena);
+		break;
+
+	case gbAllocation_Resize: {
+		// NOTE(bill): If ptr is on top of the stack, just extend (or shrink) it
+		if (old_memory != NULL && old_memory == arena->prev_allocation && size > 0 &&
+		    (cast(uintptr)old_memory & cast(uintptr)(alignment-1)) == 0) {
+			isize offset = gb_pointer_diff(arena->physical_start, old_memory);
+			if (offset + size > cast(isize)arena->total_size) {
+				gb_printf_err("Arena out of memory\n");
+				return NULL;
+			}
+			if (!gb__arena_commit(arena, offset + size)) {
+				gb_printf_err("Arena failed to commit memory\n");
+				return NULL;
+			}
+			arena->total_allocated = offset + size;
+			ptr = old_memory;
+		} else {
+			gbAllocator a = gb_arena_allocator(arena);
+			ptr = gb_default_resize_align(a, old_memory, old_size, size, alignment);
+		}
+	} break;
+	}
+	return ptr;
 }
-gb_inline void *gb_atomic_ptr_fetch_add(gbAtomicPtr volatile *a, void *operand) {
-	return cast(void *)cast(intptr)gb_atomic32_fetch_add(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)operand);
+
+
+gb_inline gbTempArenaMemory gb_temp_arena_memory_begin(gbArena *arena) {
+	gbTempArenaMemory tmp;
+	tmp.arena = arena;
+	tmp.original_count = arena->total_allocated;
+	arena->temp_count++;
+	// NOTE(bill): Anything allocated before the temp memory must not grow past original_count
+	arena->prev_allocation = NULL;
+	return tmp;
 }
-gb_inline void *gb_atomic_ptr_fetch_and(gbAtomicPtr volatile *a, void *operand) {
-	return cast(void *)cast(intptr)gb_atomic32_fetch_and(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)operand);
+
+gb_inline void gb_temp_arena_memory_end(gbTempArenaMemory tmp) {
+	GB_ASSERT_MSG(tmp.arena->total_allocated >= tmp.original_count,
+	              "%td >= %td", tmp.arena->total_allocated, tmp.original_count);
+	GB_ASSERT(tmp.arena->temp_count > 0);
+	tmp.arena->total_allocated = tmp.original_count;
+	tmp.arena->prev_allocation = NULL;
+	tmp.arena->temp_count--;
+	gb__arena_decommit(tmp.arena);
 }
-gb_inline void *gb_atomic_ptr_fetch_or(gbAtomicPtr volatile *a, void *operand) {
-	return cast(void *)cast(intptr)gb_atomic32_fetch_or(cast(gbAtomic32 volatile *)a, cast(i32)cast(intptr)operand);
+
+
+
+//
+// Thread Scratch Arenas
+//
+
+gb_global gb_thread_local gbArena gb__scratch_arenas[GB_SCRATCH_ARENA_COUNT];
+
+gb_inline gbTempArenaMemory gb_scratch_arena_begin(gbArena *conflict) {
+	return gb_scratch_arena_begin_conflicts(&conflict, conflict != NULL ? 1 : 0);
 }
-gb_inline b32 gb_atomic_ptr_spin_lock(gbAtomicPtr volatile *a, isize time_out) {
-	return gb_atomic32_spin_lock(cast(gbAtomic32 volatile *)a, time_out);
+
+gbTempArenaMemory gb_scratch_arena_begin_conflicts(gbArena **conflicts, isize conflict_count) {
+	gbTempArenaMemory tmp = {0};
+	isize i, j;
+	for (i = 0; i < GB_SCRATCH_ARENA_COUNT; i++) {
+		gbArena *arena = &gb__scratch_arenas[i];
+		b32 is_conflict = false;
+		for (j = 0; j < conflict_count; j++) {
+			if (conflicts[j] == arena) {
+				is_conflict = true;
+				break;
+			}
+		}
+		if (is_conflict)
+			continue;
+
+		if (arena->physical_start == NULL) {
+			gb_arena_init_from_virtual_memory(arena, GB_SCRATCH_ARENA_RESERVE_SIZE);
+			GB_ASSERT_MSG(arena->physical_start != NULL, "Failed to reserve a scratch arena");
+		}
+		return gb_temp_arena_memory_begin(arena);
+	}
+	GB_PANIC("Every scratch arena of this thread is a conflict");
+	return tmp;
 }
-gb_inline void gb_atomic_ptr_spin_unlock(gbAtomicPtr volatile *a) {
-	gb_atomic32_spin_unlock(cast(gbAtomic32 volatile *)a);
+
+gb_inline void gb_scratch_arena_end(gbTempArenaMemory scratch) {
+	gb_temp_arena_memory_end(scratch);
 }
-gb_inline b32 gb_atomic_ptr_try_acquire_lock(gbAtomicPtr volatile *a) {
-	return gb_atomic32_try_acquire_lock(cast(gbAtomic32 volatile *)a);
+
+void gb_scratch_arena_free_thread(void) {
+	isize i;
+	for (i = 0; i < GB_SCRATCH_ARENA_COUNT; i++) {
+		gbArena *arena = &gb__scratch_arenas[i];
+		if (arena->physical_start != NULL) {
+			GB_ASSERT_MSG(arena->temp_count == 0, "Scratch arena still in use");
+			gb_arena_free(arena);
+			gb_zero_item(arena);
+		}
+	}
 }
 
-#elif defined(GB_ARCH_64_BIT)
 
-gb_inline void *gb_atomic_ptr_load(gbAtomicPtr const volatile *a) {
-	return cast(void *)cast(intptr)gb_atomic64_load(cast(gbAtomic64 const volatile *)a);
+
+
+//
+// Pool Allocator
+//
+
+
+gb_inline void gb_pool_init(gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size) {
+	gb_pool_init_align(pool, backing, num_blocks, block_size, GB_DEFAULT_MEMORY_ALIGNMENT);
 }
-gb_inline void gb_atomic_ptr_store(gbAtomicPtr volatile *a, void *value) {
-	gb_atomic64_store(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)value);
+
+gb_inline isize gb__pool_block_stride(gbPool *pool) {
+	isize stride = gb_max(pool->block_size, gb_size_of(void *));
+	return (stride + pool->block_align-1) & ~(pool->block_align-1);
 }
-gb_inline void *gb_atomic_ptr_compare_exchange(gbAtomicPtr volatile *a, void *expected, void *desired) {
-	return cast(void *)cast(intptr)gb_atomic64_compare_exchange(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)expected, cast(i64)cast(intptr)desired);
+
+gb_inline void *gb__pool_slab_blocks(gbPool *pool, gbPoolSlab *slab) {
+	return gb_align_forward(slab+1, pool->block_align);
 }
-gb_inline void *gb_atomic_ptr_exchanged(gbAtomicPtr volatile *a, void *desired) {
-	return cast(void *)cast(intptr)gb_atomic64_exchanged(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)desired);
+
+// NOTE(bill): Links the blocks of a slab together and puts them in front of `next`
+gb_internal void *gb__pool_slab_link(gbPool *pool, gbPoolSlab *slab, void *next) {
+	isize stride = gb__pool_block_stride(pool);
+	u8 *data = cast(u8 *)gb__pool_slab_blocks(pool, slab);
+	isize block_index;
+
+	for (block_index = 0; block_index < slab->block_count-1; block_index++) {
+		*cast(void **)(data + block_index*stride) = data + (block_index+1)*stride;
+	}
+	*cast(void **)(data + (slab->block_count-1)*stride) = next;
+	return data;
 }
-gb_inline void *gb_atomic_ptr_fetch_add(gbAtomicPtr volatile *a, void *operand) {
-	return cast(void *)cast(intptr)gb_atomic64_fetch_add(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)operand);
+
+void gb_pool_init_align(gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size, isize block_align) {
+	GB_ASSERT(num_blocks > 0);
+	GB_ASSERT(gb_is_power_of_two(block_align));
+
+	gb_zero_item(pool);
+
+	pool->backing         = backing;
+	pool->block_size      = block_size;
+	pool->block_align     = block_align;
+	pool->blocks_per_slab = num_blocks;
+
+	gb_pool_grow(pool);
 }
-gb_inline void *gb_atomic_ptr_fetch_and(gbAtomicPtr volatile *a, void *operand) {
-	return cast(void *)cast(intptr)gb_atomic64_fetch_and(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)operand);
+
+void gb_pool_init_slabs(gbPool *pool, gbAllocator backing, isize slab_size, isize block_size, isize block_align) {
+	isize header_size;
+	GB_ASSERT(gb_is_power_of_two(slab_size));
+	GB_ASSERT(gb_is_power_of_two(block_align));
+
+	gb_zero_item(pool);
+
+	pool->backing     = backing;
+	pool->block_size  = block_size;
+	pool->block_align = block_align;
+	pool->slab_size   = slab_size;
+
+	header_size = (gb_size_of(gbPoolSlab) + block_align-1) & ~(block_align-1);
+	pool->blocks_per_slab = (slab_size - header_size) / gb__pool_block_stride(pool);
+	GB_ASSERT_MSG(pool->blocks_per_slab > 0, "Slab size %td is too small for blocks of %td bytes", slab_size, block_size);
 }
-gb_inline void *gb_atomic_ptr_fetch_or(gbAtomicPtr volatile *a, void *operand) {
-	return cast(void *)cast(intptr)gb_atomic64_fetch_or(cast(gbAtomic64 volatile *)a, cast(i64)cast(intptr)operand);
+
+b32 gb_pool_grow(gbPool *pool) {
+	gbPoolSlab *slab;
+	if (pool->slab_size > 0) {
+		slab = cast(gbPoolSlab *)gb_alloc_align(pool->backing, pool->slab_size, pool->slab_size);
+	} else {
+		isize header_size = gb_size_of(gbPoolSlab) + pool->block_align;
+		isize slab_size = header_size + pool->blocks_per_slab*gb__pool_block_stride(pool);
+		slab = cast(gbPoolSlab *)gb_alloc_align(pool->backing, slab_size, pool->block_align);
+	}
+	if (slab == NULL) {
+		return false;
+	}
+
+	slab->next        = cast(gbPoolSlab *)pool->physical_start;
+	slab->pool        = pool;
+	slab->block_count = pool->blocks_per_slab;
+
+	pool->physical_start = slab;
+	pool->free_list      = gb__pool_slab_link(pool, slab, pool->free_list);
+	pool->slab_count++;
+	return true;
 }
-gb_inline b32 gb_atomic_ptr_spin_lock(gbAtomicPtr volatile *a, isize time_out) {
-	return gb_atomic64_spin_lock(cast(gbAtomic64 volatile *)a, time_out);
+
+gb_inline void gb_pool_free(gbPool *pool) {
+	if (pool->backing.proc) {
+		gbPoolSlab *slab = cast(gbPoolSlab *)pool->physical_start;
+		while (slab) {
+			gbPoolSlab *next = slab->next;
+			gb_free(pool->backing, slab);
+			slab = next;
+		}
+		pool->physical_start = NULL;
+		pool->free_list      = NULL;
+		pool->slab_count     = 0;
+	}
 }
-gb_inline void gb_atomic_ptr_spin_unlock(gbAtomicPtr volatile *a) {
-	gb_atomic64_spin_unlock(cast(gbAtomic64 volatile *)a);
+
+// NOTE(bill): Returns the index of the slab (sorted by address) that contains ptr
+gb_internal isize gb__pool_find_slab(gbPoolSlab **slabs, isize slab_count, void *ptr) {
+	isize lo = 0, hi = slab_count-1;
+	while (lo < hi) {
+		isize mid = lo + (hi-lo+1)/2;
+		if (cast(uintptr)slabs[mid] <= cast(uintptr)ptr)
+			lo = mid;
+		else
+			hi = mid-1;
+	}
+	return lo;
 }
-gb_inline b32 gb_atomic_ptr_try_acquire_lock(gbAtomicPtr volatile *a) {
-	return gb_atomic64_try_acquire_lock(cast(gbAtomic64 volatile *)a);
+
+gb_internal GB_COMPARE_PROC(gb__pool_slab_cmp) {
+	// NOTE(bill): As addresses, a signed compare gets the order wrong for the upper half (on 32 bit)
+	uintptr p = cast(uintptr)*cast(gbPoolSlab *const *)a;
+	uintptr q = cast(uintptr)*cast(gbPoolSlab *const *)b;
+	return p < q ? -1 : p > q;
 }
-#endif
 
+isize gb_pool_trim(gbPool *pool) {
+	gbPoolSlab **slabs, *slab;
+	isize *free_counts;
+	isize slab_count = pool->slab_count;
+	isize released = 0, i;
+	void **prev_next, *block;
+
+	if (slab_count == 0 || pool->free_list == NULL) {
+		return 0;
+	}
+
+	slabs = cast(gbPoolSlab **)gb_alloc(pool->backing, slab_count * (gb_size_of(gbPoolSlab *) + gb_size_of(isize)));
+	if (slabs == NULL) {
+		return 0;
+	}
+	free_counts = cast(isize *)(slabs + slab_count);
+
+	i = 0;
+	for (slab = cast(gbPoolSlab *)pool->physical_start; slab; slab = slab->next) {
+		slabs[i] = slab;
+		free_counts[i] = 0;
+		i++;
+	}
+	gb_sort_array(slabs, slab_count, gb__pool_slab_cmp);
+
+	// NOTE(bill): Count the free blocks of each slab, a slab is empty if all of its blocks are free
+	for (block = pool->free_list; block; block = *cast(void **)block) {
+		free_counts[gb__pool_find_slab(slabs, slab_count, block)]++;
+	}
+	for (i = 0; i < slab_count; i++) {
+		if (free_counts[i] == slabs[i]->block_count) {
+			free_counts[i] = -1;
+			released++;
+		}
+	}
+
+	if (released > 0) {
+		gbPoolSlab **prev_slab;
+
+		prev_next = &pool->free_list;
+		for (block = pool->free_list; block; block = *cast(void **)block) {
+			if (free_counts[gb__pool_find_slab(slabs, slab_count, block)] >= 0) {
+				*prev_next = block;
+				prev_next = cast(void **)block;
+			}
+		}
+		*prev_next = NULL;
+
+		prev_slab = cast(gbPoolSlab **)&pool->physical_start;
+		for (slab = cast(gbPoolSlab *)pool->physical_start; slab; slab = slab->next) {
+			if (free_counts[gb__pool_find_slab(slabs, slab_count, slab)] >= 0) {
+				*prev_slab = slab;
+				prev_slab = &slab->next;
+			}
+		}
+		*prev_slab = NULL;
+
+		for (i = 0; i < slab_count; i++) {
+			if (free_counts[i] < 0)
+				gb_free(pool->backing, slabs[i]);
+		}
+		pool->slab_count -= released;
+	}
+
+	gb_free(pool->backing, slabs);
+	return released;
+}
+
+
+gb_inline gbAllocator gb_pool_allocator(gbPool *pool) {
+	gbAllocator allocator;
+	allocator.proc = gb_pool_allocator_proc;
+	allocator.data = pool;
+	return allocator;
+}
+GB_ALLOCATOR_PROC(gb_pool_allocator_proc) {
+	gbPool *pool = cast(gbPool *)allocator_data;
+	void *ptr = NULL;
+
+	gb_unused(old_size);
+
+	switch (type) {
+	case gbAllocation_Alloc: {
+		uintptr next_free;
+		GB_ASSERT(size      == pool->block_size);
+		GB_ASSERT(alignment == pool->block_align);
+		if (pool->free_list == NULL && !gb_pool_grow(pool)) {
+			gb_printf_err("Pool out of memory\n");
+			return NULL;
+		}
+
+		next_free = *cast(uintptr *)pool->free_list;
+		ptr = pool->free_list;
+		pool->free_list = cast(void *)next_free;
+		pool->total_size += pool->block_size;
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
+
+	case gbAllocation_Free: {
+		uintptr *next;
+		if (old_memory == NULL) return NULL;
+
+		next = cast(uintptr *)old_memory;
+		*next = cast(uintptr)pool->free_list;
+		pool->free_list = old_memory;
+		pool->total_size -= pool->block_size;
+	} break;
+
+	case gbAllocation_FreeAll: {
+		// NOTE(bill): Rebuild the free list across every slab
+		gbPoolSlab *slab;
+		pool->free_list = NULL;
+		for (slab = cast(gbPoolSlab *)pool->physical_start; slab; slab = slab->next) {
+			pool->free_list = gb__pool_slab_link(pool, slab, pool->free_list);
+		}
+		pool->total_size = 0;
+	} break;
+
+	case gbAllocation_Resize:
+		// NOTE(bill): Cannot resize
+		GB_PANIC("You cannot resize something allocated by with a pool.");
+		break;
+	}
 
-gb_inline void gb_yield_thread(void) {
-#if defined(GB_SYSTEM_WINDOWS)
-	_mm_pause();
-#elif defined(GB_SYSTEM_OSX)
-	__asm__ volatile ("" : : : "memory");
-#elif defined(GB_CPU_X86)
-	_mm_pause();
-#else
-#error Unknown architecture
-#endif
+	return ptr;
 }
 
-gb_inline void gb_mfence(void) {
-#if defined(GB_SYSTEM_WINDOWS)
-	_ReadWriteBarrier();
-#elif defined(GB_SYSTEM_OSX)
-	__sync_synchronize();
-#elif defined(GB_CPU_X86)
-	_mm_mfence();
-#else
-#error Unknown architecture
+
+
+
+
+//
+// Concurrent Pool Allocator
+//
+
+// NOTE(bill): The shared free list head is a pointer with an ABA tag in the bits above the address. That needs
+// user space pointers to fit in 48 bits (asserted when blocks are pushed), which is not true with top byte
+// tagging (ARM64 TBI/MTE, Android) or 5 level paging. There (or if GB_POOL_LOCKED_FREE_LIST is defined)
+// bit 0 of the head is a spin lock instead, blocks are always at least pointer aligned.
+#if !defined(GB_POOL_LOCKED_FREE_LIST) && defined(GB_ARCH_64_BIT) && \
+    (defined(__ANDROID__) || defined(__ARM_FEATURE_MEMORY_TAGGING))
+#define GB_POOL_LOCKED_FREE_LIST
 #endif
-}
 
-gb_inline void gb_sfence(void) {
-#if defined(GB_SYSTEM_WINDOWS)
-	_WriteBarrier();
-#elif defined(GB_SYSTEM_OSX)
-	__asm__ volatile ("" : : : "memory");
-#elif defined(GB_CPU_X86)
-	_mm_sfence();
+#if defined(GB_POOL_LOCKED_FREE_LIST)
+#define GB__POOL_TAG_PTR(x) (cast(void *)(cast(uintptr)(x) & ~cast(uintptr)1))
 #else
-#error Unknown architecture
+#if defined(GB_ARCH_64_BIT)
+#define GB__POOL_TAG_SHIFT 48
+#else
+#define GB__POOL_TAG_SHIFT 32
 #endif
-}
 
-gb_inline void gb_lfence(void) {
-#if defined(GB_SYSTEM_WINDOWS)
-	_ReadBarrier();
-#elif defined(GB_SYSTEM_OSX)
-	__asm__ volatile ("" : : : "memory");
-#elif defined(GB_CPU_X86)
-	_mm_lfence();
-#else
-#error Unknown architecture
+#define GB__POOL_TAG_PTR(x)       (cast(void *)cast(uintptr)(cast(u64)(x) & ((cast(u64)1 << GB__POOL_TAG_SHIFT)-1)))
+#define GB__POOL_TAG_MAKE(ptr, x) (cast(i64)(cast(u64)cast(uintptr)(ptr) | ((cast(u64)(x) >> GB__POOL_TAG_SHIFT) + 1) << GB__POOL_TAG_SHIFT))
+#define GB__POOL_TAG_FITS(ptr)    ((cast(u64)cast(uintptr)(ptr) >> GB__POOL_TAG_SHIFT) == 0)
 #endif
-}
 
+typedef struct gbPoolMagazine {
+	gbConcurrentPool *pool;
+	u32               pool_id;
+	isize             count;
+	void *            blocks;
+} gbPoolMagazine;
 
-gb_inline void gb_semaphore_release(gbSemaphore *s) { gb_semaphore_post(s, 1); }
+gb_global gb_thread_local gbPoolMagazine gb__pool_magazines[GB_POOL_MAX_THREAD_MAGAZINES];
+gb_global gbAtomic32 gb__concurrent_pool_next_id;
 
-#if defined(GB_SYSTEM_WINDOWS)
-	gb_inline void gb_semaphore_init   (gbSemaphore *s)            { s->win32_handle = CreateSemaphoreA(NULL, 0, I32_MAX, NULL); }
-	gb_inline void gb_semaphore_destroy(gbSemaphore *s)            { CloseHandle(s->win32_handle); }
-	gb_inline void gb_semaphore_post   (gbSemaphore *s, i32 count) { ReleaseSemaphore(s->win32_handle, count, NULL); }
-	gb_inline void gb_semaphore_wait   (gbSemaphore *s)            { WaitForSingleObject(s->win32_handle, INFINITE); }
 
-#elif defined(GB_SYSTEM_OSX)
-	gb_inline void gb_semaphore_init   (gbSemaphore *s)            { semaphore_create(mach_task_self(), &s->osx_handle, SYNC_POLICY_FIFO, 0); }
-	gb_inline void gb_semaphore_destroy(gbSemaphore *s)            { semaphore_destroy(mach_task_self(), s->osx_handle); }
-	gb_inline void gb_semaphore_post   (gbSemaphore *s, i32 count) { while (count --> 0) semaphore_signal(s->osx_handle); }
-	gb_inline void gb_semaphore_wait   (gbSemaphore *s)            { semaphore_wait(s->osx_handle); }
+#if defined(GB_POOL_LOCKED_FREE_LIST)
+gb_internal i64 gb__concurrent_pool_lock(gbConcurrentPool *pool) {
+	for (;;) {
+		i64 head = gb_atomic64_load(&pool->free_list);
+		if ((head & 1) == 0 && gb_atomic64_compare_exchange(&pool->free_list, head, head | 1) == head)
+			return head;
+		gb_yield_thread();
+	}
+}
 
-#elif defined(GB_SYSTEM_UNIX)
-	gb_inline void gb_semaphore_init   (gbSemaphore *s)            { sem_init(&s->unix_handle, 0, 0); }
-	gb_inline void gb_semaphore_destroy(gbSemaphore *s)            { sem_destroy(&s->unix_handle); }
-	gb_inline void gb_semaphore_post   (gbSemaphore *s, i32 count) { while (count --> 0) sem_post(&s->unix_handle); }
-	gb_inline void gb_semaphore_wait   (gbSemaphore *s)            { int i; do { i = sem_wait(&s->unix_handle); } while (i == -1 && errno == EINTR); }
+gb_internal void *gb__concurrent_pool_pop(gbConcurrentPool *pool) {
+	i64 head;
+	void *block;
+	if (GB__POOL_TAG_PTR(gb_atomic64_load(&pool->free_list)) == NULL)
+		return NULL;
+	head = gb__concurrent_pool_lock(pool);
+	block = cast(void *)cast(uintptr)head;
+	gb_atomic64_exchanged(&pool->free_list, block ? cast(i64)cast(uintptr)*cast(void **)block : 0); // NOTE(bill): Unlocks, with a barrier
+	return block;
+}
 
+gb_internal void gb__concurrent_pool_push_chain(gbConcurrentPool *pool, void *first, void *last) {
+	i64 head = gb__concurrent_pool_lock(pool);
+	*cast(void **)last = cast(void *)cast(uintptr)head;
+	gb_atomic64_exchanged(&pool->free_list, cast(i64)cast(uintptr)first);
+}
 #else
-#error
+gb_internal void *gb__concurrent_pool_pop(gbConcurrentPool *pool) {
+	i64 head = gb_atomic64_load(&pool->free_list);
+	for (;;) {
+		void *block = GB__POOL_TAG_PTR(head);
+		void *next;
+		i64 prev;
+		if (block == NULL)
+			return NULL;
+		// NOTE(bill): The block may have been taken by another thread already but slabs are never
+		// released while the pool is alive, so this read is harmless and the tag makes the exchange fail
+		next = *cast(void *volatile *)block;
+		prev = gb_atomic64_compare_exchange(&pool->free_list, head, GB__POOL_TAG_MAKE(next, head));
+		if (prev == head)
+			return block;
+		head = prev;
+	}
+}
+
+gb_internal void gb__concurrent_pool_push_chain(gbConcurrentPool *pool, void *first, void *last) {
+	i64 head = gb_atomic64_load(&pool->free_list);
+	GB_ASSERT_MSG(GB__POOL_TAG_FITS(first), "Pointer uses the tag bits, define GB_POOL_LOCKED_FREE_LIST");
+	for (;;) {
+		i64 prev;
+		*cast(void *volatile *)last = GB__POOL_TAG_PTR(head);
+		prev = gb_atomic64_compare_exchange(&pool->free_list, head, GB__POOL_TAG_MAKE(first, head));
+		if (prev == head)
+			return;
+		head = prev;
+	}
+}
 #endif
 
-gb_inline void gb_mutex_init(gbMutex *m) {
-#if defined(GB_SYSTEM_WINDOWS)
-	InitializeCriticalSection(&m->win32_critical_section);
-#else
-	pthread_mutexattr_init(&m->pthread_mutexattr);
-	pthread_mutexattr_settype(&m->pthread_mutexattr, PTHREAD_MUTEX_RECURSIVE);
-	pthread_mutex_init(&m->pthread_mutex, &m->pthread_mutexattr);
+// NOTE(bill): Moves the blocks of the underlying gbPool onto the shared list, must hold the mutex
+gb_internal void gb__concurrent_pool_publish(gbConcurrentPool *pool) {
+	void *first = pool->pool.free_list;
+	void *last = first;
+	if (first == NULL)
+		return;
+	while (*cast(void **)last) {
+#if !defined(GB_POOL_LOCKED_FREE_LIST)
+		GB_ASSERT_MSG(GB__POOL_TAG_FITS(last), "Pointer uses the tag bits, define GB_POOL_LOCKED_FREE_LIST");
 #endif
+		last = *cast(void **)last;
+	}
+	pool->pool.free_list = NULL;
+	gb__concurrent_pool_push_chain(pool, first, last);
+}
+
+gb_internal void *gb__concurrent_pool_pop_or_grow(gbConcurrentPool *pool) {
+	void *block = gb__concurrent_pool_pop(pool);
+	while (block == NULL) {
+		gb_mutex_lock(&pool->mutex);
+		// NOTE(bill): Another thread may have grown the pool whilst waiting
+		if (GB__POOL_TAG_PTR(gb_atomic64_load(&pool->free_list)) == NULL) {
+			if (!gb_pool_grow(&pool->pool)) {
+				gb_mutex_unlock(&pool->mutex);
+				return NULL;
+			}
+			gb__concurrent_pool_publish(pool);
+		}
+		gb_mutex_unlock(&pool->mutex);
+		block = gb__concurrent_pool_pop(pool);
+	}
+	return block;
 }
 
-gb_inline void gb_mutex_destroy(gbMutex *m) {
-#if defined(GB_SYSTEM_WINDOWS)
-	DeleteCriticalSection(&m->win32_critical_section);
-#else
-	pthread_mutex_destroy(&m->pthread_mutex);
-#endif
+gb_internal gbPoolMagazine *gb__concurrent_pool_magazine(gbConcurrentPool *pool) {
+	gbPoolMagazine *empty = NULL;
+	isize i;
+	for (i = 0; i < GB_POOL_MAX_THREAD_MAGAZINES; i++) {
+		gbPoolMagazine *m = &gb__pool_magazines[i];
+		if (m->pool == pool) {
+			if (m->pool_id == pool->id)
+				return m;
+			// NOTE(bill): Stale magazine of a freed pool that lived at the same address
+			m->pool = NULL;
+		}
+		if (m->pool == NULL && empty == NULL)
+			empty = m;
+	}
+	if (empty) {
+		empty->pool    = pool;
+		empty->pool_id = pool->id;
+		empty->count   = 0;
+		empty->blocks  = NULL;
+	}
+	return empty;
 }
 
-gb_inline void gb_mutex_lock(gbMutex *m) {
-#if defined(GB_SYSTEM_WINDOWS)
-	EnterCriticalSection(&m->win32_critical_section);
-#else
-	pthread_mutex_lock(&m->pthread_mutex);
-#endif
+
+gb_inline void gb_concurrent_pool_init(gbConcurrentPool *pool, gbAllocator backing, isize num_blocks, isize block_size) {
+	gb_concurrent_pool_init_align(pool, backing, num_blocks, block_size, GB_DEFAULT_MEMORY_ALIGNMENT);
 }
 
-gb_inline b32 gb_mutex_try_lock(gbMutex *m) {
-#if defined(GB_SYSTEM_WINDOWS)
-	return TryEnterCriticalSection(&m->win32_critical_section) != 0;
-#else
-	return pthread_mutex_trylock(&m->pthread_mutex) == 0;
-#endif
+void gb_concurrent_pool_init_align(gbConcurrentPool *pool, gbAllocator backing, isize num_blocks, isize block_size, isize block_align) {
+	gb_zero_item(pool);
+	gb_mutex_init(&pool->mutex);
+	pool->id = cast(u32)gb_atomic32_fetch_add(&gb__concurrent_pool_next_id, 1) + 1;
+
+	gb_pool_init_align(&pool->pool, backing, num_blocks, block_size, block_align);
+	gb__concurrent_pool_publish(pool);
 }
 
-gb_inline void gb_mutex_unlock(gbMutex *m) {
-#if defined(GB_SYSTEM_WINDOWS)
-	LeaveCriticalSection(&m->win32_critical_section);
-#else
-	pthread_mutex_unlock(&m->pthread_mutex);
-#endif
+void gb_concurrent_pool_free(gbConcurrentPool *pool) {
+	gbPoolMagazine *m = NULL;
+	isize i;
+	for (i = 0; i < GB_POOL_MAX_THREAD_MAGAZINES; i++) {
+		if (gb__pool_magazines[i].pool == pool)
+			m = &gb__pool_magazines[i];
+	}
+	if (m) m->pool = NULL;
+
+	gb_pool_free(&pool->pool);
+	gb_mutex_destroy(&pool->mutex);
+	gb_atomic64_store(&pool->free_list, 0);
 }
 
+void gb_concurrent_pool_flush_thread(gbConcurrentPool *pool) {
+	isize i;
+	for (i = 0; i < GB_POOL_MAX_THREAD_MAGAZINES; i++) {
+		gbPoolMagazine *m = &gb__pool_magazines[i];
+		if (m->pool == pool) {
+			if (m->pool_id == pool->id && m->blocks) {
+				void *last = m->blocks;
+				while (*cast(void **)last)
+					last = *cast(void **)last;
+				gb__concurrent_pool_push_chain(pool, m->blocks, last);
+			}
+			m->pool   = NULL;
+			m->count  = 0;
+			m->blocks = NULL;
+		}
+	}
+}
 
 
+gb_inline gbAllocator gb_concurrent_pool_allocator(gbConcurrentPool *pool) {
+	gbAllocator allocator;
+	allocator.proc = gb_concurrent_pool_allocator_proc;
+	allocator.data = pool;
+	return allocator;
+}
 
+GB_ALLOCATOR_PROC(gb_concurrent_pool_allocator_proc) {
+	gbConcurrentPool *pool = cast(gbConcurrentPool *)allocator_data;
+	gbPoolMagazine *m;
+	void *ptr = NULL;
 
+	gb_unused(old_size);
 
+	switch (type) {
+	case gbAllocation_Alloc: {
+		GB_ASSERT(size      == pool->pool.block_size);
+		GB_ASSERT(alignment == pool->pool.block_align);
 
-void gb_thread_init(gbThread *t) {
-	gb_zero_item(t);
-#if defined(GB_SYSTEM_WINDOWS)
-	t->win32_handle = INVALID_HANDLE_VALUE;
-#else
-	t->posix_handle = 0;
-#endif
-	gb_semaphore_init(&t->semaphore);
-}
+		m = gb__concurrent_pool_magazine(pool);
+		if (m == NULL) {
+			ptr = gb__concurrent_pool_pop_or_grow(pool);
+		} else {
+			if (m->count == 0) {
+				// NOTE(bill): Refill half of the magazine from the shared list
+				void *block = gb__concurrent_pool_pop_or_grow(pool);
+				while (block) {
+					*cast(void **)block = m->blocks;
+					m->blocks = block;
+					if (++m->count >= GB_POOL_MAGAZINE_SIZE/2)
+						break;
+					block = gb__concurrent_pool_pop(pool);
+				}
+			}
+			if (m->count > 0) {
+				ptr = m->blocks;
+				m->blocks = *cast(void **)ptr;
+				m->count--;
+			}
+		}
 
-void gb_thread_destroy(gbThread *t) {
-	if (t->is_running) gb_thread_join(t);
-	gb_semaphore_destroy(&t->semaphore);
+		if (ptr == NULL) {
+			gb_printf_err("Pool out of memory\n");
+			return NULL;
+		}
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
+
+	case gbAllocation_Free: {
+		if (old_memory == NULL) return NULL;
+
+		m = gb__concurrent_pool_magazine(pool);
+		if (m == NULL) {
+			gb__concurrent_pool_push_chain(pool, old_memory, old_memory);
+		} else {
+			*cast(void **)old_memory = m->blocks;
+			m->blocks = old_memory;
+			if (++m->count > GB_POOL_MAGAZINE_SIZE) {
+				// NOTE(bill): Give half of the magazine back in a single exchange
+				void *first = m->blocks, *last = first;
+				isize i;
+				for (i = 1; i < GB_POOL_MAGAZINE_SIZE/2; i++)
+					last = *cast(void **)last;
+				m->blocks = *cast(void **)last;
+				m->count -= GB_POOL_MAGAZINE_SIZE/2;
+				gb__concurrent_pool_push_chain(pool, first, last);
+			}
+		}
+	} break;
+
+	case gbAllocation_FreeAll:
+		// NOTE(bill): Cannot free all as other threads may hold blocks in their magazines
+		GB_PANIC("You cannot free all of a concurrent pool, use gb_concurrent_pool_free");
+		break;
+
+	case gbAllocation_Resize:
+		// NOTE(bill): Cannot resize
+		GB_PANIC("You cannot resize something allocated by with a pool.");
+		break;
+	}
+
+	return ptr;
 }
 
 
-gb_inline void gb__thread_run(gbThread *t) {
-	gb_semaphore_release(&t->semaphore);
-	t->return_value = t->proc(t);
+
+//
+// Slab Allocator
+//
+
+gb_internal gb_inline isize gb__slab_set_slot(gbSlab *s, uintptr base) {
+	return cast(isize)(((base / GB_SLAB_PAGE_SIZE) * 0x9e3779b97f4a7c15ull) >> 20) & (s->slab_set_capacity-1);
 }
 
-#if defined(GB_SYSTEM_WINDOWS)
-	gb_inline DWORD __stdcall gb__thread_proc(void *arg) {
-		gbThread *t = cast(gbThread *)arg;
-		gb__thread_run(t);
-		t->is_running = false;
-		return 0;
-	}
-#else
-	gb_inline void *          gb__thread_proc(void *arg) {
-		gbThread *t = cast(gbThread *)arg;
-		gb__thread_run(t);
-		t->is_running = false;
-		return NULL;
+gb_internal b32 gb__slab_set_has(gbSlab *s, uintptr base) {
+	isize i;
+	if (s->slab_set_count == 0)
+		return false;
+	for (i = gb__slab_set_slot(s, base); s->slab_set[i]; i = (i+1) & (s->slab_set_capacity-1)) {
+		if (s->slab_set[i] == base)
+			return true;
 	}
-#endif
+	return false;
+}
 
-gb_inline void gb_thread_start(gbThread *t, gbThreadProc *proc, void *user_data) { gb_thread_start_with_stack(t, proc, user_data, 0); }
+gb_internal b32 gb__slab_set_add(gbSlab *s, uintptr base) {
+	isize i;
+	if ((s->slab_set_count+1)*4 > s->slab_set_capacity*3) {
+		uintptr *old_set = s->slab_set;
+		isize old_capacity = s->slab_set_capacity;
+		isize new_capacity = gb_max(old_capacity*2, 64);
+		uintptr *new_set = cast(uintptr *)gb_alloc(s->backing, new_capacity*gb_size_of(uintptr));
+		if (new_set == NULL)
+			return false;
+		gb_zero_size(new_set, new_capacity*gb_size_of(uintptr));
+		s->slab_set = new_set;
+		s->slab_set_capacity = new_capacity;
+		for (i = 0; i < old_capacity; i++) {
+			if (old_set[i]) {
+				isize j = gb__slab_set_slot(s, old_set[i]);
+				while (new_set[j]) j = (j+1) & (new_capacity-1);
+				new_set[j] = old_set[i];
+			}
+		}
+		if (old_set) gb_free(s->backing, old_set);
+	}
+	for (i = gb__slab_set_slot(s, base); s->slab_set[i]; i = (i+1) & (s->slab_set_capacity-1)) {}
+	s->slab_set[i] = base;
+	s->slab_set_count++;
+	return true;
+}
 
-gb_inline void gb_thread_start_with_stack(gbThread *t, gbThreadProc *proc, void *user_data, isize stack_size) {
-	GB_ASSERT(!t->is_running);
-	GB_ASSERT(proc != NULL);
-	t->proc = proc;
-	t->user_data = user_data;
-	t->stack_size = stack_size;
-	t->is_running = true;
+gb_internal void gb__slab_set_remove(gbSlab *s, uintptr base) {
+	isize mask = s->slab_set_capacity-1, i, j;
+	if (s->slab_set_count == 0)
+		return;
+	for (i = gb__slab_set_slot(s, base); s->slab_set[i] != base; i = (i+1) & mask) {
+		if (s->slab_set[i] == 0)
+			return;
+	}
+	// NOTE(bill): Shift back the entries after it which would not be found past the hole otherwise
+	for (j = (i+1) & mask; s->slab_set[j]; j = (j+1) & mask) {
+		isize k = gb__slab_set_slot(s, s->slab_set[j]);
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+			s->slab_set[i] = s->slab_set[j];
+			i = j;
+		}
+	}
+	s->slab_set[i] = 0;
+	s->slab_set_count--;
+}
 
-#if defined(GB_SYSTEM_WINDOWS)
-	t->win32_handle = CreateThread(NULL, stack_size, gb__thread_proc, t, 0, NULL);
-	GB_ASSERT_MSG(t->win32_handle != NULL, "CreateThread: GetLastError");
-#else
-	{
-		pthread_attr_t attr;
-		pthread_attr_init(&attr);
-		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-		if (stack_size != 0) {
-			pthread_attr_setstacksize(&attr, stack_size);
+// NOTE(bill): The backing of the size class pools, it records which GB_SLAB_PAGE_SIZE pages are slabs
+gb_internal GB_ALLOCATOR_PROC(gb__slab_page_allocator_proc) {
+	gbSlab *s = cast(gbSlab *)allocator_data;
+	void *ptr = NULL;
+	switch (type) {
+	case gbAllocation_Alloc:
+		ptr = gb_alloc_align(s->backing, size, alignment);
+		if (ptr && size == GB_SLAB_PAGE_SIZE && alignment == GB_SLAB_PAGE_SIZE && !gb__slab_set_add(s, cast(uintptr)ptr)) {
+			gb_free(s->backing, ptr);
+			ptr = NULL;
 		}
-		pthread_create(&t->posix_handle, &attr, gb__thread_proc, t);
-		pthread_attr_destroy(&attr);
+		break;
+	case gbAllocation_Free:
+		if (old_memory) {
+			gb__slab_set_remove(s, cast(uintptr)old_memory);
+			gb_free(s->backing, old_memory);
+		}
+		break;
+	default:
+		GB_PANIC("Slab pages can only be allocated and freed");
+		break;
 	}
-#endif
+	gb_unused(old_size); gb_unused(flags);
+	return ptr;
+}
 
-	gb_semaphore_wait(&t->semaphore);
+void gb_slab_init(gbSlab *s, gbAllocator backing) {
+	gbAllocator pages;
+	isize i;
+	gb_zero_item(s);
+	s->backing = backing;
+	pages.proc = gb__slab_page_allocator_proc;
+	pages.data = s;
+	for (i = 0; i < GB_SLAB_CLASS_COUNT; i++) {
+		isize class_size = GB_SLAB_MIN_CLASS_SIZE << i;
+		gb_pool_init_slabs(&s->pools[i], pages, GB_SLAB_PAGE_SIZE, class_size, class_size);
+	}
 }
 
-gb_inline void gb_thread_join(gbThread *t) {
-	if (!t->is_running) return;
+void gb_slab_free(gbSlab *s) {
+	isize i;
+	gb_slab_allocator_proc(s, gbAllocation_FreeAll, 0, 0, NULL, 0, 0);
+	for (i = 0; i < GB_SLAB_CLASS_COUNT; i++) {
+		gb_pool_free(&s->pools[i]);
+	}
+	if (s->slab_set) {
+		gb_free(s->backing, s->slab_set);
+		s->slab_set = NULL;
+		s->slab_set_count = s->slab_set_capacity = 0;
+	}
+}
 
-#if defined(GB_SYSTEM_WINDOWS)
-	WaitForSingleObject(t->win32_handle, INFINITE);
-	CloseHandle(t->win32_handle);
-	t->win32_handle = INVALID_HANDLE_VALUE;
-#else
-	pthread_join(t->posix_handle, NULL);
-	t->posix_handle = 0;
-#endif
-	t->is_running = false;
+isize gb_slab_trim(gbSlab *s) {
+	isize i, released = 0;
+	for (i = 0; i < GB_SLAB_CLASS_COUNT; i++) {
+		released += gb_pool_trim(&s->pools[i]);
+	}
+	return released;
+}
+
+gb_inline isize gb_slab_size_class(isize size, isize alignment) {
+	isize class_index = 0;
+	isize class_size = GB_SLAB_MIN_CLASS_SIZE;
+	size = gb_max(size, alignment);
+	if (size > GB_SLAB_MAX_CLASS_SIZE)
+		return -1;
+	while (class_size < size) {
+		class_size <<= 1;
+		class_index++;
+	}
+	return class_index;
 }
 
-gb_inline b32 gb_thread_is_running(gbThread const *t) { return t->is_running != 0; }
 
-gb_inline u32 gb_thread_current_id(void) {
-	u32 thread_id;
-#if defined(GB_SYSTEM_WINDOWS)
-	#if defined(GB_ARCH_32_BIT) && defined(GB_CPU_X86)
-		thread_id = (cast(u32 *)__readfsdword(24))[9];
-	#elif defined(GB_ARCH_64_BIT) && defined(GB_CPU_X86)
-		thread_id = (cast(u32 *)__readgsqword(48))[18];
-	#else
-		thread_id = GetCurrentThreadId();
-	#endif
+gb_inline gbAllocator gb_slab_allocator(gbSlab *s) {
+	gbAllocator allocator;
+	allocator.proc = gb_slab_allocator_proc;
+	allocator.data = s;
+	return allocator;
+}
 
-#elif defined(GB_SYSTEM_OSX) && defined(GB_ARCH_64_BIT)
-	thread_id = pthread_mach_thread_np(pthread_self());
-#elif defined(GB_ARCH_32_BIT) && defined(GB_CPU_X86)
-	__asm__("mov %%gs:0x08,%0" : "=r"(thread_id));
-#elif defined(GB_ARCH_64_BIT) && defined(GB_CPU_X86)
-	__asm__("mov %%fs:0x10,%0" : "=r"(thread_id));
-#else
-	#error Unsupported architecture for gb_thread_current_id()
-#endif
+GB_ALLOCATOR_PROC(gb_slab_allocator_proc) {
+	gbSlab *s = cast(gbSlab *)allocator_data;
+	void *ptr = NULL;
 
-	return thread_id;
-}
+	switch (type) {
+	case gbAllocation_Alloc: {
+		isize class_index = gb_slab_size_class(size, alignment);
+		if (class_index >= 0) {
+			gbPool *pool = &s->pools[class_index];
+			ptr = gb_pool_allocator_proc(pool, gbAllocation_Alloc, pool->block_size, pool->block_align, NULL, 0, flags);
+		} else {
+			gbSlabLargeHeader *header;
+			isize header_size;
+			void *allocation;
+
+			alignment = gb_max(alignment, gb_align_of(gbSlabLargeHeader));
+			header_size = (gb_size_of(gbSlabLargeHeader) + alignment-1) & ~(alignment-1);
+			allocation = gb_alloc_align(s->backing, header_size + size, alignment);
+			if (allocation == NULL)
+				return NULL;
 
+			ptr = gb_pointer_add(allocation, header_size);
+			header = cast(gbSlabLargeHeader *)ptr - 1;
+			header->next       = s->large_allocations;
+			header->prev       = NULL;
+			header->allocation = allocation;
+			header->size       = size;
+			if (s->large_allocations)
+				s->large_allocations->prev = header;
+			s->large_allocations = header;
 
+			if (flags & gbAllocatorFlag_ClearToZero)
+				gb_zero_size(ptr, size);
+		}
+	} break;
 
-void gb_thread_set_name(gbThread *t, char const *name) {
-#if defined(GB_COMPILER_MSVC)
-	#pragma pack(push, 8)
-		typedef struct {
-			DWORD       type;
-			char const *name;
-			DWORD       id;
-			DWORD       flags;
-		} gbprivThreadName;
-	#pragma pack(pop)
-		gbprivThreadName tn;
-		tn.type  = 0x1000;
-		tn.name  = name;
-		tn.id    = GetThreadId(cast(HANDLE)t->win32_handle);
-		tn.flags = 0;
+	case gbAllocation_Free: {
+		gbPoolSlab *slab;
+		if (old_memory == NULL) return NULL;
 
-		__try {
-			RaiseException(0x406d1388, 0, gb_size_of(tn)/4, cast(ULONG_PTR *)&tn);
-		} __except(1 /*EXCEPTION_EXECUTE_HANDLER*/) {
+		slab = gb_pool_slab_of(old_memory, GB_SLAB_PAGE_SIZE);
+		if (gb__slab_set_has(s, cast(uintptr)slab)) {
+			gb_pool_allocator_proc(slab->pool, gbAllocation_Free, 0, 0, old_memory, 0, flags);
+		} else {
+			gbSlabLargeHeader *header = cast(gbSlabLargeHeader *)old_memory - 1;
+			if (header->prev) header->prev->next = header->next;
+			else              s->large_allocations = header->next;
+			if (header->next) header->next->prev = header->prev;
+			gb_free(s->backing, header->allocation);
 		}
+	} break;
 
-#elif defined(GB_SYSTEM_WINDOWS) && !defined(GB_COMPILER_MSVC)
-	// IMPORTANT TODO(bill): Set thread name for GCC/Clang on windows
-	return;
-#elif defined(GB_SYSTEM_OSX)
-	// TODO(bill): Test if this works
-	pthread_setname_np(name);
-#else
-	// TODO(bill): Test if this works
-	pthread_setname_np(t->posix_handle, name);
-#endif
+	case gbAllocation_FreeAll: {
+		isize i;
+		gbSlabLargeHeader *header = s->large_allocations;
+		while (header) {
+			gbSlabLargeHeader *next = header->next;
+			gb_free(s->backing, header->allocation);
+			header = next;
+		}
+		s->large_allocations = NULL;
+		for (i = 0; i < GB_SLAB_CLASS_COUNT; i++) {
+			gb_pool_allocator_proc(&s->pools[i], gbAllocation_FreeAll, 0, 0, NULL, 0, flags);
+		}
+	} break;
+
+	case gbAllocation_Resize: {
+		gbPoolSlab *slab;
+		isize capacity;
+		if (old_memory == NULL) {
+			return gb_slab_allocator_proc(s, gbAllocation_Alloc, size, alignment, NULL, 0, flags);
+		}
+		if (size == 0) {
+			gb_slab_allocator_proc(s, gbAllocation_Free, 0, 0, old_memory, old_size, flags);
+			return NULL;
+		}
+
+		slab = gb_pool_slab_of(old_memory, GB_SLAB_PAGE_SIZE);
+		if (gb__slab_set_has(s, cast(uintptr)slab)) {
+			capacity = slab->pool->block_size;
+			// NOTE(bill): Resizing within the same size class is a no-op
+			if (gb_slab_size_class(size, alignment) == gb_slab_size_class(capacity, 1))
+				return old_memory;
+		} else {
+			capacity = (cast(gbSlabLargeHeader *)old_memory - 1)->size;
+			if (size <= capacity && size > GB_SLAB_MAX_CLASS_SIZE &&
+			    (cast(uintptr)old_memory & cast(uintptr)(alignment-1)) == 0) {
+				return old_memory;
+			}
+		}
+
+		ptr = gb_slab_allocator_proc(s, gbAllocation_Alloc, size, alignment, NULL, 0, flags);
+		if (ptr == NULL)
+			return NULL;
+		gb_memcopy(ptr, old_memory, gb_min(size, capacity));
+		gb_slab_allocator_proc(s, gbAllocation_Free, 0, 0, old_memory, old_size, flags);
+	} break;
+	}
+
+	return ptr;
 }
 
 
 
+gb_inline gbAllocationHeader *gb_allocation_header(void *data) {
+	isize *p = cast(isize *)data;
+	while (p[-1] == cast(isize)(-1)) {
+		p--;
+	}
+	return cast(gbAllocationHeader *)p - 1;
+}
 
-void gb_sync_init(gbSync *s) {
-	gb_zero_item(s);
-	gb_mutex_init(&s->mutex);
-	gb_mutex_init(&s->start);
-	gb_semaphore_init(&s->release);
+gb_inline void gb_allocation_header_fill(gbAllocationHeader *header, void *data, isize size) {
+	isize *ptr;
+	header->size = size;
+	ptr = cast(isize *)(header + 1);
+	while (cast(void *)ptr < data) {
+		*ptr++ = cast(isize)(-1);
+	}
 }
 
-void gb_sync_destroy(gbSync *s) {
-	if (s->waiting)
-		GB_PANIC("Cannot destroy while threads are waiting!");
 
-	gb_mutex_destroy(&s->mutex);
-	gb_mutex_destroy(&s->start);
-	gb_semaphore_destroy(&s->release);
+
+//
+// Free List Allocator
+//
+
+#define GB__FREE_LIST_ALIGN       16 // NOTE(bill): 1 << (GB_FREE_LIST_FL_SHIFT - GB_FREE_LIST_SL_LOG2)
+#define GB__FREE_LIST_HEADER_SIZE gb_offset_of(gbFreeListBlock, next_free)
+#define GB__FREE_LIST_MIN_BLOCK   ((gb_size_of(gbFreeListBlock) + GB__FREE_LIST_ALIGN-1) & ~(GB__FREE_LIST_ALIGN-1))
+#define GB__FREE_LIST_FREE_BIT    cast(uintptr)1
+
+gb_inline gbFreeListBlock *gb__free_list_prev_physical(gbFreeListBlock *b) { return cast(gbFreeListBlock *)(cast(uintptr)b->prev_physical & ~GB__FREE_LIST_FREE_BIT); }
+gb_inline gbFreeListBlock *gb__free_list_next_physical(gbFreeListBlock *b) { return cast(gbFreeListBlock *)gb_pointer_add(b, b->size); }
+gb_inline b32              gb__free_list_is_free      (gbFreeListBlock *b) { return (cast(uintptr)b->prev_physical & GB__FREE_LIST_FREE_BIT) != 0; }
+
+gb_inline void gb__free_list_set_free(gbFreeListBlock *b, b32 is_free) {
+	uintptr p = cast(uintptr)gb__free_list_prev_physical(b);
+	b->prev_physical = cast(gbFreeListBlock *)(is_free ? p | GB__FREE_LIST_FREE_BIT : p);
 }
 
-void gb_sync_set_target(gbSync *s, i32 count) {
-	gb_mutex_lock(&s->start);
+gb_inline void gb__free_list_set_prev_physical(gbFreeListBlock *b, gbFreeListBlock *prev) {
+	b->prev_physical = cast(gbFreeListBlock *)(cast(uintptr)prev | (cast(uintptr)b->prev_physical & GB__FREE_LIST_FREE_BIT));
+}
 
-	gb_mutex_lock(&s->mutex);
-	GB_ASSERT(s->target == 0);
-	s->target = count;
-	s->current = 0;
-	s->waiting = 0;
-	gb_mutex_unlock(&s->mutex);
+gb_internal void gb__free_list_mapping(isize size, isize *fl_out, isize *sl_out) {
+	if (size < (cast(isize)1 << GB_FREE_LIST_FL_SHIFT)) {
+		*fl_out = 0;
+		*sl_out = size / GB__FREE_LIST_ALIGN;
+	} else {
+		isize f = gb__bit_scan_reverse(cast(u64)size);
+		*sl_out = (size >> (f - GB_FREE_LIST_SL_LOG2)) ^ GB_FREE_LIST_SL_COUNT;
+		*fl_out = f - (GB_FREE_LIST_FL_SHIFT - 1);
+	}
 }
 
-void gb_sync_release(gbSync *s) {
-	if (s->waiting) {
-		gb_semaphore_release(&s->release);
+gb_internal void gb__free_list_insert(gbFreeList *fl, gbFreeListBlock *b) {
+	isize f, s;
+	gbFreeListBlock *head;
+	gb__free_list_mapping(b->size, &f, &s);
+	head = fl->free_blocks[f][s];
+	b->next_free = head;
+	b->prev_free = NULL;
+	if (head) head->prev_free = b;
+	fl->free_blocks[f][s] = b;
+	fl->fl_bitmap    |= cast(u64)1 << f;
+	fl->sl_bitmap[f] |= cast(u32)1 << s;
+}
+
+gb_internal void gb__free_list_remove(gbFreeList *fl, gbFreeListBlock *b) {
+	isize f, s;
+	gb__free_list_mapping(b->size, &f, &s);
+	if (b->next_free) b->next_free->prev_free = b->prev_free;
+	if (b->prev_free) {
+		b->prev_free->next_free = b->next_free;
 	} else {
-		s->target = 0;
-		gb_mutex_unlock(&s->start);
+		fl->free_blocks[f][s] = b->next_free;
+		if (b->next_free == NULL) {
+			fl->sl_bitmap[f] &= ~(cast(u32)1 << s);
+			if (fl->sl_bitmap[f] == 0)
+				fl->fl_bitmap &= ~(cast(u64)1 << f);
+		}
 	}
 }
 
-i32 gb_sync_reach(gbSync *s) {
-	i32 n;
-	gb_mutex_lock(&s->mutex);
-	GB_ASSERT(s->current < s->target);
-	n = ++s->current; // NOTE(bill): Record this value to avoid possible race if `return s->current` was done
-	if (s->current == s->target)
-		gb_sync_release(s);
-	gb_mutex_unlock(&s->mutex);
-	return n;
+// NOTE(bill): Finds a free block of at least `size` bytes, rounding up to the next size class means any block in it fits
+#define GB__FREE_LIST_FIT_TRIES 4
+
+gb_internal gbFreeListBlock *gb__free_list_find(gbFreeList *fl, isize size) {
+	isize f, s, rounded = size;
+	u32 sl_map;
+	if (size >= (cast(isize)1 << GB_FREE_LIST_FL_SHIFT))
+		rounded += (cast(isize)1 << (gb__bit_scan_reverse(cast(u64)size) - GB_FREE_LIST_SL_LOG2)) - 1;
+	gb__free_list_mapping(rounded, &f, &s);
+	if (f < GB_FREE_LIST_FL_COUNT) {
+		sl_map = fl->sl_bitmap[f] & (~cast(u32)0 << s);
+		if (sl_map == 0) {
+			u64 fl_map = f+1 < 64 ? fl->fl_bitmap & (~cast(u64)0 << (f+1)) : 0;
+			if (fl_map != 0) {
+				f = gb__bit_scan_forward(fl_map);
+				sl_map = fl->sl_bitmap[f];
+			}
+		}
+		if (sl_map != 0) {
+			s = gb__bit_scan_forward(sl_map);
+			return fl->free_blocks[f][s];
+		}
+	}
+
+	// NOTE(bill): Nothing in the larger classes, the class of `size` itself may still have a block that fits.
+	// Only the first few are looked at so this stays O(1).
+	if (rounded != size) {
+		gbFreeListBlock *b;
+		isize tries = 0;
+		gb__free_list_mapping(size, &f, &s);
+		for (b = fl->free_blocks[f][s]; b != NULL && tries < GB__FREE_LIST_FIT_TRIES; b = b->next_free, tries++) {
+			if (b->size >= size)
+				return b;
+		}
+	}
+	return NULL;
 }
 
-void gb_sync_reach_and_wait(gbSync *s) {
-	gb_mutex_lock(&s->mutex);
-	GB_ASSERT(s->current < s->target);
-	s->current++;
-	if (s->current == s->target) {
-		gb_sync_release(s);
-		gb_mutex_unlock(&s->mutex);
-	} else {
-		s->waiting++;                   // NOTE(bill): Waiting, so one more waiter
-		gb_mutex_unlock(&s->mutex);     // NOTE(bill): Release the mutex to other threads
+// NOTE(bill): Cuts a used block down to `size` and frees the rest (merging it with the next block if free)
+gb_internal void gb__free_list_split(gbFreeList *fl, gbFreeListBlock *b, isize size) {
+	gbFreeListBlock *rest, *next;
+	if (b->size - size < GB__FREE_LIST_MIN_BLOCK)
+		return;
 
-		gb_semaphore_wait(&s->release); // NOTE(bill): Wait for merge completion
+	rest = cast(gbFreeListBlock *)gb_pointer_add(b, size);
+	rest->size = b->size - size;
+	rest->prev_physical = b;
+	b->size = size;
 
-		gb_mutex_lock(&s->mutex);       // NOTE(bill): On merge completion, lock mutex
-		s->waiting--;                   // NOTE(bill): Done waiting
-		gb_sync_release(s);             // NOTE(bill): Restart the next waiter
-		gb_mutex_unlock(&s->mutex);
+	next = gb__free_list_next_physical(rest);
+	if (gb__free_list_is_free(next)) {
+		gb__free_list_remove(fl, next);
+		rest->size += next->size;
+		next = gb__free_list_next_physical(rest);
 	}
+	gb__free_list_set_free(rest, true);
+	gb__free_list_set_prev_physical(next, rest);
+	gb__free_list_insert(fl, rest);
 }
 
+gb_inline isize gb__free_list_block_size(isize size, isize alignment) {
+	isize extra = alignment > GB__FREE_LIST_HEADER_SIZE ? alignment - GB__FREE_LIST_HEADER_SIZE : 0;
+	isize block_size = (GB__FREE_LIST_HEADER_SIZE + size + extra + GB__FREE_LIST_ALIGN-1) & ~(GB__FREE_LIST_ALIGN-1);
+	return gb_max(block_size, GB__FREE_LIST_MIN_BLOCK);
+}
 
+gb_inline gbFreeListBlock *gb__free_list_block_of(void *ptr) {
+	return cast(gbFreeListBlock *)gb_pointer_sub(gb_allocation_header(ptr), gb_offset_of(gbFreeListBlock, size));
+}
 
 
+void gb_free_list_init(gbFreeList *fl, void *start, isize size) {
+	gbFreeListBlock *block, *sentinel;
+	u8 *begin, *end;
 
+	gb_zero_item(fl);
+	fl->physical_start = start;
+	fl->total_size     = size;
 
+	begin = cast(u8 *)gb_align_forward(start, GB__FREE_LIST_ALIGN);
+	end   = cast(u8 *)(cast(uintptr)gb_pointer_add(start, size) & ~cast(uintptr)(GB__FREE_LIST_ALIGN-1));
+	GB_ASSERT(end - begin >= GB__FREE_LIST_MIN_BLOCK + GB__FREE_LIST_ALIGN);
+	GB_ASSERT((end - begin) >> GB_FREE_LIST_FL_MAX == 0);
 
+	// NOTE(bill): A used zero sized block at the end stops merging past the end
+	sentinel = cast(gbFreeListBlock *)(end - GB__FREE_LIST_ALIGN);
+	block = cast(gbFreeListBlock *)begin;
 
-gb_inline gbAllocator gb_heap_allocator(void) {
+	block->prev_physical = NULL;
+	block->size = cast(u8 *)sentinel - begin;
+	gb__free_list_set_free(block, true);
+
+	sentinel->prev_physical = block;
+	sentinel->size = 0;
+
+	gb__free_list_insert(fl, block);
+}
+
+
+gb_inline void gb_free_list_init_from_allocator(gbFreeList *fl, gbAllocator backing, isize size) {
+	void *start = gb_alloc(backing, size);
+	gb_free_list_init(fl, start, size);
+}
+
+
+
+gb_inline gbAllocator gb_free_list_allocator(gbFreeList *fl) {
 	gbAllocator a;
-	a.proc = gb_heap_allocator_proc;
-	a.data = NULL;
+	a.proc = gb_free_list_allocator_proc;
+	a.data = fl;
 	return a;
 }
 
-GB_ALLOCATOR_PROC(gb_heap_allocator_proc) {
+GB_ALLOCATOR_PROC(gb_free_list_allocator_proc) {
+	gbFreeList *fl = cast(gbFreeList *)allocator_data;
 	void *ptr = NULL;
-	gb_unused(allocator_data);
-	gb_unused(old_size);
-// TODO(bill): Throughly test!
-	switch (type) {
-#if defined(GB_COMPILER_MSVC)
-	case gbAllocation_Alloc:
-		ptr = _aligned_malloc(size, alignment);
-		if (flags & gbAllocatorFlag_ClearToZero)
-			gb_zero_size(ptr, size);
-		break;
-	case gbAllocation_Free:
-		_aligned_free(old_memory);
-		break;
-	case gbAllocation_Resize:
-		ptr = _aligned_realloc(old_memory, size, alignment);
-		break;
 
-#elif defined(GB_SYSTEM_LINUX)
-	// TODO(bill): *nix version that's decent
+	GB_ASSERT_NOT_NULL(fl);
+
+	switch (type) {
 	case gbAllocation_Alloc: {
-		ptr = aligned_alloc(alignment, size);
-		// ptr = malloc(size+alignment);
+		isize block_size = gb__free_list_block_size(size, alignment);
+		gbFreeListBlock *block = gb__free_list_find(fl, block_size);
+		isize *pad;
 
-		if (flags & gbAllocatorFlag_ClearToZero) {
+		// NOTE(bill): if block == NULL, ran out of free list memory! FUCK!
+		if (block == NULL)
+			return NULL;
+
+		gb__free_list_remove(fl, block);
+		gb__free_list_set_free(block, false);
+		gb__free_list_split(fl, block, block_size);
+
+		ptr = gb_align_forward(gb_pointer_add(block, GB__FREE_LIST_HEADER_SIZE), alignment);
+		for (pad = cast(isize *)gb_pointer_add(block, GB__FREE_LIST_HEADER_SIZE); cast(void *)pad < ptr; pad++)
+			*pad = cast(isize)(-1);
+
+		fl->total_allocated += block->size;
+		fl->allocation_count++;
+
+		if (flags & gbAllocatorFlag_ClearToZero)
 			gb_zero_size(ptr, size);
-		}
 	} break;
 
 	case gbAllocation_Free: {
-		free(old_memory);
-	} break;
+		gbFreeListBlock *block, *prev, *next;
+		if (old_memory == NULL) return NULL;
 
-	case gbAllocation_Resize: {
-		// ptr = realloc(old_memory, size);
-		ptr = gb_default_resize_align(gb_heap_allocator(), old_memory, old_size, size, alignment);
-	} break;
-#else
-	// TODO(bill): *nix version that's decent
-	case gbAllocation_Alloc: {
-		posix_memalign(&ptr, alignment, size);
+		block = gb__free_list_block_of(old_memory);
+		GB_ASSERT_MSG(!gb__free_list_is_free(block), "Double free of %p", old_memory);
+
+		fl->allocation_count--;
+		fl->total_allocated -= block->size;
 
-		if (flags & gbAllocatorFlag_ClearToZero) {
-			gb_zero_size(ptr, size);
+		prev = gb__free_list_prev_physical(block);
+		if (prev && gb__free_list_is_free(prev)) {
+			gb__free_list_remove(fl, prev);
+			prev->size += block->size;
+			block = prev;
+		}
+		next = gb__free_list_next_physical(block);
+		if (gb__free_list_is_free(next)) {
+			gb__free_list_remove(fl, next);
+			block->size += next->size;
+			next = gb__free_list_next_physical(block);
 		}
-	} break;
-
-	case gbAllocation_Free: {
-		free(old_memory);
-	} break;
 
-	case gbAllocation_Resize: {
-		ptr = gb_default_resize_align(gb_heap_allocator(), old_memory, old_size, size, alignment);
+		gb__free_list_set_free(block, true);
+		gb__free_list_set_prev_physical(next, block);
+		gb__free_list_insert(fl, block);
 	} break;
-#endif
 
 	case gbAllocation_FreeAll:
+		gb_free_list_init(fl, fl->physical_start, fl->total_size);
 		break;
+
+	case gbAllocation_Resize: {
+		// NOTE(bill): Grow into the next block if it is free or shrink in place
+		if (old_memory != NULL && size > 0 &&
+		    (cast(uintptr)old_memory & cast(uintptr)(alignment-1)) == 0) {
+			gbFreeListBlock *block = gb__free_list_block_of(old_memory);
+			gbFreeListBlock *next = gb__free_list_next_physical(block);
+			isize offset = gb_pointer_diff(block, old_memory);
+			isize block_size = (offset + size + GB__FREE_LIST_ALIGN-1) & ~(GB__FREE_LIST_ALIGN-1);
+			block_size = gb_max(block_size, GB__FREE_LIST_MIN_BLOCK);
+
+			if (block_size > block->size && gb__free_list_is_free(next) && block->size + next->size >= block_size) {
+				gb__free_list_remove(fl, next);
+				fl->total_allocated -= block->size;
+				block->size += next->size;
+				gb__free_list_set_prev_physical(gb__free_list_next_physical(block), block);
+				fl->total_allocated += block->size;
+			}
+			if (block_size <= block->size) {
+				fl->total_allocated -= block->size;
+				gb__free_list_split(fl, block, block_size);
+				fl->total_allocated += block->size;
+				return old_memory;
+			}
+		}
+		ptr = gb_default_resize_align(gb_free_list_allocator(fl), old_memory, old_size, size, alignment);
+	} break;
 	}
 
 	return ptr;
 }
 
 
-#if defined(GB_SYSTEM_WINDOWS)
-void gb_affinity_init(gbAffinity *a) {
-	SYSTEM_LOGICAL_PROCESSOR_INFORMATION *start_processor_info = NULL;
-	DWORD length = 0;
-	b32 result  = GetLogicalProcessorInformation(NULL, &length);
-
-	gb_zero_item(a);
 
-	if (!result && GetLastError() == 122l /*ERROR_INSUFFICIENT_BUFFER*/ && length > 0) {
-		start_processor_info = cast(SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)gb_alloc(gb_heap_allocator(), length);
-		result = GetLogicalProcessorInformation(start_processor_info, &length);
-		if (result) {
-			SYSTEM_LOGICAL_PROCESSOR_INFORMATION *end_processor_info, *processor_info;
+//
+// Buddy Allocator
+//
 
-			a->is_accurate  = true;
-			a->core_count   = 0;
-			a->thread_count = 0;
-			end_processor_info = cast(SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)gb_pointer_add(start_processor_info, length);
+gb_inline isize gb__buddy_next_pow2(isize x) {
+	if (x <= 1) return 1;
+	return cast(isize)1 << (gb__bit_scan_reverse(cast(u64)(x-1)) + 1);
+}
 
-			for (processor_info = start_processor_info;
-			     processor_info < end_processor_info;
-			     processor_info++) {
-				if (processor_info->Relationship == RelationProcessorCore) {
-					isize thread = gb_count_set_bits(processor_info->ProcessorMask);
-					if (thread == 0) {
-						a->is_accurate = false;
-					} else if (a->thread_count + thread > GB_WIN32_MAX_THREADS) {
-						a->is_accurate = false;
-					} else {
-						GB_ASSERT(a->core_count <= a->thread_count &&
-						          a->thread_count < GB_WIN32_MAX_THREADS);
-						a->core_masks[a->core_count++] = processor_info->ProcessorMask;
-						a->thread_count += thread;
-					}
-				}
-			}
-		}
+gb_inline b32  gb__buddy_bit     (u8 *bits, isize i) { return (bits[i>>3] >> (i&7)) & 1; }
+gb_inline void gb__buddy_bit_set (u8 *bits, isize i) { bits[i>>3] |=  cast(u8)(1 << (i&7)); }
+gb_inline void gb__buddy_bit_clr (u8 *bits, isize i) { bits[i>>3] &= cast(u8)~(1 << (i&7)); }
+gb_inline b32  gb__buddy_bit_flip(u8 *bits, isize i) { bits[i>>3] ^=  cast(u8)(1 << (i&7)); return gb__buddy_bit(bits, i); }
 
-		gb_free(gb_heap_allocator(), start_processor_info);
-	}
+gb_inline isize gb__buddy_block_size(gbBuddy *b, isize level) { return b->total_size >> level; }
 
-	GB_ASSERT(a->core_count <= a->thread_count);
-	if (a->thread_count == 0) {
-		a->is_accurate   = false;
-		a->core_count    = 1;
-		a->thread_count  = 1;
-		a->core_masks[0] = 1;
-	}
+gb_inline isize gb__buddy_node_of(gbBuddy *b, void *ptr, isize level) {
+	isize offset = gb_pointer_diff(b->vm.data, ptr);
+	return ((cast(isize)1 << level) - 1) + (offset >> (b->level_count-1 - level)) / b->min_block_size;
+}
 
+gb_inline void *gb__buddy_ptr_of(gbBuddy *b, isize node, isize level) {
+	isize index = node - ((cast(isize)1 << level) - 1);
+	return gb_pointer_add(b->vm.data, index * gb__buddy_block_size(b, level));
 }
-void gb_affinity_destroy(gbAffinity *a) {
-	gb_unused(a);
+
+gb_internal void gb__buddy_push(gbBuddy *b, void *ptr, isize level) {
+	gbBuddyBlock *block = cast(gbBuddyBlock *)ptr;
+	block->prev = NULL;
+	block->next = b->free_lists[level];
+	if (block->next) block->next->prev = block;
+	b->free_lists[level] = block;
 }
 
+gb_internal void gb__buddy_remove(gbBuddy *b, void *ptr, isize level) {
+	gbBuddyBlock *block = cast(gbBuddyBlock *)ptr;
+	if (block->next) block->next->prev = block->prev;
+	if (block->prev) block->prev->next = block->next;
+	else             b->free_lists[level] = block->next;
+}
 
-b32 gb_affinity_set(gbAffinity *a, isize core, isize thread) {
-	usize available_mask, check_mask = 1;
-	GB_ASSERT(thread < gb_affinity_thread_count_for_core(a, core));
+gb_internal void gb__buddy_purge(gbBuddy *b, void *ptr, isize level) {
+	// NOTE(bill): The first page holds the free list links
+	isize size = gb__buddy_block_size(b, level);
+	if (b->purge_size > 0 && size >= b->purge_size && size > b->page_size)
+		gb_vm_purge(gb_virtual_memory(gb_pointer_add(ptr, b->page_size), size - b->page_size));
+}
 
-	available_mask = a->core_masks[core];
-	for (;;) {
-		if ((available_mask & check_mask) != 0) {
-			if (thread-- == 0) {
-				usize result = SetThreadAffinityMask(GetCurrentThread(), check_mask);
-				return result != 0;
-			}
-		}
-		check_mask <<= 1; // NOTE(bill): Onto the next bit
+// NOTE(bill): The level of an allocated block is the first node on its path which is not split
+gb_internal isize gb__buddy_level_of(gbBuddy *b, void *ptr, isize *node_out) {
+	isize level = 0, node = 0;
+	while (level < b->level_count-1 && gb__buddy_bit(b->split_bits, node)) {
+		level++;
+		node = gb__buddy_node_of(b, ptr, level);
 	}
+	if (node_out) *node_out = node;
+	return level;
 }
 
-isize gb_affinity_thread_count_for_core(gbAffinity *a, isize core) {
-	GB_ASSERT(core >= 0 && core < a->core_count);
-	return gb_count_set_bits(a->core_masks[core]);
+gb_internal void gb__buddy_reset(gbBuddy *b) {
+	gb_zero_size(b->bitmaps.data, b->bitmaps.size);
+	gb_zero_array(b->free_lists, GB_BUDDY_MAX_LEVELS);
+	b->total_allocated  = 0;
+	b->allocation_count = 0;
+	gb__buddy_push(b, b->vm.data, 0);
 }
 
-#elif defined(GB_SYSTEM_OSX)
-void gb_affinity_init(gbAffinity *a) {
-	usize count = 0;
-	usize count_size = sizeof(count);
-
-	a->is_accurate      = false;
-	a->thread_count     = 1;
-	a->core_count       = 1;
-	a->threads_per_core = 1;
+b32 gb_buddy_init(gbBuddy *b, isize size, isize min_block_size) {
+	gbVirtualMemory vm;
+	isize internal_nodes, bitmap_size;
+
+	gb_zero_item(b);
+	b->page_size      = gb_virtual_memory_page_size(NULL);
+	b->min_block_size = gb__buddy_next_pow2(gb_max(min_block_size, gb_size_of(gbBuddyBlock)));
+	b->total_size     = gb__buddy_next_pow2(gb_max(size, b->min_block_size));
+	b->purge_size     = GB_BUDDY_PURGE_SIZE;
+	b->level_count    = cast(i32)(gb__bit_scan_reverse(cast(u64)(b->total_size / b->min_block_size)) + 1);
+	GB_ASSERT(b->level_count <= GB_BUDDY_MAX_LEVELS);
+
+	// NOTE(bill): Reserve twice the size and trim it so the region is aligned to its own size
+	vm = gb_vm_alloc(NULL, b->total_size*2);
+	if (vm.data == NULL || vm.data == cast(void *)-1)
+		return false;
+	b->vm = gb_vm_trim(vm, gb_pointer_diff(vm.data, gb_align_forward(vm.data, b->total_size)), b->total_size);
+	if (b->vm.data == NULL)
+		return false;
 
-	if (sysctlbyname("hw.logicalcpu", &count, &count_size, NULL, 0) == 0) {
-		if (count > 0) {
-			a->thread_count = count;
-			// Get # of physical cores
-			if (sysctlbyname("hw.physicalcpu", &count, &count_size, NULL, 0) == 0) {
-				if (count > 0) {
-					a->core_count = count;
-					a->threads_per_core = a->thread_count / count;
-					if (a->threads_per_core < 1)
-						a->threads_per_core = 1;
-					else
-						a->is_accurate = true;
-				}
-			}
-		}
+	internal_nodes = (cast(isize)1 << (b->level_count-1)) - 1;
+	bitmap_size = gb_max((internal_nodes+7)/8, 1);
+	b->bitmaps = gb_vm_alloc(NULL, bitmap_size*2);
+	if (b->bitmaps.data == NULL || b->bitmaps.data == cast(void *)-1) {
+		gb_vm_free(b->vm);
+		return false;
 	}
+	b->split_bits = cast(u8 *)b->bitmaps.data;
+	b->pair_bits  = b->split_bits + bitmap_size;
 
+	gb__buddy_reset(b);
+	return true;
 }
 
-void gb_affinity_destroy(gbAffinity *a) {
-	gb_unused(a);
+void gb_buddy_free(gbBuddy *b) {
+	if (b->vm.data)      gb_vm_free(b->vm);
+	if (b->bitmaps.data) gb_vm_free(b->bitmaps);
+	gb_zero_item(b);
 }
 
-b32 gb_affinity_set(gbAffinity *a, isize core, isize thread_index) {
-	isize index;
-	thread_t thread;
-	thread_affinity_policy_data_t info;
-	kern_return_t result;
-
-	GB_ASSERT(core < a->core_count);
-	GB_ASSERT(thread_index < a->threads_per_core);
 
-	index = core * a->threads_per_core + thread_index;
-	thread = mach_thread_self();
-	info.affinity_tag = cast(integer_t)index;
-	result = thread_policy_set(thread, THREAD_AFFINITY_POLICY, cast(thread_policy_t)&info, THREAD_AFFINITY_POLICY_COUNT);
-	return result == KERN_SUCCESS;
+gb_inline gbAllocator gb_buddy_allocator(gbBuddy *b) {
+	gbAllocator a;
+	a.proc = gb_buddy_allocator_proc;
+	a.data = b;
+	return a;
 }
 
-isize gb_affinity_thread_count_for_core(gbAffinity *a, isize core) {
-	GB_ASSERT(core >= 0 && core < a->core_count);
-	return a->threads_per_core;
+gb_inline isize gb__buddy_level_for(gbBuddy *b, isize size, isize alignment) {
+	isize block_size = gb__buddy_next_pow2(gb_max(gb_max(size, alignment), b->min_block_size));
+	if (block_size > b->total_size)
+		return -1;
+	return b->level_count-1 - gb__bit_scan_reverse(cast(u64)(block_size / b->min_block_size));
 }
 
-#elif defined(GB_SYSTEM_LINUX)
-// IMPORTANT TODO(bill): This gbAffinity stuff for linux needs be improved a lot!
-// NOTE(zangent): I have to read /proc/cpuinfo to get the number of threads per core.
-#include <stdio.h>
+// NOTE(bill): Splits an allocated block down to `target` freeing the right halves
+gb_internal void gb__buddy_split(gbBuddy *b, void *ptr, isize level, isize target) {
+	while (level < target) {
+		isize node = gb__buddy_node_of(b, ptr, level);
+		gb__buddy_bit_set(b->split_bits, node);
+		gb__buddy_bit_flip(b->pair_bits, node); // NOTE(bill): left is used and right is free
+		level++;
+		gb__buddy_push(b, gb_pointer_add(ptr, gb__buddy_block_size(b, level)), level);
+	}
+}
 
-void gb_affinity_init(gbAffinity *a) {
-	b32   accurate = true;
-	isize threads = 0;
+GB_ALLOCATOR_PROC(gb_buddy_allocator_proc) {
+	gbBuddy *b = cast(gbBuddy *)allocator_data;
+	void *ptr = NULL;
+	gb_unused(old_size);
 
-	a->thread_count     = 1;
-	a->core_count       = sysconf(_SC_NPROCESSORS_ONLN);
-	a->threads_per_core = 1;
+	GB_ASSERT_NOT_NULL(b);
 
+	switch (type) {
+	case gbAllocation_Alloc: {
+		isize target = gb__buddy_level_for(b, size, alignment);
+		isize level;
+		if (target < 0)
+			return NULL;
 
-	if(a->core_count <= 0) {
-		a->core_count = 1;
-		accurate = false;
-	}
+		for (level = target; level >= 0; level--) {
+			if (b->free_lists[level] != NULL)
+				break;
+		}
+		if (level < 0)
+			return NULL;
 
-	// Parsing /proc/cpuinfo to get the number of threads per core.
-	// NOTE(zangent): This calls the CPU's threads "cores", although the wording
-	// is kind of weird. This should be right, though.
+		ptr = b->free_lists[level];
+		gb__buddy_remove(b, ptr, level);
+		if (level > 0)
+			gb__buddy_bit_flip(b->pair_bits, (gb__buddy_node_of(b, ptr, level)-1)/2);
+		gb__buddy_split(b, ptr, level, target);
 
-	FILE* cpu_info = fopen("/proc/cpuinfo", "r");
+		b->total_allocated += gb__buddy_block_size(b, target);
+		b->allocation_count++;
 
-	if (cpu_info != NULL) {
-		for (;;) {
-			// The 'temporary char'. Everything goes into this char,
-			// so that we can check against EOF at the end of this loop.
-			char c;
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
 
-#define AF__CHECK(letter) ((c = getc(cpu_info)) == letter)
-			if (AF__CHECK('c') && AF__CHECK('p') && AF__CHECK('u') && AF__CHECK(' ') &&
-			    AF__CHECK('c') && AF__CHECK('o') && AF__CHECK('r') && AF__CHECK('e') && AF__CHECK('s')) {
-				// We're on a CPU info line.
-				while (!AF__CHECK(EOF)) {
-					if (c == '\n') {
-						break;
-					} else if (c < '0' || '9' > c) {
-						continue;
-					}
-					threads = threads * 10 + (c - '0');
-				}
-				break;
-			} else {
-				while (!AF__CHECK('\n')) {
-					if (c==EOF) {
-						break;
-					}
-				}
-			}
-			if (c == EOF) {
-				break;
-			}
-#undef AF__CHECK
+	case gbAllocation_Free: {
+		isize node, level;
+		if (old_memory == NULL)
+			return NULL;
+		GB_ASSERT(old_memory >= b->vm.data && old_memory < gb_pointer_add(b->vm.data, b->total_size));
+
+		ptr = old_memory;
+		level = gb__buddy_level_of(b, ptr, &node);
+		GB_ASSERT_MSG(gb__buddy_ptr_of(b, node, level) == ptr, "Invalid pointer %p", old_memory);
+		b->total_allocated -= gb__buddy_block_size(b, level);
+		b->allocation_count--;
+
+		while (level > 0) {
+			isize parent = (node-1)/2;
+			isize buddy_node = ((node-1)^1)+1;
+			if (gb__buddy_bit_flip(b->pair_bits, parent))
+				break; // NOTE(bill): Buddy is still in use
+
+			gb__buddy_remove(b, gb__buddy_ptr_of(b, buddy_node, level), level);
+			gb__buddy_bit_clr(b->split_bits, parent);
+			node = parent;
+			level--;
 		}
+		ptr = gb__buddy_ptr_of(b, node, level);
+		gb__buddy_push(b, ptr, level);
+		gb__buddy_purge(b, ptr, level);
+		ptr = NULL;
+	} break;
 
-		fclose(cpu_info);
-	}
-
-	if (threads == 0) {
-		threads  = 1;
-		accurate = false;
-	}
+	case gbAllocation_FreeAll:
+		gb__buddy_reset(b);
+		gb__buddy_purge(b, b->vm.data, 0);
+		break;
 
-	a->threads_per_core = threads;
-	a->thread_count = a->threads_per_core * a->core_count;
-	a->is_accurate = accurate;
+	case gbAllocation_Resize: {
+		isize node, level, target;
+		if (old_memory == NULL || size == 0 || (cast(uintptr)old_memory & cast(uintptr)(alignment-1)) != 0)
+			return gb_default_resize_align(gb_buddy_allocator(b), old_memory, old_size, size, alignment);
 
-}
+		level  = gb__buddy_level_of(b, old_memory, &node);
+		target = gb__buddy_level_for(b, size, alignment);
+		if (target < 0)
+			return NULL;
 
-void gb_affinity_destroy(gbAffinity *a) {
-	gb_unused(a);
-}
+		if (target >= level) {
+			gb__buddy_split(b, old_memory, level, target);
+			b->total_allocated -= gb__buddy_block_size(b, level) - gb__buddy_block_size(b, target);
+			return old_memory;
+		} else {
+			// NOTE(bill): Grow in place if the block is a left child all the way up and every buddy is free
+			isize l, n = node;
+			for (l = level; l > target; l--) {
+				if ((n & 1) == 0 || !gb__buddy_bit(b->pair_bits, (n-1)/2))
+					break;
+				n = (n-1)/2;
+			}
+			if (l == target) {
+				for (l = level, n = node; l > target; l--) {
+					isize parent = (n-1)/2;
+					gb__buddy_remove(b, gb__buddy_ptr_of(b, n+1, l), l);
+					gb__buddy_bit_clr(b->pair_bits, parent);
+					gb__buddy_bit_clr(b->split_bits, parent);
+					n = parent;
+				}
+				b->total_allocated += gb__buddy_block_size(b, target) - gb__buddy_block_size(b, level);
+				return old_memory;
+			}
+		}
+		ptr = gb_default_resize_align(gb_buddy_allocator(b), old_memory, old_size, size, alignment);
+	} break;
+	}
 
-b32 gb_affinity_set(gbAffinity *a, isize core, isize thread_index) {
-	return true;
+	return ptr;
 }
 
-isize gb_affinity_thread_count_for_core(gbAffinity *a, isize core) {
-	GB_ASSERT(0 <= core && core < a->core_count);
-	return a->threads_per_core;
-}
-#else
-#error TODO(bill): Unknown system
-#endif
 
 
+//
+// Thread Cache Allocator
+//
 
+typedef struct gbThreadCacheHeader {
+	gbThreadCacheLocal *owner;      // NOTE(bill): NULL if it came straight from the backing allocator
+	isize               size_class; // NOTE(bill): Offset to the backing allocation if owner == NULL
+} gbThreadCacheHeader;
 
+typedef struct gbThreadCacheSlot {
+	gbThreadCache *     cache;
+	u32                 cache_id;
+	gbThreadCacheLocal *local;
+} gbThreadCacheSlot;
 
+gb_global gb_thread_local gbThreadCacheSlot gb__thread_cache_slots[GB_THREAD_CACHE_MAX_PER_THREAD];
+gb_global gbAtomic32 gb__thread_cache_next_id;
 
+gb_inline gbThreadCacheHeader *gb__thread_cache_header(void *ptr) { return cast(gbThreadCacheHeader *)ptr - 1; }
 
+gb_inline isize gb__thread_cache_class(isize size) {
+	if (size <= GB_THREAD_CACHE_MIN_SIZE)
+		return 0;
+	return gb__bit_scan_reverse(cast(u64)(size-1)) + 1 - 4;
+}
 
+gb_inline isize gb__thread_cache_class_size(isize size_class) {
+	return gb_size_of(gbThreadCacheHeader) + (GB_THREAD_CACHE_MIN_SIZE << size_class);
+}
 
-////////////////////////////////////////////////////////////////
-//
-// Virtual Memory
-//
-//
+gb_internal gbThreadCacheLocal *gb__thread_cache_local(gbThreadCache *tc) {
+	gbThreadCacheSlot *empty = NULL;
+	gbThreadCacheLocal *local;
+	isize i;
+	for (i = 0; i < GB_THREAD_CACHE_MAX_PER_THREAD; i++) {
+		gbThreadCacheSlot *slot = &gb__thread_cache_slots[i];
+		if (slot->cache == tc) {
+			if (slot->cache_id == tc->id)
+				return slot->local;
+			// NOTE(bill): Stale slot of a freed cache that lived at the same address
+			slot->cache = NULL;
+		}
+		if (slot->cache == NULL && empty == NULL)
+			empty = slot;
+	}
+	if (empty == NULL)
+		return NULL;
 
-gbVirtualMemory gb_virtual_memory(void *data, isize size) {
-	gbVirtualMemory vm;
-	vm.data = data;
-	vm.size = size;
-	return vm;
-}
+	gb_mutex_lock(&tc->mutex);
+	// NOTE(bill): Reuse the state of a thread that has flushed before making a new one
+	for (local = tc->locals; local != NULL; local = local->next) {
+		if (gb_atomic32_compare_exchange(&local->in_use, 0, 1) == 0)
+			break;
+	}
+	if (local == NULL) {
+		local = cast(gbThreadCacheLocal *)gb_alloc_align(tc->backing, gb_size_of(gbThreadCacheLocal), GB_CACHE_LINE_SIZE);
+		if (local != NULL) {
+			gb_zero_item(local);
+			local->cache = tc;
+			local->next  = tc->locals;
+			gb_atomic32_store(&local->in_use, 1);
+			tc->locals = local;
+		}
+	}
+	gb_mutex_unlock(&tc->mutex);
 
+	if (local != NULL) {
+		empty->cache    = tc;
+		empty->cache_id = tc->id;
+		empty->local    = local;
+	}
+	return local;
+}
 
-#if defined(GB_SYSTEM_WINDOWS)
-gb_inline gbVirtualMemory gb_vm_alloc(void *addr, isize size) {
-	gbVirtualMemory vm;
-	GB_ASSERT(size > 0);
-	vm.data = VirtualAlloc(addr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-	vm.size = size;
-	return vm;
+gb_internal void gb__thread_cache_push_remote(gbThreadCacheLocal *owner, void *first, void *last) {
+	void *head = gb_atomic_ptr_load(&owner->remote_frees);
+	for (;;) {
+		void *prev;
+		*cast(void **)last = head;
+		prev = gb_atomic_ptr_compare_exchange(&owner->remote_frees, head, first);
+		if (prev == head)
+			return;
+		head = prev;
+	}
 }
 
-gb_inline b32 gb_vm_free(gbVirtualMemory vm) {
-	MEMORY_BASIC_INFORMATION info;
-	while (vm.size > 0) {
-		if (VirtualQuery(vm.data, &info, gb_size_of(info)) == 0)
-			return false;
-		if (info.BaseAddress != vm.data ||
-		    info.AllocationBase != vm.data ||
-		    info.State != MEM_COMMIT || info.RegionSize > cast(usize)vm.size) {
-			return false;
-		}
-		if (VirtualFree(vm.data, 0, MEM_RELEASE) == 0)
-			return false;
-		vm.data = gb_pointer_add(vm.data, info.RegionSize);
-		vm.size -= info.RegionSize;
+gb_internal void gb__thread_cache_flush_remote(gbThreadCacheLocal *local) {
+	if (local->remote_count > 0) {
+		gb__thread_cache_push_remote(local->remote_owner, local->remote_first, local->remote_last);
+		local->remote_owner = NULL;
+		local->remote_first = NULL;
+		local->remote_last  = NULL;
+		local->remote_count = 0;
 	}
-	return true;
 }
 
-gb_inline gbVirtualMemory gb_vm_trim(gbVirtualMemory vm, isize lead_size, isize size) {
-	gbVirtualMemory new_vm = {0};
-	void *ptr;
-	GB_ASSERT(vm.size >= lead_size + size);
+// NOTE(bill): Moves the blocks other threads have freed into the bins, only the owner can do this
+gb_internal void gb__thread_cache_drain_remote(gbThreadCacheLocal *local) {
+	void *block = gb_atomic_ptr_exchanged(&local->remote_frees, NULL);
+	while (block != NULL) {
+		void *next = *cast(void **)block;
+		gbThreadCacheBin *bin = &local->bins[gb__thread_cache_header(block)->size_class];
+		*cast(void **)block = bin->blocks;
+		bin->blocks = block;
+		bin->count++;
+		block = next;
+	}
+}
 
-	ptr = gb_pointer_add(vm.data, lead_size);
+// NOTE(bill): Frees the first `count` blocks of a bin, must hold the mutex
+gb_internal void gb__thread_cache_release(gbThreadCache *tc, gbThreadCacheBin *bin, isize count) {
+	while (count-- > 0 && bin->blocks != NULL) {
+		void *block = bin->blocks;
+		bin->blocks = *cast(void **)block;
+		bin->count--;
+		gb_free(tc->backing, gb__thread_cache_header(block));
+	}
+}
 
-	gb_vm_free(vm);
-	new_vm = gb_vm_alloc(ptr, size);
-	if (new_vm.data == ptr)
-		return new_vm;
-	if (new_vm.data)
-		gb_vm_free(new_vm);
-	return new_vm;
+gb_internal void gb__thread_cache_release_all(gbThreadCache *tc, gbThreadCacheLocal *local) {
+	isize i;
+	gb__thread_cache_drain_remote(local);
+	gb_mutex_lock(&tc->mutex);
+	for (i = 0; i < GB_THREAD_CACHE_CLASS_COUNT; i++)
+		gb__thread_cache_release(tc, &local->bins[i], local->bins[i].count);
+	gb_mutex_unlock(&tc->mutex);
 }
 
-gb_inline b32 gb_vm_purge(gbVirtualMemory vm) {
-	VirtualAlloc(vm.data, vm.size, MEM_RESET, PAGE_READWRITE);
-	// NOTE(bill): Can this really fail?
-	return true;
+gb_internal void gb__thread_cache_refill(gbThreadCache *tc, gbThreadCacheLocal *local, isize size_class) {
+	gbThreadCacheBin *bin = &local->bins[size_class];
+	isize i;
+	gb__thread_cache_drain_remote(local);
+	if (bin->count > 0)
+		return;
+
+	gb_mutex_lock(&tc->mutex);
+	for (i = 0; i < GB_THREAD_CACHE_BIN_SIZE/2; i++) {
+		gbThreadCacheHeader *header = cast(gbThreadCacheHeader *)gb_alloc(tc->backing, gb__thread_cache_class_size(size_class));
+		if (header == NULL)
+			break;
+		header->owner      = local;
+		header->size_class = size_class;
+		*cast(void **)(header+1) = bin->blocks;
+		bin->blocks = header+1;
+		bin->count++;
+	}
+	gb_mutex_unlock(&tc->mutex);
 }
 
-isize gb_virtual_memory_page_size(isize *alignment_out) {
-	SYSTEM_INFO info;
-	GetSystemInfo(&info);
-	if (alignment_out) *alignment_out = info.dwAllocationGranularity;
-	return info.dwPageSize;
+
+void gb_thread_cache_init(gbThreadCache *tc, gbAllocator backing) {
+	gb_zero_item(tc);
+	tc->backing = backing;
+	tc->id = cast(u32)gb_atomic32_fetch_add(&gb__thread_cache_next_id, 1) + 1;
+	gb_mutex_init(&tc->mutex);
 }
 
-#else
+void gb_thread_cache_free(gbThreadCache *tc) {
+	gbThreadCacheLocal *local, *next;
+	isize i;
+	// NOTE(bill): Pending remote batches must be pushed before any remote list is drained
+	for (local = tc->locals; local != NULL; local = local->next)
+		gb__thread_cache_flush_remote(local);
+	for (local = tc->locals; local != NULL; local = next) {
+		next = local->next;
+		gb__thread_cache_release_all(tc, local);
+		gb_free(tc->backing, local);
+	}
+	for (i = 0; i < GB_THREAD_CACHE_MAX_PER_THREAD; i++) {
+		if (gb__thread_cache_slots[i].cache == tc)
+			gb__thread_cache_slots[i].cache = NULL;
+	}
+	gb_mutex_destroy(&tc->mutex);
+	gb_zero_item(tc);
+}
 
-#ifndef MAP_ANONYMOUS
-#define MAP_ANONYMOUS MAP_ANON
-#endif
+void gb_thread_cache_trim(gbThreadCache *tc) {
+	isize i;
+	for (i = 0; i < GB_THREAD_CACHE_MAX_PER_THREAD; i++) {
+		gbThreadCacheSlot *slot = &gb__thread_cache_slots[i];
+		if (slot->cache == tc && slot->cache_id == tc->id) {
+			gb__thread_cache_flush_remote(slot->local);
+			gb__thread_cache_release_all(tc, slot->local);
+		}
+	}
+}
 
-gb_inline gbVirtualMemory gb_vm_alloc(void *addr, isize size) {
-	gbVirtualMemory vm;
-	GB_ASSERT(size > 0);
-	vm.data = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-	vm.size = size;
-	return vm;
+void gb_thread_cache_flush_thread(gbThreadCache *tc) {
+	isize i;
+	for (i = 0; i < GB_THREAD_CACHE_MAX_PER_THREAD; i++) {
+		gbThreadCacheSlot *slot = &gb__thread_cache_slots[i];
+		if (slot->cache == tc) {
+			if (slot->cache_id == tc->id) {
+				gb__thread_cache_flush_remote(slot->local);
+				gb__thread_cache_release_all(tc, slot->local);
+				gb_atomic32_store(&slot->local->in_use, 0);
+			}
+			slot->cache = NULL;
+			slot->local = NULL;
+		}
+	}
 }
 
-gb_inline b32 gb_vm_free(gbVirtualMemory vm) {
-	munmap(vm.data, vm.size);
-	return true;
+
+gb_inline gbAllocator gb_thread_cache_allocator(gbThreadCache *tc) {
+	gbAllocator a;
+	a.proc = gb_thread_cache_allocator_proc;
+	a.data = tc;
+	return a;
 }
 
-gb_inline gbVirtualMemory gb_vm_trim(gbVirtualMemory vm, isize lead_size, isize size) {
-	void *ptr;
-	isize trail_size;
-	GB_ASSERT(vm.size >= lead_size + size);
+GB_ALLOCATOR_PROC(gb_thread_cache_allocator_proc) {
+	gbThreadCache *tc = cast(gbThreadCache *)allocator_data;
+	void *ptr = NULL;
 
-	ptr = gb_pointer_add(vm.data, lead_size);
-	trail_size = vm.size - lead_size - size;
+	GB_ASSERT_NOT_NULL(tc);
 
-	if (lead_size != 0)
-		gb_vm_free(gb_virtual_memory(vm.data, lead_size));
-	if (trail_size != 0)
-		gb_vm_free(gb_virtual_memory(ptr, trail_size));
-	return gb_virtual_memory(ptr, size);
+	switch (type) {
+	case gbAllocation_Alloc: {
+		gbThreadCacheLocal *local = NULL;
+		if (size <= GB_THREAD_CACHE_MAX_SIZE && alignment <= gb_size_of(gbThreadCacheHeader))
+			local = gb__thread_cache_local(tc);
+
+		if (local != NULL) {
+			isize size_class = gb__thread_cache_class(size);
+			gbThreadCacheBin *bin = &local->bins[size_class];
+			if (bin->count == 0)
+				gb__thread_cache_refill(tc, local, size_class);
+			if (bin->count == 0)
+				return NULL;
+			ptr = bin->blocks;
+			bin->blocks = *cast(void **)ptr;
+			bin->count--;
+		} else {
+			isize offset = gb_max(alignment, gb_size_of(gbThreadCacheHeader));
+			void *raw;
+			gb_mutex_lock(&tc->mutex);
+			raw = gb_alloc_align(tc->backing, size + offset, alignment);
+			gb_mutex_unlock(&tc->mutex);
+			if (raw == NULL)
+				return NULL;
+			ptr = gb_pointer_add(raw, offset);
+			gb__thread_cache_header(ptr)->owner      = NULL;
+			gb__thread_cache_header(ptr)->size_class = offset;
+		}
 
-}
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
 
-gb_inline b32 gb_vm_purge(gbVirtualMemory vm) {
-	int err = madvise(vm.data, vm.size, MADV_DONTNEED);
-	return err != 0;
-}
+	case gbAllocation_Free: {
+		gbThreadCacheHeader *header;
+		gbThreadCacheLocal *local;
+		if (old_memory == NULL)
+			return NULL;
 
-isize gb_virtual_memory_page_size(isize *alignment_out) {
-	// TODO(bill): Is this always true?
-	isize result = cast(isize)sysconf(_SC_PAGE_SIZE);
-	if (alignment_out) *alignment_out = result;
-	return result;
-}
+		header = gb__thread_cache_header(old_memory);
+		if (header->owner == NULL) {
+			gb_mutex_lock(&tc->mutex);
+			gb_free(tc->backing, gb_pointer_sub(old_memory, header->size_class));
+			gb_mutex_unlock(&tc->mutex);
+			break;
+		}
 
-#endif
+		local = gb__thread_cache_local(tc);
+		if (local == header->owner) {
+			gbThreadCacheBin *bin = &local->bins[header->size_class];
+			*cast(void **)old_memory = bin->blocks;
+			bin->blocks = old_memory;
+			if (++bin->count > GB_THREAD_CACHE_BIN_SIZE) {
+				gb_mutex_lock(&tc->mutex);
+				gb__thread_cache_release(tc, bin, GB_THREAD_CACHE_BIN_SIZE/2);
+				gb_mutex_unlock(&tc->mutex);
+			}
+		} else if (local == NULL) {
+			gb__thread_cache_push_remote(header->owner, old_memory, old_memory);
+		} else {
+			if (local->remote_owner != header->owner)
+				gb__thread_cache_flush_remote(local);
+			*cast(void **)old_memory = local->remote_first;
+			if (local->remote_first == NULL)
+				local->remote_last = old_memory;
+			local->remote_first = old_memory;
+			local->remote_owner = header->owner;
+			if (++local->remote_count >= GB_THREAD_CACHE_REMOTE_BATCH)
+				gb__thread_cache_flush_remote(local);
+		}
+	} break;
+
+	case gbAllocation_FreeAll:
+		// NOTE(bill): Large allocations are not tracked and other threads may hold blocks
+		GB_PANIC("You cannot free all of a thread cache, use gb_thread_cache_free");
+		break;
+
+	case gbAllocation_Resize: {
+		if (old_memory != NULL && size > 0) {
+			gbThreadCacheHeader *header = gb__thread_cache_header(old_memory);
+			if (header->owner != NULL && alignment <= gb_size_of(gbThreadCacheHeader) &&
+			    size <= (GB_THREAD_CACHE_MIN_SIZE << header->size_class)) {
+				return old_memory;
+			}
+		}
+		ptr = gb_default_resize_align(gb_thread_cache_allocator(tc), old_memory, old_size, size, alignment);
+	} break;
+	}
 
+	return ptr;
+}
 
 
 
-////////////////////////////////////////////////////////////////
-//
-// Custom Allocation
 //
+// Tracking Allocator
 //
 
+gb_global gb_thread_local char const *gb__tracking_file;
+gb_global gb_thread_local isize       gb__tracking_line;
 
-//
-// Arena Allocator
-//
+gb_inline void gb_tracking_set_call_site(char const *file, isize line) {
+	gb__tracking_file = file;
+	gb__tracking_line = line;
+}
 
-gb_inline void gb_arena_init_from_memory(gbArena *arena, void *start, isize size) {
-	arena->backing.proc    = NULL;
-	arena->backing.data    = NULL;
-	arena->physical_start  = start;
-	arena->total_size      = size;
-	arena->total_allocated = 0;
-	arena->temp_count      = 0;
+void *gb_alloc_align_at(gbAllocator a, isize size, isize alignment, char const *file, isize line) {
+	char const *prev_file = gb__tracking_file;
+	isize       prev_line = gb__tracking_line;
+	void *ptr;
+	gb_tracking_set_call_site(file, line);
+	ptr = gb_alloc_align(a, size, alignment);
+	gb_tracking_set_call_site(prev_file, prev_line);
+	return ptr;
 }
 
-gb_inline void gb_arena_init_from_allocator(gbArena *arena, gbAllocator backing, isize size) {
-	arena->backing         = backing;
-	arena->physical_start  = gb_alloc(backing, size); // NOTE(bill): Uses default alignment
-	arena->total_size      = size;
-	arena->total_allocated = 0;
-	arena->temp_count      = 0;
+void *gb_resize_align_at(gbAllocator a, void *ptr, isize old_size, isize new_size, isize alignment, char const *file, isize line) {
+	char const *prev_file = gb__tracking_file;
+	isize       prev_line = gb__tracking_line;
+	gb_tracking_set_call_site(file, line);
+	ptr = gb_resize_align(a, ptr, old_size, new_size, alignment);
+	gb_tracking_set_call_site(prev_file, prev_line);
+	return ptr;
 }
 
-gb_inline void gb_arena_init_sub(gbArena *arena, gbArena *parent_arena, isize size) { gb_arena_init_from_allocator(arena, gb_arena_allocator(parent_arena), size); }
+gb_inline gbTrackingHeader *gb__tracking_header(void *ptr) { return cast(gbTrackingHeader *)ptr - 1; }
 
+gb_internal void gb__tracking_link(gbTrackingAllocator *t, gbTrackingHeader *h) {
+	if (!t->record_call_sites) return;
+	gb_mutex_lock(&t->mutex);
+	h->prev = NULL;
+	h->next = t->live;
+	if (t->live) t->live->prev = h;
+	t->live = h;
+	gb_mutex_unlock(&t->mutex);
+}
 
-gb_inline void gb_arena_free(gbArena *arena) {
-	if (arena->backing.proc) {
-		gb_free(arena->backing, arena->physical_start);
-		arena->physical_start = NULL;
+gb_internal void gb__tracking_unlink(gbTrackingAllocator *t, gbTrackingHeader *h) {
+	if (!t->record_call_sites) return;
+	gb_mutex_lock(&t->mutex);
+	if (h->next) h->next->prev = h->prev;
+	if (h->prev) h->prev->next = h->next;
+	else         t->live = h->next;
+	gb_mutex_unlock(&t->mutex);
+}
+
+gb_internal void gb__tracking_add(gbTrackingAllocator *t, isize size) {
+	i64 live = gb_atomic64_fetch_add(&t->live_bytes, size) + size;
+	i64 peak = gb_atomic64_load(&t->peak_bytes);
+	while (live > peak) {
+		i64 prev = gb_atomic64_compare_exchange(&t->peak_bytes, peak, live);
+		if (prev == peak)
+			break;
+		peak = prev;
 	}
 }
 
+gb_inline isize gb__tracking_bucket(isize size) {
+	isize bucket = size > 0 ? gb__bit_scan_reverse(cast(u64)size) + 1 : 0;
+	return gb_min(bucket, GB_TRACKING_HISTOGRAM_COUNT-1);
+}
 
-gb_inline isize gb_arena_alignment_of(gbArena *arena, isize alignment) {
-	isize alignment_offset, result_pointer, mask;
-	GB_ASSERT(gb_is_power_of_two(alignment));
+// NOTE(bill): Takes the call site set for this thread, there is none if it was not set just before
+gb_internal void *gb__tracking_alloc(gbTrackingAllocator *t, isize size, isize alignment) {
+	isize offset = (gb_size_of(gbTrackingHeader) + alignment-1) & ~(alignment-1);
+	gbTrackingHeader *h;
+	void *raw = gb_alloc_align(t->backing, size + offset, alignment);
+	if (raw == NULL)
+		return NULL;
 
-	alignment_offset = 0;
-	result_pointer = cast(isize)arena->physical_start + arena->total_allocated;
-	mask = alignment - 1;
-	if (result_pointer & mask)
-		alignment_offset = alignment - (result_pointer & mask);
+	h = gb__tracking_header(gb_pointer_add(raw, offset));
+	h->file   = gb__tracking_file;
+	h->line   = gb__tracking_line;
+	h->size   = size;
+	h->offset = offset;
+	gb__tracking_file = NULL;
+	gb__tracking_line = 0;
 
-	return alignment_offset;
+	gb__tracking_link(t, h);
+	gb__tracking_add(t, size);
+	gb_atomic64_fetch_add(&t->live_count, 1);
+	gb_atomic64_fetch_add(&t->alloc_count, 1);
+	gb_atomic64_fetch_add(&t->histogram[gb__tracking_bucket(size)], 1);
+	return h+1;
 }
 
-gb_inline isize gb_arena_size_remaining(gbArena *arena, isize alignment) {
-	isize result = arena->total_size - (arena->total_allocated + gb_arena_alignment_of(arena, alignment));
-	return result;
+gb_internal void gb__tracking_free(gbTrackingAllocator *t, void *ptr) {
+	gbTrackingHeader *h = gb__tracking_header(ptr);
+	gb__tracking_unlink(t, h);
+	gb_atomic64_fetch_add(&t->live_bytes, -h->size);
+	gb_atomic64_fetch_add(&t->live_count, -1);
+	gb_atomic64_fetch_add(&t->free_count, 1);
+	gb_free(t->backing, gb_pointer_sub(ptr, h->offset));
 }
 
-gb_inline void gb_arena_check(gbArena *arena) { GB_ASSERT(arena->temp_count == 0); }
 
+void gb_tracking_allocator_init(gbTrackingAllocator *t, gbAllocator backing, b32 record_call_sites) {
+	gb_zero_item(t);
+	t->backing = backing;
+	t->record_call_sites = record_call_sites;
+	gb_mutex_init(&t->mutex);
+}
 
+void gb_tracking_allocator_free(gbTrackingAllocator *t) {
+	gb_mutex_destroy(&t->mutex);
+	gb_zero_item(t);
+}
 
+void gb_tracking_allocator_reset(gbTrackingAllocator *t) {
+	isize i;
+	gb_atomic64_store(&t->peak_bytes,   gb_atomic64_load(&t->live_bytes));
+	gb_atomic64_store(&t->alloc_count,  0);
+	gb_atomic64_store(&t->free_count,   0);
+	gb_atomic64_store(&t->resize_count, 0);
+	for (i = 0; i < GB_TRACKING_HISTOGRAM_COUNT; i++)
+		gb_atomic64_store(&t->histogram[i], 0);
+}
 
+void gb_tracking_allocator_report(gbTrackingAllocator *t, char const *name) {
+	isize i;
+	gb_printf("%s:\n", name ? name : "Tracking Allocator");
+	gb_printf("  live:    %lld bytes in %lld allocations\n", cast(long long)gb_atomic64_load(&t->live_bytes), cast(long long)gb_atomic64_load(&t->live_count));
+	gb_printf("  peak:    %lld bytes\n", cast(long long)gb_atomic64_load(&t->peak_bytes));
+	gb_printf("  allocs:  %lld\n", cast(long long)gb_atomic64_load(&t->alloc_count));
+	gb_printf("  frees:   %lld\n", cast(long long)gb_atomic64_load(&t->free_count));
+	gb_printf("  resizes: %lld\n", cast(long long)gb_atomic64_load(&t->resize_count));
+
+	gb_printf("  sizes:\n");
+	for (i = 0; i < GB_TRACKING_HISTOGRAM_COUNT; i++) {
+		i64 count = gb_atomic64_load(&t->histogram[i]);
+		if (count == 0)
+			continue;
+		if (i == 0)
+			gb_printf("    %12d               : %lld\n", 0, cast(long long)count);
+		else if (i == GB_TRACKING_HISTOGRAM_COUNT-1)
+			gb_printf("    %12lld and above     : %lld\n", cast(long long)1 << (i-1), cast(long long)count);
+		else
+			gb_printf("    %12lld - %12lld: %lld\n", cast(long long)1 << (i-1), (cast(long long)1 << i) - 1, cast(long long)count);
+	}
 
+	if (t->record_call_sites) {
+		gbTrackingHeader *h;
+		gb_mutex_lock(&t->mutex);
+		if (t->live) gb_printf("  live allocations:\n");
+		for (h = t->live; h != NULL; h = h->next) {
+			if (h->file) gb_printf("    %s(%td): %td bytes at %p\n", h->file, h->line, h->size, h+1);
+			else         gb_printf("    (unknown): %td bytes at %p\n", h->size, h+1);
+		}
+		gb_mutex_unlock(&t->mutex);
+	}
+}
 
-gb_inline gbAllocator gb_arena_allocator(gbArena *arena) {
-	gbAllocator allocator;
-	allocator.proc = gb_arena_allocator_proc;
-	allocator.data = arena;
-	return allocator;
+
+gb_inline gbAllocator gb_tracking_allocator(gbTrackingAllocator *t) {
+	gbAllocator a;
+	a.proc = gb_tracking_allocator_proc;
+	a.data = t;
+	return a;
 }
 
-GB_ALLOCATOR_PROC(gb_arena_allocator_proc) {
-	gbArena *arena = cast(gbArena *)allocator_data;
+GB_ALLOCATOR_PROC(gb_tracking_allocator_proc) {
+	gbTrackingAllocator *t = cast(gbTrackingAllocator *)allocator_data;
 	void *ptr = NULL;
 
-	gb_unused(old_size);
+	GB_ASSERT_NOT_NULL(t);
 
 	switch (type) {
-	case gbAllocation_Alloc: {
-		void *end = gb_pointer_add(arena->physical_start, arena->total_allocated);
-		isize total_size = size + alignment;
-
-		// NOTE(bill): Out of memory
-		if (arena->total_allocated + total_size > cast(isize)arena->total_size) {
-			gb_printf_err("Arena out of memory\n");
-			return NULL;
-		}
-
-		ptr = gb_align_forward(end, alignment);
-		arena->total_allocated += total_size;
-		if (flags & gbAllocatorFlag_ClearToZero)
+	case gbAllocation_Alloc:
+		ptr = gb__tracking_alloc(t, size, alignment);
+		if (ptr && (flags & gbAllocatorFlag_ClearToZero))
 			gb_zero_size(ptr, size);
-	} break;
+		break;
 
 	case gbAllocation_Free:
-		// NOTE(bill): Free all at once
-		// Use Temp_Arena_Memory if you want to free a block
+		if (old_memory != NULL)
+			gb__tracking_free(t, old_memory);
 		break;
 
-	case gbAllocation_FreeAll:
-		arena->total_allocated = 0;
-		break;
+	case gbAllocation_FreeAll: {
+		// NOTE(bill): Only possible if the backing allocator can free all too
+		gb_free_all(t->backing);
+		gb_mutex_lock(&t->mutex);
+		t->live = NULL;
+		gb_mutex_unlock(&t->mutex);
+		gb_atomic64_fetch_add(&t->free_count, gb_atomic64_exchanged(&t->live_count, 0));
+		gb_atomic64_store(&t->live_bytes, 0);
+	} break;
 
 	case gbAllocation_Resize: {
-		// TODO(bill): Check if ptr is on top of stack and just extend
-		gbAllocator a = gb_arena_allocator(arena);
-		ptr = gb_default_resize_align(a, old_memory, old_size, size, alignment);
+		gbTrackingHeader *h;
+		isize offset;
+		if (old_memory == NULL || size == 0) {
+			ptr = gb_default_resize_align(gb_tracking_allocator(t), old_memory, old_size, size, alignment);
+			break;
+		}
+
+		gb_atomic64_fetch_add(&t->resize_count, 1);
+		h = gb__tracking_header(old_memory);
+		offset = (gb_size_of(gbTrackingHeader) + alignment-1) & ~(alignment-1);
+		if (offset == h->offset && (cast(uintptr)old_memory & cast(uintptr)(alignment-1)) == 0) {
+			// NOTE(bill): Let the backing allocator resize in place if it can
+			isize old_block_size = h->size;
+			void *raw;
+			gb__tracking_unlink(t, h);
+			raw = gb_resize_align(t->backing, gb_pointer_sub(old_memory, offset), old_block_size + offset, size + offset, alignment);
+			if (raw == NULL) {
+				gb__tracking_link(t, h);
+				return NULL;
+			}
+			ptr = gb_pointer_add(raw, offset);
+			h = gb__tracking_header(ptr);
+			h->size = size;
+			if (gb__tracking_file) {
+				h->file = gb__tracking_file;
+				h->line = gb__tracking_line;
+				gb__tracking_file = NULL;
+				gb__tracking_line = 0;
+			}
+			gb__tracking_link(t, h);
+			if (size > old_block_size) gb__tracking_add(t, size - old_block_size);
+			else                       gb_atomic64_fetch_add(&t->live_bytes, size - old_block_size);
+		} else {
+			ptr = gb__tracking_alloc(t, size, alignment);
+			if (ptr == NULL)
+				return NULL;
+			gb_memcopy(ptr, old_memory, gb_min(size, h->size));
+			gb__tracking_free(t, old_memory);
+			// NOTE(bill): A move is one resize, not an alloc and a free
+			gb_atomic64_fetch_add(&t->alloc_count, -1);
+			gb_atomic64_fetch_add(&t->free_count,  -1);
+		}
 	} break;
 	}
-	return ptr;
-}
-
-
-gb_inline gbTempArenaMemory gb_temp_arena_memory_begin(gbArena *arena) {
-	gbTempArenaMemory tmp;
-	tmp.arena = arena;
-	tmp.original_count = arena->total_allocated;
-	arena->temp_count++;
-	return tmp;
-}
 
-gb_inline void gb_temp_arena_memory_end(gbTempArenaMemory tmp) {
-	GB_ASSERT_MSG(tmp.arena->total_allocated >= tmp.original_count,
-	              "%td >= %td", tmp.arena->total_allocated, tmp.original_count);
-	GB_ASSERT(tmp.arena->temp_count > 0);
-	tmp.arena->total_allocated = tmp.original_count;
-	tmp.arena->temp_count--;
+	return ptr;
 }
 
 
 
-
 //
-// Pool Allocator
+// Allocation Traces
 //
 
+typedef struct gbTraceHeader {
+	isize id;
+	isize offset; // NOTE(bill): From the start of the backing allocation
+} gbTraceHeader;
 
-gb_inline void gb_pool_init(gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size) {
-	gb_pool_init_align(pool, backing, num_blocks, block_size, GB_DEFAULT_MEMORY_ALIGNMENT);
-}
-
-void gb_pool_init_align(gbPool *pool, gbAllocator backing, isize num_blocks, isize block_size, isize block_align) {
-	isize actual_block_size, pool_size, block_index;
-	void *data, *curr;
-	uintptr *end;
-
-	gb_zero_item(pool);
-
-	pool->backing = backing;
-	pool->block_size = block_size;
-	pool->block_align = block_align;
+gb_inline gbTraceHeader *gb__trace_header(void *ptr) { return cast(gbTraceHeader *)ptr - 1; }
 
-	actual_block_size = block_size + block_align;
-	pool_size = num_blocks * actual_block_size;
+gb_internal void gb__trace_flush(gbTraceAllocator *t) {
+	if (t->buffer_count > 0 && !t->error) {
+		if (!gb_file_write(t->file, t->buffer, t->buffer_count*gb_size_of(gbTraceEvent)))
+			t->error = true;
+	}
+	t->buffer_count = 0;
+}
+
+// NOTE(bill): Must hold the mutex
+gb_internal void gb__trace_record(gbTraceAllocator *t, gbAllocationType type, u32 id, isize size, isize old_size, isize alignment) {
+	gbTraceEvent *e;
+	if (t->buffer_count == GB_TRACE_BUFFER_COUNT)
+		gb__trace_flush(t);
+	e = &t->buffer[t->buffer_count++];
+	e->timestamp      = gb_rdtsc();
+	e->id             = id;
+	e->type           = cast(u8)type;
+	e->alignment_log2 = cast(u8)(alignment > 0 ? gb__bit_scan_forward(cast(u64)alignment) : 0);
+	e->padding        = 0;
+	e->size           = size;
+	e->old_size       = old_size;
+	t->event_count++;
+}
+
+gb_internal void *gb__trace_alloc(gbTraceAllocator *t, isize size, isize alignment, u32 id) {
+	isize offset = (gb_size_of(gbTraceHeader) + alignment-1) & ~(alignment-1);
+	void *raw = gb_alloc_align(t->backing, size + offset, alignment);
+	void *ptr;
+	if (raw == NULL)
+		return NULL;
+	ptr = gb_pointer_add(raw, offset);
+	gb__trace_header(ptr)->id     = id;
+	gb__trace_header(ptr)->offset = offset;
+	return ptr;
+}
 
-	data = gb_alloc_align(backing, pool_size, block_align);
 
-	// NOTE(bill): Init intrusive freelist
-	curr = data;
-	for (block_index = 0; block_index < num_blocks-1; block_index++) {
-		uintptr *next = cast(uintptr *)curr;
-		*next = cast(uintptr)curr + actual_block_size;
-		curr = gb_pointer_add(curr, actual_block_size);
-	}
+b32 gb_trace_allocator_init(gbTraceAllocator *t, gbAllocator backing, gbFile *file) {
+	gbTraceFileHeader header;
+	gb_zero_item(t);
+	t->backing = backing;
+	t->file    = file;
+	gb_mutex_init(&t->mutex);
 
-	end  = cast(uintptr *)curr;
-	*end = cast(uintptr)NULL;
+	header.magic   = GB_TRACE_MAGIC;
+	header.version = GB_TRACE_VERSION;
+	if (!gb_file_write(file, &header, gb_size_of(header)))
+		t->error = true;
+	return !t->error;
+}
 
-	pool->physical_start = data;
-	pool->free_list      = data;
+void gb_trace_allocator_flush(gbTraceAllocator *t) {
+	gb_mutex_lock(&t->mutex);
+	gb__trace_flush(t);
+	gb_mutex_unlock(&t->mutex);
 }
 
-gb_inline void gb_pool_free(gbPool *pool) {
-	if (pool->backing.proc) {
-		gb_free(pool->backing, pool->physical_start);
-	}
+void gb_trace_allocator_free(gbTraceAllocator *t) {
+	gb_trace_allocator_flush(t);
+	gb_mutex_destroy(&t->mutex);
 }
 
 
-gb_inline gbAllocator gb_pool_allocator(gbPool *pool) {
-	gbAllocator allocator;
-	allocator.proc = gb_pool_allocator_proc;
-	allocator.data = pool;
-	return allocator;
+gb_inline gbAllocator gb_trace_allocator(gbTraceAllocator *t) {
+	gbAllocator a;
+	a.proc = gb_trace_allocator_proc;
+	a.data = t;
+	return a;
 }
-GB_ALLOCATOR_PROC(gb_pool_allocator_proc) {
-	gbPool *pool = cast(gbPool *)allocator_data;
+
+GB_ALLOCATOR_PROC(gb_trace_allocator_proc) {
+	gbTraceAllocator *t = cast(gbTraceAllocator *)allocator_data;
 	void *ptr = NULL;
 
-	gb_unused(old_size);
+	GB_ASSERT_NOT_NULL(t);
+
+	if (type == gbAllocation_Resize) {
+		if (old_memory == NULL) type = gbAllocation_Alloc;
+		else if (size == 0)     type = gbAllocation_Free;
+	}
 
+	gb_mutex_lock(&t->mutex);
 	switch (type) {
 	case gbAllocation_Alloc: {
-		uintptr next_free;
-		GB_ASSERT(size      == pool->block_size);
-		GB_ASSERT(alignment == pool->block_align);
-		GB_ASSERT(pool->free_list != NULL);
-
-		next_free = *cast(uintptr *)pool->free_list;
-		ptr = pool->free_list;
-		pool->free_list = cast(void *)next_free;
-		pool->total_size += pool->block_size;
-		if (flags & gbAllocatorFlag_ClearToZero)
-			gb_zero_size(ptr, size);
+		u32 id = t->next_id++;
+		ptr = gb__trace_alloc(t, size, alignment, id);
+		if (ptr != NULL) {
+			gb__trace_record(t, gbAllocation_Alloc, id, size, 0, alignment);
+			if (flags & gbAllocatorFlag_ClearToZero)
+				gb_zero_size(ptr, size);
+		}
 	} break;
 
-	case gbAllocation_Free: {
-		uintptr *next;
-		if (old_memory == NULL) return NULL;
-
-		next = cast(uintptr *)old_memory;
-		*next = cast(uintptr)pool->free_list;
-		pool->free_list = old_memory;
-		pool->total_size -= pool->block_size;
-	} break;
+	case gbAllocation_Free:
+		if (old_memory != NULL) {
+			gbTraceHeader *h = gb__trace_header(old_memory);
+			gb__trace_record(t, gbAllocation_Free, cast(u32)h->id, 0, old_size, 0);
+			gb_free(t->backing, gb_pointer_sub(old_memory, h->offset));
+		}
+		break;
 
 	case gbAllocation_FreeAll:
-		// TODO(bill):
+		gb__trace_record(t, gbAllocation_FreeAll, 0, 0, 0, 0);
+		gb_free_all(t->backing);
 		break;
 
-	case gbAllocation_Resize:
-		// NOTE(bill): Cannot resize
-		GB_PANIC("You cannot resize something allocated by with a pool.");
-		break;
+	case gbAllocation_Resize: {
+		gbTraceHeader *h = gb__trace_header(old_memory);
+		u32 id = cast(u32)h->id;
+		isize offset = (gb_size_of(gbTraceHeader) + alignment-1) & ~(alignment-1);
+		if (offset == h->offset) {
+			void *raw = gb_resize_align(t->backing, gb_pointer_sub(old_memory, offset), old_size + offset, size + offset, alignment);
+			ptr = raw ? gb_pointer_add(raw, offset) : NULL;
+		} else {
+			ptr = gb__trace_alloc(t, size, alignment, id);
+			if (ptr != NULL) {
+				gb_memcopy(ptr, old_memory, gb_min(size, old_size));
+				gb_free(t->backing, gb_pointer_sub(old_memory, h->offset));
+			}
+		}
+		if (ptr != NULL)
+			gb__trace_record(t, gbAllocation_Resize, id, size, old_size, alignment);
+	} break;
 	}
+	gb_mutex_unlock(&t->mutex);
 
 	return ptr;
 }
 
 
+//
+// Mapped Arena
+//
 
-
-
-gb_inline gbAllocationHeader *gb_allocation_header(void *data) {
-	isize *p = cast(isize *)data;
-	while (p[-1] == cast(isize)(-1)) {
-		p--;
-	}
-	return cast(gbAllocationHeader *)p - 1;
+gb_internal void gb__mapped_arena_unmap(gbMappedArena *m) {
+#if defined(GB_SYSTEM_WINDOWS)
+	UnmapViewOfFile(m->view.data);
+	CloseHandle(m->mapping);
+#else
+	munmap(m->view.data, m->view.size);
+#endif
+	m->view.data = NULL;
 }
 
-gb_inline void gb_allocation_header_fill(gbAllocationHeader *header, void *data, isize size) {
-	isize *ptr;
-	header->size = size;
-	ptr = cast(isize *)(header + 1);
-	while (cast(void *)ptr < data) {
-		*ptr++ = cast(isize)(-1);
+gb_internal b32 gb__mapped_arena_map(gbMappedArena *m, isize size, void *base_address) {
+#if defined(GB_SYSTEM_WINDOWS)
+	m->mapping = CreateFileMappingW(m->file.fd.p, NULL, PAGE_READWRITE, cast(DWORD)(cast(u64)size >> 32), cast(DWORD)(cast(u64)size), NULL);
+	if (m->mapping == NULL)
+		return false;
+	m->view.data = MapViewOfFileEx(m->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, base_address);
+	if (m->view.data == NULL) {
+		CloseHandle(m->mapping);
+		return false;
+	}
+#else
+	int flags = MAP_SHARED;
+	#if defined(MAP_FIXED_NOREPLACE)
+	if (base_address) flags |= MAP_FIXED_NOREPLACE;
+	#endif
+	m->view.data = mmap(base_address, size, PROT_READ | PROT_WRITE, flags, cast(int)m->file.fd.i, 0);
+	if (m->view.data == MAP_FAILED) {
+		m->view.data = NULL;
+		return false;
+	}
+#endif
+	m->view.size = size;
+	if (base_address && m->view.data != base_address) {
+		// NOTE(bill): It was only a hint and the address is taken
+		gb__mapped_arena_unmap(m);
+		return false;
 	}
+	return true;
 }
 
+gbFileError gb_mapped_arena_open(gbMappedArena *m, char const *filename, isize size, void *base_address, b32 verify_checksum) {
+	gbFileError err;
+	gbMappedArenaHeader header = {0};
+	i64 file_size;
+	void *data;
 
+	gb_zero_item(m);
+	// NOTE(bill): Not gbFileMode_Append as the header has to be written at offset 0
+	err = gb_file_open_mode(&m->file, gb_file_exists(filename) ? gbFileMode_Read | gbFileMode_Rw : gbFileMode_Write | gbFileMode_Rw, filename);
+	if (err != gbFileError_None)
+		return err;
+
+	file_size = gb_file_size(&m->file);
+	if (file_size == 0) {
+		size = (size + GB_MAPPED_ARENA_DATA_OFFSET-1) & ~(GB_MAPPED_ARENA_DATA_OFFSET-1);
+		GB_ASSERT(size > GB_MAPPED_ARENA_DATA_OFFSET);
+		header.magic        = GB_MAPPED_ARENA_MAGIC;
+		header.version      = GB_MAPPED_ARENA_VERSION;
+		header.data_offset  = GB_MAPPED_ARENA_DATA_OFFSET;
+		header.base_address = cast(u64)cast(uintptr)base_address;
+		header.total_size   = cast(u64)size;
+		header.used         = 0;
+		header.checksum     = gb_crc64(NULL, 0);
+		header.root         = -1;
+		if (gb_file_truncate(&m->file, size) != gbFileError_None ||
+		    !gb_file_write_at(&m->file, &header, gb_size_of(header), 0)) {
+			gb_file_close(&m->file);
+			return gbFileError_TruncationFailure;
+		}
+	} else {
+		if (file_size < gb_size_of(header) ||
+		    !gb_file_read_at(&m->file, &header, gb_size_of(header), 0) ||
+		    header.magic != GB_MAPPED_ARENA_MAGIC || header.version != GB_MAPPED_ARENA_VERSION ||
+		    header.data_offset != GB_MAPPED_ARENA_DATA_OFFSET || header.total_size != cast(u64)file_size ||
+		    header.total_size <= header.data_offset || header.used > header.total_size - header.data_offset) {
+			gb_file_close(&m->file);
+			return gbFileError_Invalid;
+		}
+		size = cast(isize)header.total_size;
+		if (base_address == NULL)
+			base_address = cast(void *)cast(uintptr)header.base_address;
+	}
 
-//
-// Free List Allocator
-//
+	if (!gb__mapped_arena_map(m, size, base_address)) {
+		gb_file_close(&m->file);
+		return gbFileError_Invalid;
+	}
 
-gb_inline void gb_free_list_init(gbFreeList *fl, void *start, isize size) {
-	GB_ASSERT(size > gb_size_of(gbFreeListBlock));
+	m->header = cast(gbMappedArenaHeader *)m->view.data;
+	data = gb_pointer_add(m->view.data, m->header->data_offset);
+	if (verify_checksum && gb_crc64(data, cast(isize)m->header->used) != m->header->checksum) {
+		// NOTE(bill): Do not sync, that would write a fresh checksum over the corrupt contents
+		gb__mapped_arena_unmap(m);
+		gb_file_close(&m->file);
+		gb_zero_item(m);
+		return gbFileError_Invalid;
+	}
+	m->header->base_address = cast(u64)cast(uintptr)base_address;
 
-	fl->physical_start   = start;
-	fl->total_size       = size;
-	fl->curr_block       = cast(gbFreeListBlock *)start;
-	fl->curr_block->size = size;
-	fl->curr_block->next = NULL;
+	gb_arena_init_from_memory(&m->arena, data, size - m->header->data_offset);
+	m->arena.total_allocated = cast(isize)m->header->used;
+	return gbFileError_None;
 }
 
-
-gb_inline void gb_free_list_init_from_allocator(gbFreeList *fl, gbAllocator backing, isize size) {
-	void *start = gb_alloc(backing, size);
-	gb_free_list_init(fl, start, size);
+b32 gb_mapped_arena_sync(gbMappedArena *m) {
+	void *data = gb_pointer_add(m->view.data, m->header->data_offset);
+	m->header->used     = cast(u64)m->arena.total_allocated;
+	m->header->checksum = gb_crc64(data, m->arena.total_allocated);
+#if defined(GB_SYSTEM_WINDOWS)
+	return FlushViewOfFile(m->view.data, 0) && FlushFileBuffers(m->file.fd.p);
+#else
+	return msync(m->view.data, m->view.size, MS_SYNC) == 0;
+#endif
 }
 
-
-
-gb_inline gbAllocator gb_free_list_allocator(gbFreeList *fl) {
-	gbAllocator a;
-	a.proc = gb_free_list_allocator_proc;
-	a.data = fl;
-	return a;
+void gb_mapped_arena_close(gbMappedArena *m) {
+	if (m->view.data == NULL)
+		return;
+	gb_mapped_arena_sync(m);
+	gb__mapped_arena_unmap(m);
+	gb_file_close(&m->file);
+	gb_zero_item(m);
 }
 
-GB_ALLOCATOR_PROC(gb_free_list_allocator_proc) {
-	gbFreeList *fl = cast(gbFreeList *)allocator_data;
-	void *ptr = NULL;
-
-	GB_ASSERT_NOT_NULL(fl);
-
-	switch (type) {
-	case gbAllocation_Alloc: {
-		gbFreeListBlock *prev_block = NULL;
-		gbFreeListBlock *curr_block = fl->curr_block;
-
-		while (curr_block) {
-			isize total_size;
-			gbAllocationHeader *header;
-
-			total_size = size + alignment + gb_size_of(gbAllocationHeader);
-
-			if (curr_block->size < total_size) {
-				prev_block = curr_block;
-				curr_block = curr_block->next;
-				continue;
-			}
+gb_inline void gb_mapped_arena_set_root(gbMappedArena *m, void *root) { m->header->root = gb_mapped_arena_offset(m, root); }
+gb_inline void *gb_mapped_arena_root(gbMappedArena *m) { return gb_mapped_arena_pointer(m, m->header->root); }
 
-			if (curr_block->size - total_size <= gb_size_of(gbAllocationHeader)) {
-				total_size = curr_block->size;
+gb_inline i64 gb_mapped_arena_offset(gbMappedArena *m, void const *ptr) {
+	if (ptr == NULL) return -1;
+	GB_ASSERT(ptr >= m->arena.physical_start && ptr < gb_pointer_add(m->arena.physical_start, m->arena.total_size));
+	return gb_pointer_diff(m->arena.physical_start, ptr);
+}
 
-				if (prev_block)
-					prev_block->next = curr_block->next;
-				else
-					fl->curr_block = curr_block->next;
-			} else {
-				// NOTE(bill): Create a new block for the remaining memory
-				gbFreeListBlock *next_block;
-				next_block = cast(gbFreeListBlock *)gb_pointer_add(curr_block, total_size);
+gb_inline void *gb_mapped_arena_pointer(gbMappedArena *m, i64 offset) {
+	if (offset < 0) return NULL;
+	return gb_pointer_add(m->arena.physical_start, cast(isize)offset);
+}
 
-				GB_ASSERT(cast(void *)next_block < gb_pointer_add(fl->physical_start, fl->total_size));
+gb_inline gbAllocator gb_mapped_arena_allocator(gbMappedArena *m) { return gb_arena_allocator(&m->arena); }
 
-				next_block->size = curr_block->size - total_size;
-				next_block->next = curr_block->next;
 
-				if (prev_block)
-					prev_block->next = next_block;
-				else
-					fl->curr_block = next_block;
-			}
+gb_inline void gb_relative_pointer_set(gbRelativePointer *rp, void const *ptr) {
+	*rp = ptr ? cast(i64)(cast(intptr)ptr - cast(intptr)rp) : 0;
+}
 
+gb_inline void *gb_relative_pointer_get(gbRelativePointer const *rp) {
+	return *rp ? cast(void *)(cast(intptr)rp + cast(intptr)*rp) : NULL;
+}
 
-			// TODO(bill): Set Header Info
-			header = cast(gbAllocationHeader *)curr_block;
-			ptr = gb_align_forward(header+1, alignment);
-			gb_allocation_header_fill(header, ptr, size);
 
-			fl->total_allocated += total_size;
-			fl->allocation_count++;
+b32 gb_trace_replay(gbFile *trace, gbAllocator a, gbTraceReplay *result) {
+	gbAllocator heap = gb_heap_allocator();
+	gbTraceFileHeader header;
+	gbTraceEvent *events;
+	void **ptrs;
+	isize *sizes;
+	i64 file_size, i, count;
+	u32 max_id = 0;
+	isize live = 0, rss_base, rss;
+	f64 start;
 
+	gb_zero_item(result);
+	file_size = gb_file_size(trace);
+	if (file_size < gb_size_of(header) ||
+	    !gb_file_read_at(trace, &header, gb_size_of(header), 0) ||
+	    header.magic != GB_TRACE_MAGIC || header.version != GB_TRACE_VERSION) {
+		return false;
+	}
 
-			if (flags & gbAllocatorFlag_ClearToZero)
-				gb_zero_size(ptr, size);
-			return ptr;
+	// NOTE(bill): Everything is loaded up front so the replay itself does no I/O
+	count = (file_size - gb_size_of(header)) / gb_size_of(gbTraceEvent);
+	events = cast(gbTraceEvent *)gb_alloc(heap, gb_max(count, 1)*gb_size_of(gbTraceEvent));
+	if (events == NULL)
+		return false;
+	if (!gb_file_read_at(trace, events, count*gb_size_of(gbTraceEvent), gb_size_of(header))) {
+		gb_free(heap, events);
+		return false;
+	}
+	for (i = 0; i < count; i++) {
+		// NOTE(bill): A larger alignment cannot be shifted into an isize, the trace is corrupt
+		if (events[i].alignment_log2 >= gb_size_of(isize)*8 - 1) {
+			gb_free(heap, events);
+			return false;
 		}
-		// NOTE(bill): if ptr == NULL, ran out of free list memory! FUCK!
-		return NULL;
-	} break;
+		max_id = gb_max(max_id, events[i].id);
+	}
 
-	case gbAllocation_Free: {
-		gbAllocationHeader *header = gb_allocation_header(old_memory);
-		isize block_size = header->size;
-		uintptr block_start, block_end;
-		gbFreeListBlock *prev_block = NULL;
-		gbFreeListBlock *curr_block = fl->curr_block;
+	ptrs  = cast(void **)gb_alloc(heap, (cast(isize)max_id+1)*gb_size_of(void *));
+	sizes = cast(isize *)gb_alloc(heap, (cast(isize)max_id+1)*gb_size_of(isize));
+	if (ptrs == NULL || sizes == NULL) {
+		gb_free(heap, ptrs);
+		gb_free(heap, sizes);
+		gb_free(heap, events);
+		return false;
+	}
+	gb_zero_size(ptrs,  (cast(isize)max_id+1)*gb_size_of(void *));
+	gb_zero_size(sizes, (cast(isize)max_id+1)*gb_size_of(isize));
 
-		block_start = cast(uintptr)header;
-		block_end   = cast(uintptr)block_start + block_size;
+	result->event_count = count;
+	if (count > 0)
+		result->trace_cycles = events[count-1].timestamp - events[0].timestamp;
 
-		while (curr_block) {
-			if (cast(uintptr)curr_block >= block_end)
+	rss_base = gb_vm_resident_size(NULL);
+	start = gb_time_now();
+	for (i = 0; i < count; i++) {
+		gbTraceEvent *e = &events[i];
+		isize alignment = cast(isize)1 << e->alignment_log2;
+		switch (e->type) {
+		case gbAllocation_Alloc:
+			ptrs[e->id] = gb_alloc_align(a, cast(isize)e->size, alignment);
+			if (ptrs[e->id] == NULL) {
+				result->failed_count++;
 				break;
-			prev_block = curr_block;
-			curr_block = curr_block->next;
-		}
+			}
+			sizes[e->id] = cast(isize)e->size;
+			live += sizes[e->id];
+			break;
 
-		if (prev_block == NULL) {
-			prev_block = cast(gbFreeListBlock *)block_start;
-			prev_block->size = block_size;
-			prev_block->next = fl->curr_block;
+		case gbAllocation_Free:
+			if (ptrs[e->id] != NULL) {
+				gb_free(a, ptrs[e->id]);
+				live -= sizes[e->id];
+				ptrs[e->id]  = NULL;
+				sizes[e->id] = 0;
+			}
+			break;
 
-			fl->curr_block = prev_block;
-		} else if ((cast(uintptr)prev_block + prev_block->size) == block_start) {
-			prev_block->size += block_size;
-		} else {
-			gbFreeListBlock *tmp = cast(gbFreeListBlock *)block_start;
-			tmp->size = block_size;
-			tmp->next = prev_block->next;
-			prev_block->next = tmp;
+		case gbAllocation_FreeAll:
+			gb_free_all(a);
+			gb_zero_size(ptrs,  (cast(isize)max_id+1)*gb_size_of(void *));
+			gb_zero_size(sizes, (cast(isize)max_id+1)*gb_size_of(isize));
+			live = 0;
+			break;
 
-			prev_block = tmp;
+		case gbAllocation_Resize:
+			if (ptrs[e->id] != NULL) {
+				void *ptr = gb_resize_align(a, ptrs[e->id], sizes[e->id], cast(isize)e->size, alignment);
+				if (ptr == NULL) {
+					result->failed_count++;
+					break;
+				}
+				live += cast(isize)e->size - sizes[e->id];
+				ptrs[e->id]  = ptr;
+				sizes[e->id] = cast(isize)e->size;
+			}
+			break;
 		}
 
-		if (curr_block && (cast(uintptr)curr_block == block_end)) {
-			prev_block->size += curr_block->size;
-			prev_block->next = curr_block->next;
+		result->peak_live_bytes = gb_max(result->peak_live_bytes, live);
+		if ((i % GB_TRACE_RSS_SAMPLE_RATE) == GB_TRACE_RSS_SAMPLE_RATE-1) {
+			rss = gb_vm_resident_size(NULL);
+			result->peak_rss_delta = gb_max(result->peak_rss_delta, rss - rss_base);
 		}
-
-		fl->allocation_count--;
-		fl->total_allocated -= block_size;
-	} break;
-
-	case gbAllocation_FreeAll:
-		gb_free_list_init(fl, fl->physical_start, fl->total_size);
-		break;
-
-	case gbAllocation_Resize:
-		ptr = gb_default_resize_align(gb_free_list_allocator(fl), old_memory, old_size, size, alignment);
-		break;
 	}
+	result->seconds = gb_time_now() - start;
+	rss = gb_vm_resident_size(&result->peak_rss);
+	result->peak_rss_delta = gb_max(result->peak_rss_delta, rss - rss_base);
+
+	if (result->seconds > 0)
+		result->events_per_second = cast(f64)count / result->seconds;
+	if (result->peak_rss_delta > 0)
+		result->fragmentation = 1.0 - cast(f64)result->peak_live_bytes / cast(f64)gb_max(result->peak_rss_delta, result->peak_live_bytes);
+
+	for (i = 0; i <= max_id; i++) {
+		if (ptrs[i] != NULL)
+			gb_free(a, ptrs[i]);
+	}
+	gb_free(heap, sizes);
+	gb_free(heap, ptrs);
+	gb_free(heap, events);
+	return true;
+}
 
-	return ptr;
+void gb_trace_replay_report(gbTraceReplay *r, char const *name) {
+	gb_printf("%s:\n", name ? name : "Trace Replay");
+	gb_printf("  events:        %lld (%lld failed)\n", cast(long long)r->event_count, cast(long long)r->failed_count);
+	gb_printf("  time:          %f s (%f Mevents/s)\n", r->seconds, r->events_per_second / 1.0e6);
+	gb_printf("  peak live:     %td bytes\n", r->peak_live_bytes);
+	gb_printf("  peak RSS:      +%td bytes (process: %td bytes)\n", r->peak_rss_delta, r->peak_rss);
+	gb_printf("  fragmentation: %f\n", r->fragmentation);
 }
 
 
@@ -5783,9 +10543,193 @@ GB_ALLOCATOR_PROC(gb_scratch_allocator_proc) {
 		s->free_point  = s->physical_start;
 		break;
 
-	case gbAllocation_Resize:
-		ptr = gb_default_resize_align(gb_scratch_allocator(s), old_memory, old_size, size, alignment);
+	case gbAllocation_Resize:
+		ptr = gb_default_resize_align(gb_scratch_allocator(s), old_memory, old_size, size, alignment);
+		break;
+	}
+
+	return ptr;
+}
+
+
+
+//
+// Stack Allocator
+//
+
+void gb_stack_init_from_memory(gbStack *s, void *start, isize size) {
+	gb_zero_item(s);
+	s->physical_start = start;
+	s->total_size     = size;
+}
+
+void gb_stack_init_from_allocator(gbStack *s, gbAllocator backing, isize size) {
+	gb_zero_item(s);
+	s->backing        = backing;
+	s->physical_start = gb_alloc(backing, size);
+	s->total_size     = s->physical_start ? size : 0;
+}
+
+void gb_stack_free(gbStack *s) {
+	if (s->backing.proc) {
+		gb_free(s->backing, s->physical_start);
+		s->physical_start = NULL;
+	}
+}
+
+gb_inline isize gb_stack_size_remaining(gbStack *s) {
+	return s->total_size - s->bottom_offset - s->top_offset;
+}
+
+
+gb_inline gbAllocator gb_stack_allocator_bottom(gbStack *s) {
+	gbAllocator a;
+	a.proc = gb_stack_bottom_allocator_proc;
+	a.data = s;
+	return a;
+}
+
+gb_inline gbAllocator gb_stack_allocator_top(gbStack *s) {
+	gbAllocator a;
+	a.proc = gb_stack_top_allocator_proc;
+	a.data = s;
+	return a;
+}
+
+gb_inline gbStackHeader *gb__stack_header(void *ptr) { return cast(gbStackHeader *)ptr - 1; }
+
+GB_ALLOCATOR_PROC(gb_stack_bottom_allocator_proc) {
+	gbStack *s = cast(gbStack *)allocator_data;
+	void *ptr = NULL;
+	GB_ASSERT_NOT_NULL(s);
+
+	// NOTE(bill): The header must be aligned too
+	alignment = gb_max(alignment, gb_align_of(gbStackHeader));
+
+	switch (type) {
+	case gbAllocation_Alloc: {
+		void *start = gb_pointer_add(s->physical_start, s->bottom_offset);
+		isize end;
+		ptr = gb_align_forward(gb_pointer_add(start, gb_size_of(gbStackHeader)), alignment);
+		end = gb_pointer_diff(s->physical_start, ptr) + size;
+		if (end > s->total_size - s->top_offset)
+			return NULL; // NOTE(bill): Out of memory
+
+		gb__stack_header(ptr)->prev_offset = s->bottom_offset;
+		gb__stack_header(ptr)->prev        = s->bottom_last;
+		s->bottom_offset = end;
+		s->bottom_last   = ptr;
+
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
+
+	case gbAllocation_Free:
+		if (old_memory != NULL) {
+			gbStackHeader *h = gb__stack_header(old_memory);
+			GB_ASSERT_MSG(old_memory == s->bottom_last, "Stack frees must be in LIFO order: %p, expected %p", old_memory, s->bottom_last);
+			s->bottom_offset = h->prev_offset;
+			s->bottom_last   = h->prev;
+		}
+		break;
+
+	case gbAllocation_FreeAll:
+		s->bottom_offset = 0;
+		s->bottom_last   = NULL;
+		break;
+
+	case gbAllocation_Resize: {
+		gbStackHeader h;
+		isize end;
+		if (old_memory == NULL || size == 0)
+			return gb_default_resize_align(gb_stack_allocator_bottom(s), old_memory, old_size, size, alignment);
+		if (old_memory != s->bottom_last && size <= old_size)
+			return old_memory;
+
+		// NOTE(bill): Moving anything else would need a free out of order
+		GB_ASSERT_MSG(old_memory == s->bottom_last, "Only the most recent stack allocation can grow: %p", old_memory);
+		h = *gb__stack_header(old_memory);
+		// NOTE(bill): Only moves if the alignment is greater than it was
+		ptr = gb_align_forward(gb_pointer_add(s->physical_start, h.prev_offset + gb_size_of(gbStackHeader)), alignment);
+		end = gb_pointer_diff(s->physical_start, ptr) + size;
+		if (end > s->total_size - s->top_offset)
+			return NULL; // NOTE(bill): Out of memory
+		if (ptr != old_memory) {
+			gb_memmove(ptr, old_memory, gb_min(old_size, size));
+			*gb__stack_header(ptr) = h;
+		}
+		s->bottom_offset = end;
+		s->bottom_last   = ptr;
+	} break;
+	}
+
+	return ptr;
+}
+
+GB_ALLOCATOR_PROC(gb_stack_top_allocator_proc) {
+	gbStack *s = cast(gbStack *)allocator_data;
+	void *ptr = NULL;
+	GB_ASSERT_NOT_NULL(s);
+
+	alignment = gb_max(alignment, gb_align_of(gbStackHeader));
+
+	switch (type) {
+	case gbAllocation_Alloc: {
+		uintptr end = cast(uintptr)s->physical_start + cast(uintptr)(s->total_size - s->top_offset);
+		uintptr p;
+		if (cast(uintptr)size + gb_size_of(gbStackHeader) > end - cast(uintptr)s->physical_start)
+			return NULL;
+		p = (end - cast(uintptr)size) & ~cast(uintptr)(alignment-1);
+		if (p < cast(uintptr)s->physical_start + cast(uintptr)(s->bottom_offset + gb_size_of(gbStackHeader)))
+			return NULL; // NOTE(bill): Out of memory
+
+		ptr = cast(void *)p;
+		gb__stack_header(ptr)->prev_offset = s->top_offset;
+		gb__stack_header(ptr)->prev        = s->top_last;
+		s->top_offset = s->total_size - gb_pointer_diff(s->physical_start, gb__stack_header(ptr));
+		s->top_last   = ptr;
+
+		if (flags & gbAllocatorFlag_ClearToZero)
+			gb_zero_size(ptr, size);
+	} break;
+
+	case gbAllocation_Free:
+		if (old_memory != NULL) {
+			gbStackHeader *h = gb__stack_header(old_memory);
+			GB_ASSERT_MSG(old_memory == s->top_last, "Stack frees must be in LIFO order: %p, expected %p", old_memory, s->top_last);
+			s->top_offset = h->prev_offset;
+			s->top_last   = h->prev;
+		}
+		break;
+
+	case gbAllocation_FreeAll:
+		s->top_offset = 0;
+		s->top_last   = NULL;
 		break;
+
+	case gbAllocation_Resize: {
+		gbStackHeader h;
+		uintptr end, p = 0;
+		if (old_memory == NULL || size == 0)
+			return gb_default_resize_align(gb_stack_allocator_top(s), old_memory, old_size, size, alignment);
+		if (old_memory != s->top_last && size <= old_size)
+			return old_memory;
+
+		GB_ASSERT_MSG(old_memory == s->top_last, "Only the most recent stack allocation can grow: %p", old_memory);
+		// NOTE(bill): This end grows downwards so the data moves, but it stays in the same place in the stack
+		h = *gb__stack_header(old_memory);
+		end = cast(uintptr)s->physical_start + cast(uintptr)(s->total_size - h.prev_offset);
+		if (cast(uintptr)size + gb_size_of(gbStackHeader) <= end - cast(uintptr)s->physical_start)
+			p = (end - cast(uintptr)size) & ~cast(uintptr)(alignment-1);
+		if (p < cast(uintptr)s->physical_start + cast(uintptr)(s->bottom_offset + gb_size_of(gbStackHeader)))
+			return NULL; // NOTE(bill): Out of memory
+
+		ptr = cast(void *)p;
+		gb_memmove(ptr, old_memory, gb_min(old_size, size));
+		*gb__stack_header(ptr) = h;
+		s->top_offset = s->total_size - gb_pointer_diff(s->physical_start, gb__stack_header(ptr));
+		s->top_last   = ptr;
+	} break;
 	}
 
 	return ptr;
@@ -5840,81 +10784,330 @@ GB_COMPARE_PROC_PTR(gb_str_cmp(isize offset)) {
 
 
 
-// TODO(bill): Make user definable?
-#define GB__SORT_STACK_SIZE            64
-#define GB__SORT_INSERT_SORT_THRESHOLD  8
-
-#define GB__SORT_PUSH(_base, _limit) do { \
-	stack_ptr[0] = (_base); \
-	stack_ptr[1] = (_limit); \
-	stack_ptr += 2; \
-} while (0)
-
+// NOTE(bill): Pattern-defeating quicksort (pdqsort) by Orson Peters
+// https://github.com/orlp/pdqsort
+#define GB__SORT_INSERTION_THRESHOLD     24 // NOTE(bill): All in elements
+#define GB__SORT_NINTHER_THRESHOLD      128
+#define GB__SORT_PARTIAL_INSERTION_LIMIT  8
+#define GB__SORT_BLOCK_SIZE              64 // NOTE(bill): Offsets are stored in a u8
 
-#define GB__SORT_POP(_base, _limit) do { \
-	stack_ptr -= 2; \
-	(_base)  = stack_ptr[0]; \
-	(_limit) = stack_ptr[1]; \
-} while (0)
+#define GB__SORT_LESS(a, b) (cmp((a), (b)) < 0)
 
+gb_internal void gb__sort_insert(u8 *dest, u8 *src, isize size) {
+	// NOTE(bill): Moves the element at src down to dest and everything in between up one
+	if (size <= 256) {
+		u8 tmp[256];
+		gb_memcopy(tmp, src, size);
+		gb_memmove(dest + size, dest, src - dest);
+		gb_memcopy(dest, tmp, size);
+	} else {
+		for (; src > dest; src -= size) {
+			gb_memswap(src - size, src, size);
+		}
+	}
+}
 
+gb_internal void gb__sort_insertion(u8 *begin, u8 *end, isize size, gbCompareProc *cmp, b32 guarded) {
+	// NOTE(bill): Unguarded needs an element before begin that nothing in the range is less than
+	u8 *i, *j;
+	for (i = begin + size; i < end; i += size) {
+		for (j = i; (!guarded || j > begin) && GB__SORT_LESS(i, j-size); j -= size) {}
+		if (j != i) gb__sort_insert(j, i, size);
+	}
+}
 
-void gb_sort(void *base_, isize count, isize size, gbCompareProc cmp) {
+gb_internal b32 gb__sort_partial_insertion(u8 *begin, u8 *end, isize size, gbCompareProc *cmp) {
+	// NOTE(bill): Gives up (false) once more than a few elements had to move
+	isize moves = 0;
 	u8 *i, *j;
-	u8 *base = cast(u8 *)base_;
-	u8 *limit = base + count*size;
-	isize threshold = GB__SORT_INSERT_SORT_THRESHOLD * size;
+	for (i = begin + size; i < end; i += size) {
+		for (j = i; j > begin && GB__SORT_LESS(i, j-size); j -= size) {}
+		if (j != i) {
+			gb__sort_insert(j, i, size);
+			moves += (i - j)/size;
+			if (moves > GB__SORT_PARTIAL_INSERTION_LIMIT) return false;
+		}
+	}
+	return true;
+}
+
+gb_internal gb_inline void gb__sort2(u8 *a, u8 *b, isize size, gbCompareProc *cmp) {
+	if (GB__SORT_LESS(b, a)) gb_memswap(a, b, size);
+}
 
-	// NOTE(bill): Prepare the stack
-	u8 *stack[GB__SORT_STACK_SIZE] = {0};
-	u8 **stack_ptr = stack;
+gb_internal gb_inline void gb__sort3(u8 *a, u8 *b, u8 *c, isize size, gbCompareProc *cmp) {
+	gb__sort2(a, b, size, cmp);
+	gb__sort2(b, c, size, cmp);
+	gb__sort2(a, b, size, cmp);
+}
 
+gb_internal void gb__sort_sift_down(u8 *base, isize root, isize count, isize size, gbCompareProc *cmp) {
 	for (;;) {
-		if ((limit-base) > threshold) {
-			// NOTE(bill): Quick sort
-			i = base + size;
-			j = limit - size;
-
-			gb_memswap(((limit-base)/size/2) * size + base, base, size);
-			if (cmp(i, j) > 0)    gb_memswap(i, j, size);
-			if (cmp(base, j) > 0) gb_memswap(base, j, size);
-			if (cmp(i, base) > 0) gb_memswap(i, base, size);
-
-			for (;;) {
-				do i += size; while (cmp(i, base) < 0);
-				do j -= size; while (cmp(j, base) > 0);
-				if (i > j) break;
-				gb_memswap(i, j, size);
+		isize child = 2*root + 1;
+		if (child >= count) break;
+		if (child+1 < count && GB__SORT_LESS(base + child*size, base + (child+1)*size)) child++;
+		if (!GB__SORT_LESS(base + root*size, base + child*size)) break;
+		gb_memswap(base + root*size, base + child*size, size);
+		root = child;
+	}
+}
+
+gb_internal void gb__sort_heap(u8 *base, isize count, isize size, gbCompareProc *cmp) {
+	isize i;
+	for (i = count/2 - 1; i >= 0; i--) {
+		gb__sort_sift_down(base, i, count, size, cmp);
+	}
+	for (i = count-1; i > 0; i--) {
+		gb_memswap(base, base + i*size, size);
+		gb__sort_sift_down(base, 0, i, size, cmp);
+	}
+}
+
+// NOTE(bill): Partitions [begin, end) around the pivot at begin into < pivot and >= pivot and returns where
+// the pivot ends up. The comparisons are done a block at a time and only record offsets of the elements on
+// the wrong side (BlockQuicksort) so there is no branch on their result to mispredict.
+gb_internal u8 *gb__sort_partition_right(u8 *begin, u8 *end, isize size, gbCompareProc *cmp, b32 *already_partitioned) {
+	u8 offsets_l[GB__SORT_BLOCK_SIZE], offsets_r[GB__SORT_BLOCK_SIZE];
+	isize num_l = 0, num_r = 0, start_l = 0, start_r = 0, num, i;
+	isize block = GB__SORT_BLOCK_SIZE * size;
+	u8 *pivot = begin, *first = begin, *last = end;
+
+	// NOTE(bill): The median of three left something >= pivot at the end so this needs no guard
+	do first += size; while (GB__SORT_LESS(first, pivot));
+	if (first - size == begin) {
+		while (first < last) {
+			last -= size;
+			if (GB__SORT_LESS(last, pivot)) break;
+		}
+	} else {
+		do last -= size; while (!GB__SORT_LESS(last, pivot));
+	}
+
+	*already_partitioned = first >= last;
+	if (!*already_partitioned) {
+		isize unknown, l_count, r_count;
+		gb_memswap(first, last, size);
+		first += size;
+
+		while (last - first > 2*block) {
+			if (num_l == 0) {
+				u8 *it = first;
+				start_l = 0;
+				for (i = 0; i < GB__SORT_BLOCK_SIZE; i++, it += size) {
+					offsets_l[num_l] = cast(u8)i;
+					num_l += !GB__SORT_LESS(it, pivot);
+				}
+			}
+			if (num_r == 0) {
+				u8 *it = last;
+				start_r = 0;
+				for (i = 1; i <= GB__SORT_BLOCK_SIZE; i++) {
+					it -= size;
+					offsets_r[num_r] = cast(u8)i;
+					num_r += GB__SORT_LESS(it, pivot);
+				}
 			}
 
-			gb_memswap(base, j, size);
+			num = gb_min(num_l, num_r);
+			for (i = 0; i < num; i++) {
+				gb_memswap(first + offsets_l[start_l+i]*size, last - offsets_r[start_r+i]*size, size);
+			}
+			num_l -= num; start_l += num;
+			num_r -= num; start_r += num;
+			if (num_l == 0) first += block;
+			if (num_r == 0) last  -= block;
+		}
 
-			if (j - base > limit - i) {
-				GB__SORT_PUSH(base, j);
-				base = i;
-			} else {
-				GB__SORT_PUSH(i, limit);
-				limit = j;
+		// NOTE(bill): At most two blocks are left, one of which may be partly done already
+		unknown = (last - first)/size - ((num_l || num_r) ? GB__SORT_BLOCK_SIZE : 0);
+		if (num_r) {
+			l_count = unknown;
+			r_count = GB__SORT_BLOCK_SIZE;
+		} else if (num_l) {
+			l_count = GB__SORT_BLOCK_SIZE;
+			r_count = unknown;
+		} else {
+			l_count = unknown/2;
+			r_count = unknown - l_count;
+		}
+
+		if (unknown && num_l == 0) {
+			u8 *it = first;
+			start_l = 0;
+			for (i = 0; i < l_count; i++, it += size) {
+				offsets_l[num_l] = cast(u8)i;
+				num_l += !GB__SORT_LESS(it, pivot);
+			}
+		}
+		if (unknown && num_r == 0) {
+			u8 *it = last;
+			start_r = 0;
+			for (i = 1; i <= r_count; i++) {
+				it -= size;
+				offsets_r[num_r] = cast(u8)i;
+				num_r += GB__SORT_LESS(it, pivot);
+			}
+		}
+
+		num = gb_min(num_l, num_r);
+		for (i = 0; i < num; i++) {
+			gb_memswap(first + offsets_l[start_l+i]*size, last - offsets_r[start_r+i]*size, size);
+		}
+		num_l -= num; start_l += num;
+		num_r -= num; start_r += num;
+		if (num_l == 0) first += l_count*size;
+		if (num_r == 0) last  -= r_count*size;
+
+		// NOTE(bill): Whatever is left of one block belongs on the other side of everything else
+		if (num_l) {
+			while (num_l--) {
+				last -= size;
+				gb_memswap(first + offsets_l[start_l+num_l]*size, last, size);
+			}
+			first = last;
+		}
+		if (num_r) {
+			while (num_r--) {
+				gb_memswap(last - offsets_r[start_r+num_r]*size, first, size);
+				first += size;
 			}
+		}
+	}
+
+	gb_memswap(begin, first - size, size);
+	return first - size;
+}
+
+// NOTE(bill): Partitions into <= pivot and > pivot, used when the pivot equals the one before the range
+gb_internal u8 *gb__sort_partition_left(u8 *begin, u8 *end, isize size, gbCompareProc *cmp) {
+	u8 *pivot = begin, *first = begin, *last = end;
+
+	do last -= size; while (GB__SORT_LESS(pivot, last));
+	if (last + size == end) {
+		while (first < last) {
+			first += size;
+			if (GB__SORT_LESS(pivot, first)) break;
+		}
+	} else {
+		do first += size; while (!GB__SORT_LESS(pivot, first));
+	}
+
+	while (first < last) {
+		gb_memswap(first, last, size);
+		do last  -= size; while (GB__SORT_LESS(pivot, last));
+		do first += size; while (!GB__SORT_LESS(pivot, first));
+	}
+
+	gb_memswap(begin, last, size);
+	return last;
+}
+
+gb_internal void gb__sort_loop(u8 *begin, u8 *end, isize size, gbCompareProc *cmp, isize bad_allowed, b32 leftmost) {
+	for (;;) {
+		isize count = (end - begin)/size, half = count/2, l_count, r_count;
+		b32 already_partitioned;
+		u8 *pivot_pos;
+
+		if (count < GB__SORT_INSERTION_THRESHOLD) {
+			gb__sort_insertion(begin, end, size, cmp, leftmost);
+			return;
+		}
+
+		// NOTE(bill): The pivot is the median of three, or Tukey's ninther for bigger ranges, moved to begin
+		if (count > GB__SORT_NINTHER_THRESHOLD) {
+			gb__sort3(begin,              begin + half*size,     end - size,            size, cmp);
+			gb__sort3(begin + size,       begin + (half-1)*size, end - 2*size,          size, cmp);
+			gb__sort3(begin + 2*size,     begin + (half+1)*size, end - 3*size,          size, cmp);
+			gb__sort3(begin + (half-1)*size, begin + half*size,  begin + (half+1)*size, size, cmp);
+			gb_memswap(begin, begin + half*size, size);
 		} else {
-			// NOTE(bill): Insertion sort
-			for (j = base, i = j+size;
-			     i < limit;
-			     j = i, i += size) {
-				for (; cmp(j, j+size) > 0; j -= size) {
-					gb_memswap(j, j+size, size);
-					if (j == base) break;
+			gb__sort3(begin + half*size, begin, end - size, size, cmp);
+		}
+
+		// NOTE(bill): Nothing in a range that is not leftmost is less than the element before it (a previous pivot).
+		// If the pivot equals that too then put everything equal on the left, that part is done, so many
+		// duplicates take linear time.
+		if (!leftmost && !GB__SORT_LESS(begin - size, begin)) {
+			begin = gb__sort_partition_left(begin, end, size, cmp) + size;
+			continue;
+		}
+
+		pivot_pos = gb__sort_partition_right(begin, end, size, cmp, &already_partitioned);
+		l_count = (pivot_pos - begin)/size;
+		r_count = (end - pivot_pos)/size - 1;
+
+		if (l_count < count/8 || r_count < count/8) {
+			// NOTE(bill): Too many bad partitions is probably adversarial input so fall back to heap sort
+			// which is always O(n log n), otherwise swap some elements around to break up the pattern
+			if (--bad_allowed == 0) {
+				gb__sort_heap(begin, count, size, cmp);
+				return;
+			}
+			if (l_count >= GB__SORT_INSERTION_THRESHOLD) {
+				gb_memswap(begin,            begin     + (l_count/4)*size, size);
+				gb_memswap(pivot_pos - size, pivot_pos - (l_count/4)*size, size);
+				if (l_count > GB__SORT_NINTHER_THRESHOLD) {
+					gb_memswap(begin + size,       begin     + (l_count/4 + 1)*size, size);
+					gb_memswap(begin + 2*size,     begin     + (l_count/4 + 2)*size, size);
+					gb_memswap(pivot_pos - 2*size, pivot_pos - (l_count/4 + 1)*size, size);
+					gb_memswap(pivot_pos - 3*size, pivot_pos - (l_count/4 + 2)*size, size);
 				}
 			}
+			if (r_count >= GB__SORT_INSERTION_THRESHOLD) {
+				gb_memswap(pivot_pos + size, pivot_pos + (r_count/4 + 1)*size, size);
+				gb_memswap(end - size,       end       - (r_count/4)*size,     size);
+				if (r_count > GB__SORT_NINTHER_THRESHOLD) {
+					gb_memswap(pivot_pos + 2*size, pivot_pos + (r_count/4 + 2)*size, size);
+					gb_memswap(pivot_pos + 3*size, pivot_pos + (r_count/4 + 3)*size, size);
+					gb_memswap(end - 2*size,       end       - (r_count/4 + 1)*size, size);
+					gb_memswap(end - 3*size,       end       - (r_count/4 + 2)*size, size);
+				}
+			}
+		} else if (already_partitioned &&
+		           gb__sort_partial_insertion(begin, pivot_pos, size, cmp) &&
+		           gb__sort_partial_insertion(pivot_pos + size, end, size, cmp)) {
+			// NOTE(bill): A good partition where nothing moved is probably (nearly) sorted already
+			return;
+		}
+
+		// NOTE(bill): Recurse into the smaller side so the depth stays O(log n)
+		if (l_count < r_count) {
+			gb__sort_loop(begin, pivot_pos, size, cmp, bad_allowed, leftmost);
+			begin = pivot_pos + size;
+			leftmost = false;
+		} else {
+			gb__sort_loop(pivot_pos + size, end, size, cmp, bad_allowed, false);
+			end = pivot_pos;
+		}
+	}
+}
 
-			if (stack_ptr == stack) break; // NOTE(bill): Sorting is done!
-			GB__SORT_POP(base, limit);
+void gb_sort(void *base_, isize count, isize size, gbCompareProc cmp) {
+	u8 *base = cast(u8 *)base_;
+	u8 *end = base + count*size, *p;
+	isize n, bad_allowed = 0;
+
+	if (count < 2) return;
+
+	// NOTE(bill): Already sorted and reverse sorted input (e.g. appended logs) is common enough to check for
+	// first, this stops at the first element out of order
+	for (p = base + size; p < end && !GB__SORT_LESS(p, p - size); p += size) {}
+	if (p == end) return;
+	if (p == base + size) {
+		for (; p < end && !GB__SORT_LESS(p - size, p); p += size) {}
+		if (p == end) {
+			gb_reverse(base, count, size);
+			return;
 		}
 	}
+
+	for (n = count; n > 1; n >>= 1) {
+		bad_allowed++;
+	}
+	gb__sort_loop(base, end, size, cmp, bad_allowed, true);
 }
 
-#undef GB__SORT_PUSH
-#undef GB__SORT_POP
+#undef GB__SORT_LESS
 
 
 #define GB_RADIX_SORT_PROC_GEN(Type) GB_RADIX_SORT_PROC(Type) { \
@@ -5976,7 +11169,7 @@ void gb_shuffle(void *base, isize count, isize size) {
 
 	a = cast(u8 *)base + (count-1) * size;
 	for (i = count; i > 1; i--) {
-		j = gb_random_gen_isize(&random) % i;
+		j = cast(isize)(gb_random_gen_u64(&random) % cast(u64)i); // NOTE(bill): Unsigned so j is never negative
 		gb_memswap(a, cast(u8 *)base + j*size, size);
 		a -= size;
 	}
@@ -5984,7 +11177,7 @@ void gb_shuffle(void *base, isize count, isize size) {
 
 void gb_reverse(void *base, isize count, isize size) {
 	isize i, j = count-1;
-	for (i = 0; i < j; i++, j++) {
+	for (i = 0; i < j; i++, j--) {
 		gb_memswap(cast(u8 *)base + i*size, cast(u8 *)base + j*size, size);
 	}
 }
@@ -6083,25 +11276,10 @@ gb_inline void gb_str_to_upper(char *str) {
 
 
 gb_inline isize gb_strlen(char const *str) {
-	char const *begin = str;
-	isize const *w;
 	if (str == NULL)  {
 		return 0;
 	}
-	while (cast(uintptr)str % sizeof(usize)) {
-		if (!*str)
-			return str - begin;
-		str++;
-	}
-	w = cast(isize const *)str;
-	while (!GB__HAS_ZERO(*w)) {
-		w++;
-	}
-	str = cast(char const *)w;
-	while (*str) {
-		str++;
-	}
-	return str - begin;
+	return gb__cpu_dispatch.strlen(str);
 }
 
 gb_inline isize gb_strnlen(char const *str, isize max_len) {
@@ -7012,6 +12190,50 @@ isize gb_utf8_encode_rune(u8 buf[4], Rune r) {
 //
 
 
+gb_internal gb_inline isize gb__array_offset(isize alignment) {
+	// NOTE(bill): The header sits right before the elements
+	return (gb_size_of(gbArrayHeader) + alignment-1) & ~(alignment-1);
+}
+
+void *gb__array_init(gbAllocator a, isize element_size, isize capacity, isize alignment) {
+	gbArrayHeader *h;
+	isize offset;
+	u8 *memory;
+	if (alignment < GB_DEFAULT_MEMORY_ALIGNMENT)
+		alignment = GB_DEFAULT_MEMORY_ALIGNMENT;
+	GB_ASSERT(gb_is_power_of_two(alignment));
+	offset = gb__array_offset(alignment);
+	memory = cast(u8 *)gb_alloc_align(a, offset + element_size*capacity, alignment);
+	GB_ASSERT_NOT_NULL(memory);
+	h = cast(gbArrayHeader *)(memory + offset) - 1;
+	h->allocator = a;
+	h->count     = 0;
+	h->capacity  = capacity;
+	h->grow      = NULL;
+	h->alignment = cast(i32)alignment;
+	h->offset    = cast(i32)offset;
+	return h+1;
+}
+
+GB_ARRAY_GROW_PROC(gb_array_grow_formula) {
+	isize new_capacity = GB_ARRAY_GROW_FORMULA(capacity);
+	gb_unused(element_size);
+	return gb_max(new_capacity, min_capacity);
+}
+
+GB_ARRAY_GROW_PROC(gb_array_grow_conservative) {
+	isize new_capacity = capacity + capacity/2 + 8;
+	gb_unused(element_size);
+	return gb_max(new_capacity, min_capacity);
+}
+
+isize gb__array_grow_capacity(void *array, isize min_capacity, isize element_size) {
+	gbArrayHeader *h = GB_ARRAY_HEADER(array);
+	if (h->grow)
+		return h->grow(h->capacity, min_capacity, element_size);
+	return gb_array_grow_formula(h->capacity, min_capacity, element_size);
+}
+
 gb_no_inline void *gb__array_set_capacity(void *array, isize capacity, isize element_size) {
 	gbArrayHeader *h = GB_ARRAY_HEADER(array);
 
@@ -7020,29 +12242,386 @@ gb_no_inline void *gb__array_set_capacity(void *array, isize capacity, isize ele
 	if (capacity == h->capacity)
 		return array;
 
-	if (capacity < h->count) {
-		if (h->capacity < capacity) {
-			isize new_capacity = GB_ARRAY_GROW_FORMULA(h->capacity);
-			if (new_capacity < capacity)
-				new_capacity = capacity;
-			gb__array_set_capacity(array, new_capacity, element_size);
-		}
+	if (capacity < h->count)
 		h->count = capacity;
-	}
 
 	{
-		isize size = gb_size_of(gbArrayHeader) + element_size*capacity;
-		gbArrayHeader *nh = cast(gbArrayHeader *)gb_alloc(h->allocator, size);
-		gb_memmove(nh, h, gb_size_of(gbArrayHeader) + element_size*h->count);
-		nh->allocator = h->allocator;
-		nh->count     = h->count;
-		nh->capacity  = capacity;
-		gb_free(h->allocator, h);
+		// NOTE(bill): Resize rather than alloc+copy so allocators can grow it in place
+		// (gbArena, realloc/mremap for the heap and gb_vm_allocator)
+		gbArrayHeader header = *h;
+		isize old_size = header.offset + element_size*header.count;
+		isize new_size = header.offset + element_size*capacity;
+		u8 *memory = cast(u8 *)gb_resize_align(header.allocator, gb_pointer_sub(h+1, header.offset), old_size, new_size, header.alignment);
+		gbArrayHeader *nh;
+		GB_ASSERT_NOT_NULL(memory);
+		nh = cast(gbArrayHeader *)(memory + header.offset) - 1;
+		*nh = header;
+		nh->capacity = capacity;
 		return nh+1;
 	}
 }
 
 
+void *gb__array_splice(void *array, isize element_size, isize index, isize remove_count, void const *items, isize item_count) {
+	gbArrayHeader *h = GB_ARRAY_HEADER(array);
+	isize tail, new_count;
+	u8 *data;
+
+	GB_ASSERT(0 <= index && 0 <= remove_count && index+remove_count <= h->count);
+	GB_ASSERT(item_count >= 0);
+
+	new_count = h->count - remove_count + item_count;
+	if (h->capacity < new_count) {
+		array = gb__array_set_capacity(array, gb__array_grow_capacity(array, new_count, element_size), element_size);
+		h = GB_ARRAY_HEADER(array);
+	}
+
+	data = cast(u8 *)array;
+	tail = h->count - index - remove_count;
+	if (remove_count != item_count && tail > 0)
+		gb_memmove(data + (index+item_count)*element_size, data + (index+remove_count)*element_size, tail*element_size);
+	if (item_count > 0)
+		gb_memcopy(data + index*element_size, items, item_count*element_size);
+
+	h->count = new_count;
+	return array;
+}
+
+isize gb__array_remove_if(void *array, isize element_size, gbArrayPredicateProc *predicate, void *user_data) {
+	gbArrayHeader *h = GB_ARRAY_HEADER(array);
+	u8 *data = cast(u8 *)array;
+	isize i, count = h->count, dst;
+
+	for (i = 0; i < count; i++) {
+		if (predicate(data + i*element_size, user_data))
+			break;
+	}
+	// NOTE(bill): Move the kept runs down in one go rather than item by item
+	dst = i;
+	while (i < count) {
+		isize run_start;
+		for (i++; i < count; i++) {
+			if (!predicate(data + i*element_size, user_data))
+				break;
+		}
+		run_start = i;
+		for (; i < count; i++) {
+			if (predicate(data + i*element_size, user_data))
+				break;
+		}
+		if (i > run_start) {
+			gb_memmove(data + dst*element_size, data + run_start*element_size, (i-run_start)*element_size);
+			dst += i-run_start;
+		}
+	}
+	return dst;
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// Small Array
+//
+//
+
+gb_no_inline void *gb__small_array_set_capacity(gbAllocator a, void *heap, void const *inline_data, isize count, isize capacity, isize element_size) {
+	void *result;
+	if (heap) {
+		result = gb_resize(a, heap, count*element_size, capacity*element_size);
+	} else {
+		// NOTE(bill): Moving off the inline storage
+		result = gb_alloc(a, capacity*element_size);
+		if (result) gb_memcopy(result, inline_data, count*element_size);
+	}
+	GB_ASSERT_NOT_NULL(result);
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// Structure of Arrays
+//
+//
+
+gb_internal isize gb__soa_column_offsets(gbSoa *soa, isize capacity, isize *offsets) {
+	isize i, offset = 0;
+	for (i = 0; i < soa->column_count; i++) {
+		offsets[i] = offset;
+		offset += (soa->column_sizes[i]*capacity + soa->alignment-1) & ~(soa->alignment-1);
+	}
+	return offset;
+}
+
+gb_inline void gb_soa_init(gbSoa *soa, gbAllocator a, isize const *column_sizes, isize column_count) {
+	gb_soa_init_align(soa, a, column_sizes, column_count, GB_SOA_DEFAULT_ALIGNMENT);
+}
+
+void gb_soa_init_align(gbSoa *soa, gbAllocator a, isize const *column_sizes, isize column_count, isize alignment) {
+	isize i;
+	GB_ASSERT(0 < column_count && column_count <= GB_SOA_MAX_COLUMNS);
+	GB_ASSERT(gb_is_power_of_two(alignment));
+
+	gb_zero_item(soa);
+	soa->allocator    = a;
+	soa->alignment    = alignment;
+	soa->column_count = column_count;
+	for (i = 0; i < column_count; i++) {
+		GB_ASSERT(column_sizes[i] > 0);
+		soa->column_sizes[i] = column_sizes[i];
+	}
+}
+
+void gb_soa_free(gbSoa *soa) {
+	if (soa->data)
+		gb_free(soa->allocator, soa->data);
+	soa->data     = NULL;
+	soa->count    = 0;
+	soa->capacity = 0;
+	gb_zero_array(soa->columns, GB_SOA_MAX_COLUMNS);
+}
+
+void gb_soa_set_capacity(gbSoa *soa, isize capacity) {
+	isize old_offsets[GB_SOA_MAX_COLUMNS], new_offsets[GB_SOA_MAX_COLUMNS];
+	isize old_size, new_size, i;
+	u8 *data;
+
+	GB_ASSERT(capacity >= 0);
+	if (capacity == soa->capacity)
+		return;
+	if (capacity < soa->count)
+		soa->count = capacity;
+
+	old_size = gb__soa_column_offsets(soa, soa->capacity, old_offsets);
+	new_size = gb__soa_column_offsets(soa, capacity, new_offsets);
+
+	// NOTE(bill): One resize of the whole block (so it can grow in place) and then the columns are
+	// moved to their new offsets. They move up when growing so go backwards, and down when shrinking.
+	if (capacity < soa->capacity) {
+		data = cast(u8 *)soa->data;
+		for (i = 1; i < soa->column_count; i++)
+			gb_memmove(data + new_offsets[i], data + old_offsets[i], soa->count*soa->column_sizes[i]);
+		if (capacity == 0) {
+			gb_free(soa->allocator, soa->data);
+			data = NULL;
+		} else {
+			data = cast(u8 *)gb_resize_align(soa->allocator, soa->data, old_size, new_size, soa->alignment);
+		}
+	} else {
+		if (soa->data)
+			data = cast(u8 *)gb_resize_align(soa->allocator, soa->data, old_size, new_size, soa->alignment);
+		else
+			data = cast(u8 *)gb_alloc_align(soa->allocator, new_size, soa->alignment);
+		GB_ASSERT_NOT_NULL(data);
+		for (i = soa->column_count-1; i > 0; i--)
+			gb_memmove(data + new_offsets[i], data + old_offsets[i], soa->count*soa->column_sizes[i]);
+	}
+
+	soa->data     = data;
+	soa->capacity = capacity;
+	for (i = 0; i < soa->column_count; i++)
+		soa->columns[i] = data ? data + new_offsets[i] : NULL;
+}
+
+gb_inline void gb_soa_reserve(gbSoa *soa, isize capacity) {
+	if (soa->capacity < capacity)
+		gb_soa_set_capacity(soa, capacity);
+}
+
+void gb_soa_resize(gbSoa *soa, isize count) {
+	if (soa->capacity < count) {
+		isize new_capacity = GB_ARRAY_GROW_FORMULA(soa->capacity);
+		gb_soa_set_capacity(soa, gb_max(new_capacity, count));
+	}
+	soa->count = count;
+}
+
+gb_inline isize gb_soa_push(gbSoa *soa) {
+	isize index = soa->count;
+	gb_soa_resize(soa, index+1);
+	return index;
+}
+
+void gb_soa_remove_unordered(gbSoa *soa, isize index) {
+	isize i, last;
+	GB_ASSERT(0 <= index && index < soa->count);
+	last = --soa->count;
+	if (index == last)
+		return;
+	for (i = 0; i < soa->column_count; i++) {
+		isize size = soa->column_sizes[i];
+		u8 *column = cast(u8 *)soa->columns[i];
+		gb_memcopy(column + index*size, column + last*size, size);
+	}
+}
+
+gb_inline void gb_soa_clear(gbSoa *soa) { soa->count = 0; }
+
+gb_inline void *gb__soa_column(gbSoa *soa, isize column, isize element_size) {
+	GB_ASSERT(0 <= column && column < soa->column_count);
+	GB_ASSERT_MSG(soa->column_sizes[column] == element_size, "Column %td is %td bytes, not %td", column, soa->column_sizes[column], element_size);
+	return soa->columns[column];
+}
+
+
+
+////////////////////////////////////////////////////////////////
+//
+// Handle Pool
+//
+//
+
+#define GB__HANDLE_NO_SLOT cast(u32)0xffffffff
+
+gb_inline gbHandle gb__handle_make(u32 index, u32 generation) {
+	return (cast(gbHandle)generation << GB_HANDLE_INDEX_BITS) | cast(gbHandle)index;
+}
+
+void gb_handle_pool_init(gbHandlePool *pool, gbAllocator backing, isize item_size, isize item_align) {
+	GB_ASSERT(item_size > 0);
+	GB_ASSERT(gb_is_power_of_two(item_align));
+	gb_zero_item(pool);
+	pool->backing    = backing;
+	pool->item_size  = item_size;
+	pool->item_align = item_align;
+	pool->free_slot  = GB__HANDLE_NO_SLOT;
+}
+
+void gb_handle_pool_free(gbHandlePool *pool) {
+	if (pool->capacity > 0) {
+		gb_free(pool->backing, pool->items);
+		gb_free(pool->backing, pool->item_slots);
+		gb_free(pool->backing, pool->slots);
+	}
+	gb_handle_pool_init(pool, pool->backing, pool->item_size, pool->item_align);
+}
+
+b32 gb_handle_pool_reserve(gbHandlePool *pool, isize capacity) {
+	void *items;
+	u32 *item_slots;
+	gbHandleSlot *slots;
+	isize old_capacity = pool->capacity;
+
+	if (capacity <= old_capacity)
+		return true;
+	if (cast(u64)capacity > cast(u64)GB_HANDLE_INDEX_MASK)
+		return false;
+
+	items      = gb_resize_align(pool->backing, pool->items, old_capacity*pool->item_size, capacity*pool->item_size, pool->item_align);
+	if (items == NULL) return false;
+	pool->items = items;
+	item_slots = cast(u32 *)gb_resize(pool->backing, pool->item_slots, old_capacity*gb_size_of(u32), capacity*gb_size_of(u32));
+	if (item_slots == NULL) return false;
+	pool->item_slots = item_slots;
+	slots      = cast(gbHandleSlot *)gb_resize(pool->backing, pool->slots, old_capacity*gb_size_of(gbHandleSlot), capacity*gb_size_of(gbHandleSlot));
+	if (slots == NULL) return false;
+	pool->slots = slots;
+
+	pool->capacity = capacity;
+	return true;
+}
+
+void gb_handle_pool_clear(gbHandlePool *pool) {
+	isize i;
+	for (i = 0; i < pool->count; i++) {
+		u32 slot = pool->item_slots[i];
+		u32 generation = (pool->slots[slot].generation + 1) & cast(u32)GB_HANDLE_GENERATION_MASK;
+		pool->slots[slot].generation = generation ? generation : 1;
+		pool->slots[slot].index      = pool->free_slot;
+		pool->free_slot = slot;
+	}
+	pool->count = 0;
+}
+
+
+gbHandle gb_handle_pool_create(gbHandlePool *pool, void **item_out) {
+	u32 slot, index;
+	void *item;
+
+	if (pool->count == pool->capacity) {
+		isize new_capacity = GB_ARRAY_GROW_FORMULA(pool->capacity);
+		if (!gb_handle_pool_reserve(pool, new_capacity) &&
+		    !gb_handle_pool_reserve(pool, pool->capacity+1)) {
+			if (item_out) *item_out = NULL;
+			return GB_HANDLE_INVALID;
+		}
+	}
+
+	if (pool->free_slot != GB__HANDLE_NO_SLOT) {
+		slot = pool->free_slot;
+		pool->free_slot = pool->slots[slot].index;
+	} else {
+		// NOTE(bill): Only when every slot is alive so slot_count < capacity
+		slot = cast(u32)pool->slot_count++;
+		pool->slots[slot].generation = 1;
+	}
+
+	index = cast(u32)pool->count++;
+	pool->slots[slot].index = index;
+	pool->item_slots[index] = slot;
+
+	item = gb_pointer_add(pool->items, index*pool->item_size);
+	gb_zero_size(item, pool->item_size);
+	if (item_out) *item_out = item;
+	return gb__handle_make(slot, pool->slots[slot].generation);
+}
+
+gb_inline b32 gb_handle_pool_is_valid(gbHandlePool *pool, gbHandle handle) {
+	u32 slot = gb_handle_index(handle);
+	u32 index;
+	if (slot >= pool->slot_count || pool->slots[slot].generation != gb_handle_generation(handle))
+		return false;
+	// NOTE(bill): A free slot keeps its generation but its index is the next free slot,
+	// only trust it if the item it points at points back
+	index = pool->slots[slot].index;
+	return index < pool->count && pool->item_slots[index] == slot;
+}
+
+b32 gb_handle_pool_destroy(gbHandlePool *pool, gbHandle handle) {
+	u32 slot, index, last, generation;
+	if (!gb_handle_pool_is_valid(pool, handle))
+		return false;
+
+	slot  = gb_handle_index(handle);
+	index = pool->slots[slot].index;
+	last  = cast(u32)(pool->count-1);
+	if (index != last) {
+		// NOTE(bill): Move the last item into the hole to keep the items dense
+		gb_memcopy(gb_pointer_add(pool->items, index*pool->item_size),
+		           gb_pointer_add(pool->items, last*pool->item_size),
+		           pool->item_size);
+		pool->item_slots[index] = pool->item_slots[last];
+		pool->slots[pool->item_slots[index]].index = index;
+	}
+	pool->count--;
+
+	generation = (pool->slots[slot].generation + 1) & cast(u32)GB_HANDLE_GENERATION_MASK;
+	pool->slots[slot].generation = generation ? generation : 1;
+	pool->slots[slot].index      = pool->free_slot;
+	pool->free_slot = slot;
+	return true;
+}
+
+gb_inline void *gb_handle_pool_get(gbHandlePool *pool, gbHandle handle) {
+	if (!gb_handle_pool_is_valid(pool, handle))
+		return NULL;
+	return gb_pointer_add(pool->items, pool->slots[gb_handle_index(handle)].index*pool->item_size);
+}
+
+gb_inline void *gb_handle_pool_item_at(gbHandlePool *pool, isize index) {
+	GB_ASSERT(0 <= index && index < pool->count);
+	return gb_pointer_add(pool->items, index*pool->item_size);
+}
+
+gb_inline gbHandle gb_handle_pool_handle_at(gbHandlePool *pool, isize index) {
+	u32 slot;
+	GB_ASSERT(0 <= index && index < pool->count);
+	slot = pool->item_slots[index];
+	return gb__handle_make(slot, pool->slots[slot].generation);
+}
+
+
+
 ////////////////////////////////////////////////////////////////
 //
 // Hashing functions